@@ -83,4 +83,11 @@ fi
 
 wait $SERVER_PID 2>/dev/null
 
-echo "Test run completed."
\ No newline at end of file
+# Run the feature tests; each starts servers of its own on other ports
+FAILED=0
+for TEST in tests/test_*.sh; do
+    bash "$TEST" || FAILED=1
+done
+
+echo "Test run completed."
+exit $FAILED
\ No newline at end of file
@@ -0,0 +1,405 @@
+// This file implements the in-process microbenchmark suite.
+// Every benchmark runs on a synthetic graph from GraphGenerator, so a given
+// seed always measures the same input. Each result is one line of
+// tab-separated key=value fields, in a fixed order, that can be diffed
+// between commits:
+//
+//   bench=prim  generator=rmat  vertices=..  edges=..  op=mst  ops=..
+//   ns_per_op=..  allocs_per_op=..  bytes_per_op=..  peak_rss_kb=..
+//
+// Time is the median over --repeat runs. Allocations are counted by replacing
+// the global operator new; they are deterministic, so they are taken from the
+// last run. Peak RSS is the process high-water mark, reset before every
+// benchmark where the kernel allows it (/proc/self/clear_refs).
+
+#include "../common/Graph.hpp"
+#include "../common/GraphGenerators.hpp"
+#include "../common/KruskalMST.hpp"
+#include "../common/MSTMetrics.hpp"
+#include "../common/PrimMST.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::atomic<unsigned long long> allocations(0);
+    std::atomic<unsigned long long> allocatedBytes(0);
+}
+
+// Counting replacements of the global allocation functions
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void *pointer = std::malloc(size ? size : 1);
+    if (!pointer)
+    {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace
+{
+    struct Options
+    {
+        std::vector<long long> sizes = {1000, 10000, 100000, 1000000};
+        std::vector<std::string> generators = {"erdos_renyi", "grid", "rmat", "complete"};
+        std::vector<std::string> benches = {"generate", "build", "remove_vertex", "prim", "kruskal", "metrics"};
+        int repeat = 3;
+        uint64_t seed = 1;
+        VertexOrder order = VertexOrder::Rcm; // for reorder and the _reordered benches
+    };
+
+    // MSTMetrics runs Floyd-Warshall (cubic in V), so it is skipped above this
+    const int METRICS_MAX_VERTICES = 400;
+    // Vertices removed per remove_vertex run (each removal renumbers the graph)
+    const int REMOVALS = 8;
+
+    std::vector<std::string> splitList(const std::string &text)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            if (!item.empty())
+            {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    // Vertex count that gives about `edges` edges for a generator
+    int verticesFor(const std::string &kind, long long edges)
+    {
+        if (kind == "grid")
+        {
+            return static_cast<int>(std::max(4LL, edges / 2));
+        }
+        if (kind == "complete")
+        {
+            return static_cast<int>(std::max(2.0, std::round((1 + std::sqrt(1 + 8.0 * edges)) / 2)));
+        }
+        // sparse random graphs: average degree 16
+        return static_cast<int>(std::max(16LL, edges / 8));
+    }
+
+    // Reset the RSS high-water mark; false when the kernel does not allow it
+    bool resetPeakRss()
+    {
+        std::ofstream clearRefs("/proc/self/clear_refs");
+        clearRefs << "5";
+        clearRefs.flush();
+        return static_cast<bool>(clearRefs);
+    }
+
+    long peakRssKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+            {
+                return std::atol(line.c_str() + 6);
+            }
+        }
+        return -1;
+    }
+
+    struct Measurement
+    {
+        double ns;
+        unsigned long long allocations;
+        unsigned long long bytes;
+    };
+
+    // Run body `repeat` times; setup runs before each run, outside the measurement
+    Measurement measure(int repeat, const std::function<void()> &setup, const std::function<void()> &body)
+    {
+        std::vector<double> times;
+        Measurement result = {0, 0, 0};
+        for (int run = 0; run < repeat; ++run)
+        {
+            setup();
+            unsigned long long allocationsBefore = allocations.load();
+            unsigned long long bytesBefore = allocatedBytes.load();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+            result.allocations = allocations.load() - allocationsBefore;
+            result.bytes = allocatedBytes.load() - bytesBefore;
+            times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        std::sort(times.begin(), times.end());
+        result.ns = times[times.size() / 2];
+        return result;
+    }
+
+    // extra: more tab-separated key=value fields, appended to the line
+    void report(const std::string &bench, const std::string &kind, const Graph &graph, const char *op, long long ops, const Measurement &measurement,
+                const std::string &extra = "")
+    {
+        char line[512];
+        std::snprintf(line, sizeof(line),
+                      "bench=%s\tgenerator=%s\tvertices=%d\tedges=%d\top=%s\tops=%lld\tns_per_op=%.1f\tallocs_per_op=%.2f\tbytes_per_op=%.1f\tpeak_rss_kb=%ld",
+                      bench.c_str(), kind.c_str(), graph.getVertices(), graph.getEdges(), op, ops,
+                      measurement.ns / ops,
+                      static_cast<double>(measurement.allocations) / ops,
+                      static_cast<double>(measurement.bytes) / ops,
+                      peakRssKb());
+        std::cout << line << extra << std::endl;
+    }
+
+    Graph buildGraph(int vertices, const std::vector<Edge> &edges)
+    {
+        Graph graph(vertices);
+        for (const Edge &edge : edges)
+        {
+            graph.addEdge(edge.source, edge.destination, edge.weight);
+        }
+        return graph;
+    }
+
+    // prim, kruskal or components, alone or with a storage suffix (see variantOf)
+    bool isTraversal(const std::string &bench)
+    {
+        size_t split = bench.find('_');
+        std::string base = bench.substr(0, split);
+        std::string suffix = split == std::string::npos ? "" : bench.substr(split);
+        return (base == "prim" || base == "kruskal" || base == "components") &&
+               (suffix.empty() || suffix == "_compact" || suffix == "_compressed" || suffix == "_reordered");
+    }
+
+    // The graph in the form the bench's suffix names: _compact (packed),
+    // _compressed, _reordered (packed, in --order) or none (lists)
+    Graph variantOf(const std::string &bench, const Graph &graph, const Options &options)
+    {
+        Graph variant = graph;
+        if (bench.find("_compact") != std::string::npos)
+        {
+            variant.compact(AdjacencyStorage::Packed);
+        }
+        else if (bench.find("_compressed") != std::string::npos)
+        {
+            variant.compact(AdjacencyStorage::Compressed);
+        }
+        else if (bench.find("_reordered") != std::string::npos)
+        {
+            variant.reorder(options.order);
+        }
+        return variant;
+    }
+
+    void runBenchmark(const std::string &bench, const std::string &kind, const GraphGenerator &generator,
+                      const std::vector<Edge> &edges, const Graph &graph, const Options &options)
+    {
+        auto noSetup = []() {};
+        long long edgeCount = static_cast<long long>(edges.size());
+        resetPeakRss();
+
+        if (bench == "generate")
+        {
+            Measurement m = measure(options.repeat, noSetup, [&]()
+                                    { generator.generateAll(); });
+            report(bench, kind, graph, "edge", edgeCount, m);
+        }
+        else if (bench == "build")
+        {
+            Measurement m = measure(options.repeat, noSetup, [&]()
+                                    { buildGraph(generator.vertices(), edges); });
+            report(bench, kind, graph, "edge", edgeCount, m);
+        }
+        else if (bench == "remove_vertex")
+        {
+            // A fresh copy per run; the copy shares lists with graph (copy-on-write)
+            Graph copy;
+            int removals = std::min(REMOVALS, graph.getVertices() / 2);
+            int stride = graph.getVertices() / removals;
+            Measurement m = measure(options.repeat, [&]()
+                                    { copy = graph; },
+                                    [&]()
+                                    {
+                                        for (int i = removals - 1; i >= 0; --i)
+                                        {
+                                            copy.removeVertex(i * stride);
+                                        } });
+            report(bench, kind, graph, "vertex", removals, m);
+        }
+        else if (bench == "compact" || bench == "compress")
+        {
+            AdjacencyStorage storage = bench == "compact" ? AdjacencyStorage::Packed : AdjacencyStorage::Compressed;
+            Graph copy;
+            Measurement m = measure(options.repeat, [&]()
+                                    { copy = graph; },
+                                    [&]()
+                                    { copy.compact(storage); });
+            char extra[128];
+            std::snprintf(extra, sizeof(extra), "\tgraph_bytes_per_edge=%.1f\t%s_bytes_per_edge=%.1f",
+                          static_cast<double>(graph.memoryUsage().total()) / std::max(1LL, edgeCount),
+                          Graph::storageName(storage),
+                          static_cast<double>(copy.memoryUsage().total()) / std::max(1LL, edgeCount));
+            report(bench, kind, graph, "edge", edgeCount, m, extra);
+        }
+        else if (bench == "reorder")
+        {
+            Graph copy;
+            Measurement m = measure(options.repeat, [&]()
+                                    { copy = graph; },
+                                    [&]()
+                                    { copy.reorder(options.order); });
+            char extra[128];
+            std::snprintf(extra, sizeof(extra), "\torder=%s\tneighbor_distance_before=%.1f\tneighbor_distance_after=%.1f",
+                          Graph::orderName(options.order), graph.averageNeighborDistance(), copy.averageNeighborDistance());
+            report(bench, kind, graph, "edge", edgeCount, m, extra);
+        }
+        else if (isTraversal(bench))
+        {
+            Graph input = variantOf(bench, graph, options);
+            PrimMST prim;
+            KruskalMST kruskal;
+            Measurement m;
+            if (bench.compare(0, 10, "components") == 0)
+            {
+                m = measure(options.repeat, noSetup, [&]()
+                            { input.componentCount(); });
+            }
+            else
+            {
+                MST &algorithm = bench.compare(0, 4, "prim") == 0 ? static_cast<MST &>(prim) : static_cast<MST &>(kruskal);
+                m = measure(options.repeat, noSetup, [&]()
+                            { algorithm.findMST(input); });
+            }
+            report(bench, kind, graph, "mst", 1, m);
+        }
+        else if (bench == "metrics")
+        {
+            if (graph.getVertices() > METRICS_MAX_VERTICES)
+            {
+                return;
+            }
+            std::vector<Edge> mst = PrimMST().findMST(graph);
+            Measurement m = measure(options.repeat, noSetup, [&]()
+                                    {
+                MSTMetrics metrics;
+                metrics.calculateMetrics(graph, mst); });
+            report(bench, kind, graph, "mst", 1, m);
+        }
+        else
+        {
+            std::cerr << "Unknown benchmark: " << bench << std::endl;
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--sizes")
+        {
+            options.sizes.clear();
+            for (const std::string &size : splitList(value))
+            {
+                options.sizes.push_back(static_cast<long long>(std::stod(size)));
+            }
+        }
+        else if (flag == "--generators")
+            options.generators = splitList(value);
+        else if (flag == "--benches")
+            options.benches = splitList(value);
+        else if (flag == "--repeat")
+            options.repeat = std::max(1, std::stoi(value));
+        else if (flag == "--seed")
+            options.seed = std::stoull(value);
+        else if (flag == "--order")
+            options.order = Graph::parseOrder(value);
+        else
+        {
+            std::cerr << "Usage: bench [--sizes 1e3,1e4,...] [--generators erdos_renyi,grid,rmat,complete,geometric]"
+                      << " [--benches generate,build,remove_vertex,compact,compress,prim,kruskal,prim_compact,kruskal_compact,"
+                      << "prim_compressed,kruskal_compressed,reorder,prim_reordered,kruskal_reordered,"
+                      << "components,components_compact,components_reordered,metrics]"
+                      << " [--repeat N] [--seed S] [--order bfs|rcm|degree]" << std::endl;
+            return 1;
+        }
+    }
+    if (argc % 2 == 0)
+    {
+        std::cerr << "Missing value for " << argv[argc - 1] << std::endl;
+        return 1;
+    }
+
+    if (!resetPeakRss())
+    {
+        std::cout << "# note: cannot reset the RSS high-water mark, peak_rss_kb is the process maximum so far" << std::endl;
+    }
+
+    for (const std::string &kind : options.generators)
+    {
+        for (long long size : options.sizes)
+        {
+            GeneratorSpec spec;
+            spec.kind = kind;
+            spec.vertices = verticesFor(kind, size);
+            spec.edges = size;
+            spec.seed = options.seed;
+            try
+            {
+                GraphGenerator generator(spec);
+                std::vector<Edge> edges = generator.generateAll();
+                Graph graph = buildGraph(generator.vertices(), edges);
+                for (const std::string &bench : options.benches)
+                {
+                    runBenchmark(bench, kind, generator, edges, graph, options);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Skipping " << kind << " at " << size << " edges: " << e.what() << std::endl;
+            }
+        }
+    }
+    return 0;
+}
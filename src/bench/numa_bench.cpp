@@ -0,0 +1,193 @@
+// This file implements a benchmark for NUMA placement of graph memory.
+// It builds a random graph on one pinned thread (so every page is first-touched
+// on one node), runs Prim's algorithm concurrently from workers pinned across
+// the NUMA nodes, then spreads the adjacency lists with Graph::redistribute()
+// and runs the same workload again. Remote-node memory reads are counted with
+// the kernel's NODE cache event when perf events are available.
+
+#include "../common/Graph.hpp"
+#include "../common/PrimMST.hpp"
+#include "../utils/affinity.hpp"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Counts node-level (remote memory) read misses of this process and its threads
+    class RemoteReadCounter
+    {
+    public:
+        RemoteReadCounter()
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_NODE |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            fd_ = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+
+        ~RemoteReadCounter()
+        {
+            if (fd_ >= 0)
+            {
+                close(fd_);
+            }
+        }
+
+        bool available() const { return fd_ >= 0; }
+
+        void start()
+        {
+            if (fd_ >= 0)
+            {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        long long stop()
+        {
+            long long count = -1;
+            if (fd_ >= 0)
+            {
+                ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+                if (read(fd_, &count, sizeof(count)) != sizeof(count))
+                {
+                    count = -1;
+                }
+            }
+            return count;
+        }
+
+    private:
+        int fd_;
+    };
+
+    struct Options
+    {
+        int vertices = 200000;
+        int degree = 8;
+        int passes = 1;
+        std::string pin = "scatter";
+    };
+
+    // Run Prim's algorithm from every pinned CPU at once, return wall time in ms
+    double runWorkload(const Graph &graph, const std::vector<int> &cpus, int passes)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int cpu : cpus)
+        {
+            threads.emplace_back([&graph, cpu, passes]()
+                                 {
+                affinity::pinCurrentThread(cpu);
+                PrimMST prim;
+                for (int pass = 0; pass < passes; ++pass)
+                {
+                    prim.findMST(graph);
+                } });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void report(const std::string &placement, double ms, long long remoteReads)
+    {
+        std::cout << "placement=" << placement << "\ttime_ms=" << ms << "\tremote_reads=";
+        if (remoteReads < 0)
+        {
+            std::cout << "n/a";
+        }
+        else
+        {
+            std::cout << remoteReads;
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--vertices")
+            options.vertices = std::stoi(value);
+        else if (flag == "--degree")
+            options.degree = std::stoi(value);
+        else if (flag == "--passes")
+            options.passes = std::stoi(value);
+        else if (flag == "--pin")
+            options.pin = value;
+        else
+        {
+            std::cerr << "Usage: numa_bench [--vertices N] [--degree D] [--passes P] [--pin MODE]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<int> cpus = affinity::cpuOrder(options.pin);
+    std::cout << "nodes=" << affinity::numaNodes().size() << "\tthreads=" << cpus.size()
+              << "\tvertices=" << options.vertices << "\tdegree=" << options.degree << std::endl;
+
+    // Build the whole graph on the first CPU: every page lands on its node
+    Graph graph;
+    std::thread builder([&graph, &options, &cpus]()
+                        {
+        affinity::pinCurrentThread(cpus.front());
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<int> vertex(0, options.vertices - 1);
+        std::uniform_int_distribution<int> weight(1, 1000);
+        for (int i = 0; i < options.vertices; ++i)
+        {
+            graph.addVertex();
+        }
+        // A path keeps the graph connected, random edges fill in the degree
+        for (int i = 1; i < options.vertices; ++i)
+        {
+            graph.addEdge(i - 1, i, weight(rng));
+        }
+        long long extra = static_cast<long long>(options.vertices) * (options.degree / 2 - 1);
+        for (long long i = 0; i < extra; ++i)
+        {
+            graph.addEdge(vertex(rng), vertex(rng), weight(rng));
+        } });
+    builder.join();
+
+    RemoteReadCounter counter;
+    if (!counter.available())
+    {
+        std::cout << "note: perf events unavailable, remote reads not measured" << std::endl;
+    }
+
+    counter.start();
+    double singleNodeMs = runWorkload(graph, cpus, options.passes);
+    report("single-node", singleNodeMs, counter.stop());
+
+    graph.redistribute(cpus);
+
+    counter.start();
+    double spreadMs = runWorkload(graph, cpus, options.passes);
+    report("redistributed", spreadMs, counter.stop());
+    return 0;
+}
@@ -53,8 +53,9 @@ int main()
         // Get user input
         std::string input;
         std::getline(std::cin, input);
-        // Send user input to the server
-        send(sock, input.c_str(), input.length(), 0);
+        // Send user input to the server, one line per command
+        std::string line = input + "\n";
+        send(sock, line.c_str(), line.length(), 0);
 
         // Check if user wants to exit
         if (input == "exit" || input == "9")
@@ -0,0 +1,508 @@
+// This file implements a load generator for the server's binary protocol.
+//
+// It builds a synthetic graph, opens N connections and drives a weighted mix
+// of commands against it for a fixed duration, then reports throughput and
+// latency percentiles per command type.
+//
+// Closed loop (default): every connection sends a request, waits for its
+// response and sends the next one. Open loop (--rate R): requests are sent on
+// a fixed schedule of R per second in total whether or not earlier ones were
+// answered, and latency is measured from the scheduled send time, so time
+// spent queued behind a slow response is counted (no coordinated omission).
+
+#include "../common/Protocol.hpp"
+#include "../utils/histogram.hpp"
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace protocol;
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    enum Command
+    {
+        ADD_EDGE_COMMAND,
+        REMOVE_EDGE_COMMAND,
+        CHANGE_WEIGHT_COMMAND,
+        MST_COMMAND,
+        QUERY_COMMAND,
+        PING_COMMAND,
+        COMMAND_COUNT
+    };
+
+    const char *const COMMAND_NAMES[COMMAND_COUNT] = {"add_edge", "remove_edge", "change_weight", "mst", "query", "ping"};
+
+    struct Options
+    {
+        std::string host = "127.0.0.1";
+        int port = 9040;
+        int connections = 4;
+        double durationSec = 10;
+        // total requests per second over all connections; 0 runs closed loop
+        double rate = 0;
+        int vertices = 1000;
+        int edges = 5000;
+        std::string graph = "loadgen";
+        std::string mix = "add_edge=40,change_weight=20,mst=20,query=10,ping=10";
+        unsigned seed = 1;
+    };
+
+    // Outcome counters and latencies of one connection (merged at the end)
+    struct Stats
+    {
+        Histogram latencyMicros[COMMAND_COUNT];
+        uint64_t ok[COMMAND_COUNT] = {};
+        uint64_t busy[COMMAND_COUNT] = {};
+        uint64_t errors[COMMAND_COUNT] = {};
+
+        void add(int command, uint16_t status, uint64_t micros)
+        {
+            if (status == OK)
+            {
+                ++ok[command];
+                latencyMicros[command].record(micros);
+            }
+            else if (status == BUSY)
+            {
+                ++busy[command];
+            }
+            else
+            {
+                ++errors[command];
+            }
+        }
+
+        void merge(const Stats &other)
+        {
+            for (int i = 0; i < COMMAND_COUNT; ++i)
+            {
+                latencyMicros[i].merge(other.latencyMicros[i]);
+                ok[i] += other.ok[i];
+                busy[i] += other.busy[i];
+                errors[i] += other.errors[i];
+            }
+        }
+    };
+
+    // A blocking binary protocol connection
+    class Connection
+    {
+    public:
+        Connection(const std::string &host, int port)
+        {
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo *result = nullptr;
+            if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+            {
+                throw std::runtime_error("Cannot resolve " + host);
+            }
+            socket_ = -1;
+            for (addrinfo *entry = result; entry != nullptr && socket_ == -1; entry = entry->ai_next)
+            {
+                socket_ = socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+                if (socket_ != -1 && connect(socket_, entry->ai_addr, entry->ai_addrlen) != 0)
+                {
+                    close(socket_);
+                    socket_ = -1;
+                }
+            }
+            freeaddrinfo(result);
+            if (socket_ == -1)
+            {
+                throw std::runtime_error("Cannot connect to " + host + ":" + std::to_string(port));
+            }
+        }
+
+        ~Connection()
+        {
+            close(socket_);
+        }
+
+        void send(const std::string &data)
+        {
+            size_t sent = 0;
+            while (sent < data.size())
+            {
+                ssize_t n = ::send(socket_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (n <= 0)
+                {
+                    throw std::runtime_error("Connection lost while sending");
+                }
+                sent += n;
+            }
+        }
+
+        // Block until a whole frame arrived; false if the server closed the connection
+        bool receive(Frame &frame)
+        {
+            while (true)
+            {
+                size_t offset = 0;
+                if (parseFrame(buffer_, offset, frame))
+                {
+                    buffer_.erase(0, offset);
+                    return true;
+                }
+                char chunk[65536];
+                ssize_t n = read(socket_, chunk, sizeof(chunk));
+                if (n <= 0)
+                {
+                    return false;
+                }
+                buffer_.append(chunk, n);
+            }
+        }
+
+        // Send one request and wait for its response
+        Frame call(uint8_t opcode, const std::string &payload = "")
+        {
+            std::string request;
+            appendFrame(request, opcode, OK, nextId_++, payload);
+            send(request);
+            Frame response;
+            if (!receive(response))
+            {
+                throw std::runtime_error("Server closed the connection");
+            }
+            return response;
+        }
+
+        void shutdownWrite()
+        {
+            shutdown(socket_, SHUT_WR);
+        }
+
+    private:
+        int socket_;
+        std::string buffer_;
+        uint32_t nextId_ = 1;
+    };
+
+    std::string stringPayload(const std::string &value)
+    {
+        std::string payload;
+        PayloadWriter(payload).str(value);
+        return payload;
+    }
+
+    // Parse "name=weight,..." into per-command weights
+    std::vector<double> parseMix(const std::string &mix)
+    {
+        std::vector<double> weights(COMMAND_COUNT, 0.0);
+        std::stringstream ss(mix);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            size_t equals = item.find('=');
+            std::string name = item.substr(0, equals);
+            int command = 0;
+            while (command < COMMAND_COUNT && name != COMMAND_NAMES[command])
+            {
+                ++command;
+            }
+            if (command == COMMAND_COUNT || equals == std::string::npos)
+            {
+                throw std::invalid_argument("Bad mix entry: " + item);
+            }
+            weights[command] = std::stod(item.substr(equals + 1));
+        }
+        return weights;
+    }
+
+    // Create (or reuse) the benchmark graph and fill it with a connected random graph
+    void setUpGraph(const Options &options)
+    {
+        Connection setup(options.host, options.port);
+        setup.call(CREATE_GRAPH, stringPayload(options.graph)); // fails harmlessly if it exists
+        if (setup.call(SELECT_GRAPH, stringPayload(options.graph)).status != OK)
+        {
+            throw std::runtime_error("Cannot select graph " + options.graph);
+        }
+
+        std::mt19937 rng(options.seed);
+        std::uniform_int_distribution<int> vertex(0, options.vertices - 1);
+        std::uniform_int_distribution<int> weight(1, 1000);
+        int edges = std::max(options.edges, options.vertices - 1);
+        std::string payload;
+        PayloadWriter writer(payload);
+        writer.i32(options.vertices);
+        writer.i32(edges);
+        for (int i = 0; i < edges; ++i)
+        {
+            // A path keeps the graph connected, the rest are random
+            int source = i < options.vertices - 1 ? i : vertex(rng);
+            int destination = i < options.vertices - 1 ? i + 1 : vertex(rng);
+            writer.i32(source);
+            writer.i32(destination);
+            writer.i32(weight(rng));
+        }
+        Frame response = setup.call(BUILD_GRAPH, payload);
+        if (response.status != OK)
+        {
+            throw std::runtime_error("Building the graph failed");
+        }
+    }
+
+    // Encode the request for a command against random vertices
+    std::string makeRequest(int command, uint32_t requestId, const Options &options, std::mt19937 &rng)
+    {
+        std::uniform_int_distribution<int> vertex(0, options.vertices - 1);
+        std::uniform_int_distribution<int> weight(1, 1000);
+        std::string payload;
+        PayloadWriter writer(payload);
+        uint8_t opcode = PING;
+        switch (command)
+        {
+        case ADD_EDGE_COMMAND:
+            opcode = ADD_EDGE;
+            writer.i32(vertex(rng));
+            writer.i32(vertex(rng));
+            writer.i32(weight(rng));
+            break;
+        case REMOVE_EDGE_COMMAND:
+            opcode = REMOVE_EDGE;
+            writer.i32(vertex(rng));
+            writer.i32(vertex(rng));
+            break;
+        case CHANGE_WEIGHT_COMMAND:
+            opcode = CHANGE_WEIGHT;
+            writer.i32(vertex(rng));
+            writer.i32(vertex(rng));
+            writer.i32(weight(rng));
+            break;
+        case MST_COMMAND:
+            opcode = COMPUTE_MST;
+            writer.str("Prim");
+            break;
+        case QUERY_COMMAND:
+            opcode = QUERY_MST;
+            writer.str("Kruskal");
+            break;
+        }
+        std::string request;
+        appendFrame(request, opcode, OK, requestId, payload);
+        return request;
+    }
+
+    uint64_t microsSince(Clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    }
+
+    // One connection in closed loop: send, wait for the answer, repeat
+    void runClosedLoop(const Options &options, const std::vector<double> &mix, unsigned seed, Clock::time_point end, Stats &stats)
+    {
+        Connection connection(options.host, options.port);
+        connection.call(SELECT_GRAPH, stringPayload(options.graph));
+        std::mt19937 rng(seed);
+        std::discrete_distribution<int> pick(mix.begin(), mix.end());
+        uint32_t requestId = 1;
+        Frame response;
+        while (Clock::now() < end)
+        {
+            int command = pick(rng);
+            Clock::time_point start = Clock::now();
+            connection.send(makeRequest(command, requestId++, options, rng));
+            if (!connection.receive(response))
+            {
+                throw std::runtime_error("Server closed the connection");
+            }
+            stats.add(command, response.status, microsSince(start));
+        }
+    }
+
+    // One connection in open loop: a sender keeps a fixed schedule while a
+    // receiver matches responses to their scheduled send times by request ID
+    void runOpenLoop(const Options &options, const std::vector<double> &mix, unsigned seed, Clock::time_point end, Stats &stats)
+    {
+        Connection connection(options.host, options.port);
+        connection.call(SELECT_GRAPH, stringPayload(options.graph));
+        auto interval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(options.connections / options.rate));
+
+        std::mutex mutex;
+        std::map<uint32_t, std::pair<int, Clock::time_point>> pending;
+        std::thread receiver([&]()
+                             {
+            Frame response;
+            while (connection.receive(response))
+            {
+                std::pair<int, Clock::time_point> sent;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    auto it = pending.find(response.requestId);
+                    if (it == pending.end())
+                    {
+                        continue;
+                    }
+                    sent = it->second;
+                    pending.erase(it);
+                }
+                stats.add(sent.first, response.status, microsSince(sent.second));
+            } });
+
+        std::mt19937 rng(seed);
+        std::discrete_distribution<int> pick(mix.begin(), mix.end());
+        uint32_t requestId = 1;
+        for (Clock::time_point scheduled = Clock::now(); scheduled < end; scheduled += interval)
+        {
+            std::this_thread::sleep_until(scheduled);
+            int command = pick(rng);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending[requestId] = std::make_pair(command, scheduled);
+            }
+            connection.send(makeRequest(command, requestId++, options, rng));
+        }
+
+        // The server answers everything sent before it sees the end of input
+        connection.shutdownWrite();
+        receiver.join();
+    }
+
+    void report(const Options &options, const Stats &stats, double seconds)
+    {
+        std::printf("%-14s %10s %8s %8s %10s %9s %9s %9s %9s\n",
+                    "command", "ok", "busy", "errors", "ops/s", "p50_us", "p99_us", "p999_us", "max_us");
+        uint64_t total = 0;
+        for (int i = 0; i < COMMAND_COUNT; ++i)
+        {
+            const Histogram &latency = stats.latencyMicros[i];
+            if (stats.ok[i] + stats.busy[i] + stats.errors[i] == 0)
+            {
+                continue;
+            }
+            total += stats.ok[i];
+            std::printf("%-14s %10llu %8llu %8llu %10.1f %9llu %9llu %9llu %9llu\n", COMMAND_NAMES[i],
+                        (unsigned long long)stats.ok[i], (unsigned long long)stats.busy[i],
+                        (unsigned long long)stats.errors[i], stats.ok[i] / seconds,
+                        (unsigned long long)latency.valueAtPercentile(50), (unsigned long long)latency.valueAtPercentile(99),
+                        (unsigned long long)latency.valueAtPercentile(99.9), (unsigned long long)latency.max());
+        }
+        std::printf("total: %llu ok in %.2f s = %.1f ops/s (%s, %d connections)\n", (unsigned long long)total, seconds,
+                    total / seconds, options.rate > 0 ? "open loop" : "closed loop", options.connections);
+    }
+
+    const char *USAGE =
+        "Usage: loadgen [--host H] [--port N] [--connections N] [--duration-s S]\n"
+        "               [--rate OPS_PER_S] [--vertices N] [--edges N] [--graph NAME]\n"
+        "               [--mix add_edge=40,change_weight=20,mst=20,query=10,ping=10] [--seed N]";
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    std::vector<double> mix;
+    try
+    {
+        for (int i = 1; i < argc; i += 2)
+        {
+            std::string flag = argv[i];
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument("Missing value for " + flag);
+            }
+            std::string value = argv[i + 1];
+            if (flag == "--host")
+                options.host = value;
+            else if (flag == "--port")
+                options.port = std::stoi(value);
+            else if (flag == "--connections")
+                options.connections = std::stoi(value);
+            else if (flag == "--duration-s")
+                options.durationSec = std::stod(value);
+            else if (flag == "--rate")
+                options.rate = std::stod(value);
+            else if (flag == "--vertices")
+                options.vertices = std::stoi(value);
+            else if (flag == "--edges")
+                options.edges = std::stoi(value);
+            else if (flag == "--graph")
+                options.graph = value;
+            else if (flag == "--mix")
+                options.mix = value;
+            else if (flag == "--seed")
+                options.seed = std::stoul(value);
+            else
+                throw std::invalid_argument("Unknown option " + flag);
+        }
+        if (options.connections < 1 || options.vertices < 2)
+        {
+            throw std::invalid_argument("Need at least one connection and two vertices");
+        }
+        mix = parseMix(options.mix);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n" << USAGE << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        setUpGraph(options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Setup failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<Stats> stats(options.connections);
+    std::vector<std::thread> threads;
+    std::atomic<int> failures(0);
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.durationSec));
+    for (int i = 0; i < options.connections; ++i)
+    {
+        threads.emplace_back([&, i]()
+                             {
+            try
+            {
+                if (options.rate > 0)
+                {
+                    runOpenLoop(options, mix, options.seed + i + 1, end, stats[i]);
+                }
+                else
+                {
+                    runClosedLoop(options, mix, options.seed + i + 1, end, stats[i]);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "connection " << i << ": " << e.what() << std::endl;
+                ++failures;
+            } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    Stats total;
+    for (const Stats &connectionStats : stats)
+    {
+        total.merge(connectionStats);
+    }
+    report(options, total, seconds);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,48 @@
+#include "CommandCost.hpp"
+#include <cmath>
+
+// Sorting/heap work of Prim and Kruskal is O(E log E); the metrics run
+// Floyd-Warshall over all vertex pairs, which dominates at O(V^3).
+double CommandCost::estimate(const std::string &command, long long vertices, long long edges)
+{
+    double v = static_cast<double>(vertices);
+    double e = static_cast<double>(edges);
+    double mst = v + e * std::log2(e + 2.0);
+
+    if (command == "mst")
+    {
+        return mst;
+    }
+    if (command == "metrics")
+    {
+        return mst + v * v * v;
+    }
+    if (command == "print_graph" || command == "remove_vertex")
+    {
+        return v + e;
+    }
+    // Single-edge and single-vertex mutations
+    return 1.0;
+}
+
+CostClass CommandCost::classify(double cost, double interactiveLimit, double heavyLimit)
+{
+    if (cost < interactiveLimit)
+    {
+        return CostClass::Interactive;
+    }
+    return cost < heavyLimit ? CostClass::Normal : CostClass::Heavy;
+}
+
+const char *CommandCost::name(CostClass costClass)
+{
+    switch (costClass)
+    {
+    case CostClass::Interactive:
+        return "interactive";
+    case CostClass::Normal:
+        return "normal";
+    default:
+        return "heavy";
+    }
+}
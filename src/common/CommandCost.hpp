@@ -0,0 +1,22 @@
+#pragma once
+#include <string>
+
+// Cost classes used by the scheduler, cheapest first
+enum class CostClass
+{
+    Interactive, // run inline by the session, never queued
+    Normal,
+    Heavy
+};
+
+// Estimates the work of a command from the size of the graph it runs on.
+// The estimate is in rough "basic operations"; only its magnitude matters.
+class CommandCost
+{
+public:
+    // estimate the cost of a command ("mst", "metrics", "print_graph", or any mutation)
+    static double estimate(const std::string &command, long long vertices, long long edges);
+    // map an estimate to a class using the configured limits
+    static CostClass classify(double cost, double interactiveLimit, double heavyLimit);
+    static const char *name(CostClass costClass);
+};
@@ -1,12 +1,71 @@
 #include "Graph.hpp"
 #include <algorithm>
+#include <numeric>
 #include <iostream>
 #include <sstream>
-#include "../utils/threadpool.hpp"
+#include <iomanip>
+#include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include "GraphSerializer.hpp"
+#include "../utils/affinity.hpp"
 
 // This file implements the Graph class, which represents an undirected weighted graph.
 
-int Graph::nextVertexId = 0;
+namespace
+{
+    // A new edge list and its control block, in one slab pool block
+    template <typename... Args>
+    std::shared_ptr<EdgeList> makeEdgeList(Args &&...args)
+    {
+        return std::allocate_shared<EdgeList>(SlabAllocator<EdgeList>(), std::forward<Args>(args)...);
+    }
+}
+
+// Writable slot of an existing vertex; a chunk still shared with another
+// table (an older snapshot's) is cloned first, which copies only its pointers
+std::shared_ptr<EdgeList> &VertexTable::slot(int vertex)
+{
+    if (!contains(vertex))
+    {
+        throw std::out_of_range("Vertex " + std::to_string(vertex) + " does not exist");
+    }
+    std::shared_ptr<Chunk> &chunk = chunks_[vertex >> CHUNK_BITS];
+    if (chunk.use_count() > 1)
+    {
+        chunk = std::make_shared<Chunk>(*chunk);
+    }
+    else
+    {
+        // Sole owner: pair with the release in the last reader's reference drop
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return (*chunk)[vertex & (CHUNK_SIZE - 1)];
+}
+
+// Appends the next vertex, starting a new chunk when the last one is full
+void VertexTable::push_back(std::shared_ptr<EdgeList> edges)
+{
+    if ((size_ & (CHUNK_SIZE - 1)) == 0)
+    {
+        chunks_.push_back(std::make_shared<Chunk>());
+    }
+    ++size_;
+    slot(size_ - 1) = std::move(edges);
+}
+
+// Makes room for the chunk pointers of this many vertices
+void VertexTable::reserve(int vertices)
+{
+    chunks_.reserve((static_cast<size_t>(vertices) + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+// Drops every vertex and frees the chunk pointer array
+void VertexTable::clear()
+{
+    std::vector<std::shared_ptr<Chunk>>().swap(chunks_);
+    size_ = 0;
+}
 
 // Default constructor: Initializes an empty graph
 Graph::Graph()
@@ -19,34 +78,136 @@ Graph::Graph()
 Graph::Graph(int numVertices)
 {
     // Initialize the graph with 'numVertices' vertices, each with an empty edge list
+    adjacencyList.reserve(numVertices);
     for (int i = 0; i < numVertices; ++i)
     {
-        adjacencyList[i] = std::vector<Edge>();
+        adjacencyList.push_back(makeEdgeList());
+    }
+}
+
+// Constructor over packed adjacency (vertex IDs are the indices)
+Graph::Graph(std::shared_ptr<const CompactAdjacency> adjacency) : compactAdjacency(std::move(adjacency))
+{
+}
+
+// Returns a writable edge list for an existing vertex.
+// A list (or chunk of the vertex table) still shared with another graph, an
+// older snapshot, is cloned first, so published snapshots are never modified.
+EdgeList &Graph::mutableEdges(int vertex)
+{
+    expand();
+    auto &edges = adjacencyList.slot(vertex);
+    if (edges.use_count() > 1)
+    {
+        edges = makeEdgeList(*edges);
+    }
+    else
+    {
+        // Sole owner: pair with the release in the last reader's reference drop
+        std::atomic_thread_fence(std::memory_order_acquire);
     }
+    return *edges;
 }
 
 // Adds an edge between two vertices with a specified weight
 void Graph::addEdge(int source, int destination, int weight)
 {
-    safePrint("Debug: Adding edge " + std::to_string(source) + " - " + std::to_string(destination) + " with weight " + std::to_string(weight));
+    // Vertex IDs are dense (0..V-1), the MST algorithms index arrays by them
+    if (!hasVertex(source) || !hasVertex(destination))
+    {
+        throw std::out_of_range("Edge " + std::to_string(source) + " - " + std::to_string(destination) + " refers to a missing vertex");
+    }
     // Add the edge in both directions (undirected graph)
-    adjacencyList[source].push_back(Edge(source, destination, weight));
-    adjacencyList[destination].push_back(Edge(destination, source, weight));
+    mutableEdges(source).push_back(Edge(source, destination, weight));
+    mutableEdges(destination).push_back(Edge(destination, source, weight));
+}
+
+// Adds the part of a bulk load that lands in one range of vertices.
+// Each list grows once to its final size (degrees are counted first), so a
+// large load does not re-allocate lists as they fill.
+void Graph::addEdgesInRange(const std::vector<std::vector<Edge>> &batches, int firstVertex, int lastVertex)
+{
+    // Not expanded here when packed or compressed: concurrent callers would race on it
+    if (storage() != AdjacencyStorage::Lists)
+    {
+        throw std::logic_error("addEdgesInRange on a " + std::string(storageName(storage())) + " graph");
+    }
+    int vertices = getVertices();
+    std::vector<size_t> degree(std::max(0, lastVertex - firstVertex), 0);
+    for (const std::vector<Edge> &batch : batches)
+    {
+        for (const Edge &edge : batch)
+        {
+            if (edge.source < 0 || edge.source >= vertices || edge.destination < 0 || edge.destination >= vertices)
+            {
+                throw std::out_of_range("Edge " + std::to_string(edge.source) + " - " + std::to_string(edge.destination) + " refers to a missing vertex");
+            }
+            if (edge.source >= firstVertex && edge.source < lastVertex)
+            {
+                ++degree[edge.source - firstVertex];
+            }
+            if (edge.destination >= firstVertex && edge.destination < lastVertex)
+            {
+                ++degree[edge.destination - firstVertex];
+            }
+        }
+    }
+
+    std::vector<EdgeList *> lists(degree.size());
+    for (size_t i = 0; i < lists.size(); ++i)
+    {
+        lists[i] = &mutableEdges(firstVertex + static_cast<int>(i));
+        lists[i]->reserve(lists[i]->size() + degree[i]);
+    }
+    for (const std::vector<Edge> &batch : batches)
+    {
+        for (const Edge &edge : batch)
+        {
+            if (edge.source >= firstVertex && edge.source < lastVertex)
+            {
+                lists[edge.source - firstVertex]->push_back(Edge(edge.source, edge.destination, edge.weight));
+            }
+            if (edge.destination >= firstVertex && edge.destination < lastVertex)
+            {
+                lists[edge.destination - firstVertex]->push_back(Edge(edge.destination, edge.source, edge.weight));
+            }
+        }
+    }
 }
 
 // Adds a new vertex to the graph and returns its ID
+// IDs are per graph and always the next free index, so graphs never affect each other's numbering
 int Graph::addVertex()
 {
-    int newVertexId = nextVertexId++;
-    adjacencyList[newVertexId] = std::vector<Edge>();
+    expand();
+    int newVertexId = adjacencyList.size();
+    adjacencyList.push_back(makeEdgeList());
     return newVertexId;
 }
 
 // Removes an edge between two vertices if it exists
 bool Graph::removeEdge(int source, int destination)
 {
-    auto &sourceEdges = adjacencyList[source];
-    auto &destEdges = adjacencyList[destination];
+    expand();
+    if (!adjacencyList.contains(source) || !adjacencyList.contains(destination))
+    {
+        return false;
+    }
+
+    auto hasEdgeTo = [](const EdgeList &edges, int target)
+    {
+        return std::any_of(edges.begin(), edges.end(),
+                           [target](const Edge &e)
+                           { return e.destination == target; });
+    };
+    if (!hasEdgeTo(*adjacencyList[source], destination) && !hasEdgeTo(*adjacencyList[destination], source))
+    {
+        return false;
+    }
+
+    // Only clone the lists once we know the edge exists
+    auto &sourceEdges = mutableEdges(source);
+    auto &destEdges = mutableEdges(destination);
 
     // Remove the edge from source to destination
     auto sourceIt = std::remove_if(sourceEdges.begin(), sourceEdges.end(),
@@ -69,34 +230,34 @@ bool Graph::removeEdge(int source, int destination)
 // Removes a vertex and all its connected edges from the graph
 bool Graph::removeVertex(int vertex)
 {
-    if (adjacencyList.find(vertex) == adjacencyList.end())
+    expand();
+    if (!adjacencyList.contains(vertex))
     {
         return false;
     }
 
-    // Remove all edges connected to this vertex
-    for (auto &pair : adjacencyList)
-    {
-        pair.second.erase(
-            std::remove_if(pair.second.begin(), pair.second.end(),
-                           [vertex](const Edge &e)
-                           { return e.destination == vertex; }),
-            pair.second.end());
-    }
-
-    // Remove the vertex itself
-    adjacencyList.erase(vertex);
-
-    // Update other vertex numbers if necessary
-    std::unordered_map<int, std::vector<Edge>> newAdjacencyList;
-    for (const auto &pair : adjacencyList)
+    // Drop the vertex and the edges to it, and update other vertex numbers.
+    // Every list is rebuilt, so nothing is shared with older snapshots afterwards.
+    VertexTable newAdjacencyList;
+    newAdjacencyList.reserve(adjacencyList.size() - 1);
+    for (int oldVertex = 0; oldVertex < adjacencyList.size(); ++oldVertex)
     {
-        int newVertex = pair.first > vertex ? pair.first - 1 : pair.first;
-        for (const Edge &e : pair.second)
+        if (oldVertex == vertex)
+        {
+            continue;
+        }
+        int newVertex = oldVertex > vertex ? oldVertex - 1 : oldVertex;
+        auto newEdges = makeEdgeList();
+        for (const Edge &e : *adjacencyList[oldVertex])
         {
+            if (e.destination == vertex)
+            {
+                continue;
+            }
             int newDest = e.destination > vertex ? e.destination - 1 : e.destination;
-            newAdjacencyList[newVertex].push_back({newVertex, newDest, e.weight});
+            newEdges->push_back({newVertex, newDest, e.weight});
         }
+        newAdjacencyList.push_back(std::move(newEdges));
     }
     adjacencyList = std::move(newAdjacencyList);
 
@@ -106,8 +267,26 @@ bool Graph::removeVertex(int vertex)
 // Changes the weight of an edge between two vertices
 bool Graph::changeWeight(int source, int destination, int newWeight)
 {
-    auto &sourceEdges = adjacencyList[source];
-    auto &destEdges = adjacencyList[destination];
+    expand();
+    if (!adjacencyList.contains(source) || !adjacencyList.contains(destination))
+    {
+        return false;
+    }
+
+    auto hasEdgeTo = [](const EdgeList &edges, int target)
+    {
+        return std::any_of(edges.begin(), edges.end(),
+                           [target](const Edge &e)
+                           { return e.destination == target; });
+    };
+    if (!hasEdgeTo(*adjacencyList[source], destination) || !hasEdgeTo(*adjacencyList[destination], source))
+    {
+        return false;
+    }
+
+    // Only clone the lists once we know the edge exists
+    auto &sourceEdges = mutableEdges(source);
+    auto &destEdges = mutableEdges(destination);
 
     // Find the edge in both directions
     auto sourceIt = std::find_if(sourceEdges.begin(), sourceEdges.end(),
@@ -117,11 +296,6 @@ bool Graph::changeWeight(int source, int destination, int newWeight)
                                [source](const Edge &e)
                                { return e.destination == source; });
 
-    if (sourceIt == sourceEdges.end() || destIt == destEdges.end())
-    {
-        return false;
-    }
-
     // Update the weight in both directions
     sourceIt->weight = newWeight;
     destIt->weight = newWeight;
@@ -129,30 +303,75 @@ bool Graph::changeWeight(int source, int destination, int newWeight)
     return true;
 }
 
+// Checks whether a vertex with the given ID exists
+bool Graph::hasVertex(int vertex) const
+{
+    if (const std::vector<size_t> *offsets = compactOffsets())
+    {
+        return vertex >= 0 && vertex < static_cast<int>(offsets->size()) - 1;
+    }
+    return adjacencyList.contains(vertex);
+}
+
 // Returns a vector of edges adjacent to a given vertex
 std::vector<Edge> Graph::getAdjacentEdges(int vertex) const
 {
-    auto it = adjacencyList.find(vertex);
-    if (it != adjacencyList.end())
+    std::vector<Edge> edges;
+    edges.reserve(degree(vertex));
+    forEachNeighbor(vertex, [&edges, vertex](int destination, int weight)
+                    { edges.push_back(Edge(vertex, destination, weight)); });
+    return edges;
+}
+
+// Returns the number of edges of a vertex (a self-loop counts twice)
+size_t Graph::degree(int vertex) const
+{
+    return hasVertex(vertex) ? degreeAt(indexOf(vertex)) : 0;
+}
+
+// Degree by internal index (which must exist)
+size_t Graph::degreeAt(int index) const
+{
+    if (const std::vector<size_t> *offsets = compactOffsets())
     {
-        return it->second;
+        return (*offsets)[index + 1] - (*offsets)[index];
     }
-    return std::vector<Edge>();
+    return adjacencyList[index]->size();
+}
+
+// Internal index of an existing vertex
+int Graph::indexOf(int vertex) const
+{
+    return vertexIndices ? (*vertexIndices)[vertex] : vertex;
+}
+
+// Vertex ID at an internal index
+int Graph::vertexAt(int index) const
+{
+    return vertexIds ? (*vertexIds)[index] : index;
 }
 
 // Returns the number of vertices in the graph
 int Graph::getVertices() const
 {
+    if (const std::vector<size_t> *offsets = compactOffsets())
+    {
+        return static_cast<int>(offsets->size()) - 1;
+    }
     return adjacencyList.size();
 }
 
 // Returns the number of edges in the graph
 int Graph::getEdges() const
 {
+    if (const std::vector<size_t> *offsets = compactOffsets())
+    {
+        return static_cast<int>(offsets->back() / 2);
+    }
     int count = 0;
-    for (const auto &pair : adjacencyList)
+    for (int vertex = 0; vertex < adjacencyList.size(); ++vertex)
     {
-        count += pair.second.size();
+        count += adjacencyList[vertex]->size();
     }
     return count / 2; // Each edge is counted twice in an undirected graph
 }
@@ -160,66 +379,614 @@ int Graph::getEdges() const
 // Prints the graph structure to the console
 void Graph::printGraph() const
 {
-    for (const auto &pair : adjacencyList)
+    for (int vertex = 0; vertex < getVertices(); ++vertex)
     {
-        std::cout << pair.first << ": ";
-        for (const auto &edge : pair.second)
-        {
-            std::cout << "(" << edge.source << ", " << edge.destination << ", " << edge.weight << ") ";
-        }
+        std::cout << vertex << ": ";
+        forEachNeighbor(vertex, [vertex](int destination, int weight)
+                        { std::cout << "(" << vertex << ", " << destination << ", " << weight << ") "; });
         std::cout << std::endl;
     }
 }
 
-// Returns a string representation of the graph
+// Returns a string representation of the graph, in vertex order.
+// Large graphs should be streamed with GraphSerializer instead.
 std::string Graph::toString() const
 {
-    std::ostringstream oss;
-    oss << "Debug: Graph has " << adjacencyList.size() << " vertices.\n";
-    for (const auto &pair : adjacencyList)
+    // Non-owning pointer: the serializer does not outlive this call
+    std::shared_ptr<const Graph> self(std::shared_ptr<const Graph>(), this);
+    return GraphSerializer(self, DumpFormat::Text).drain();
+}
+
+// Checks if the graph is connected (all vertices are reachable from any other vertex)
+bool Graph::isConnected() const
+{
+    if (getVertices() == 0)
+    {
+        return false; // An empty graph is not considered connected
+    }
+    return componentCount() == 1;
+}
+
+// Counts the connected components with a breadth-first search from every
+// vertex not reached yet
+int Graph::componentCount() const
+{
+    int vertices = getVertices();
+    std::vector<bool> visited(vertices, false);
+    std::vector<int> queue;
+    queue.reserve(vertices);
+    int components = 0;
+    for (int start = 0; start < vertices; ++start)
     {
-        oss << "Vertex " << pair.first << ":\n";
-        oss << "Debug: This vertex has " << pair.second.size() << " edges.\n";
-        if (pair.second.empty())
+        if (visited[start])
         {
-            oss << "  (no edges)\n";
+            continue;
         }
-        else
+        ++components;
+        visited[start] = true;
+        queue.clear();
+        queue.push_back(start);
+        for (size_t head = 0; head < queue.size(); ++head)
         {
-            for (const auto &edge : pair.second)
+            forEachNeighborAt(queue[head], [&visited, &queue](int destination, int)
+                              {
+                if (!visited[destination])
+                {
+                    visited[destination] = true;
+                    queue.push_back(destination);
+                } });
+        }
+    }
+    return components;
+}
+
+// Checks if the graph has been initialized with any vertices
+bool Graph::isInitialized() const
+{
+    return getVertices() > 0; // Returns true if the graph has any vertex
+}
+
+// Clears all vertices and edges from the graph
+void Graph::clear()
+{
+    adjacencyList.clear(); // Removes every vertex's list
+    compactAdjacency.reset();
+    compressedAdjacency.reset();
+    vertexIds.reset();
+    vertexIndices.reset();
+    // Vertex IDs start again from 0 on the next addVertex()
+}
+
+// Returns the snapshot version this graph was published as
+uint64_t Graph::getVersion() const
+{
+    return version;
+}
+
+// Sets the snapshot version (called by GraphStore when publishing)
+void Graph::setVersion(uint64_t newVersion)
+{
+    version = newVersion;
+}
+
+// Re-allocates every adjacency list from threads pinned to the given CPUs, one
+// contiguous stripe of vertices per CPU. The pages of a large graph are then
+// spread over the NUMA nodes of those CPUs instead of all sitting on the node
+// of the thread that happened to build it. Lists up to SlabPool::MAX_SIZE
+// bytes may reuse freed slab blocks touched elsewhere, so only the larger
+// lists are placed exactly.
+void Graph::redistribute(const std::vector<int> &cpus)
+{
+    if (compactAdjacency)
+    {
+        // One array: let each CPU first-touch the stripe of it that it copies
+        auto placed = std::make_shared<CompactAdjacency>();
+        placed->offsets = compactAdjacency->offsets;
+        placed->neighbors.reset(new Neighbor[compactAdjacency->neighborCount()]);
+        const CompactAdjacency &source = *compactAdjacency;
+        affinity::parallelStripes(source.vertices(), cpus, [&source, &placed](size_t begin, size_t end)
+                                  { std::copy(source.neighbors.get() + source.offsets[begin],
+                                              source.neighbors.get() + source.offsets[end],
+                                              placed->neighbors.get() + source.offsets[begin]); });
+        compactAdjacency = std::move(placed);
+        return;
+    }
+    if (compressedAdjacency)
+    {
+        // Small enough per edge that its placement matters little; left as is
+        return;
+    }
+
+    // Take every slot up front: unsharing a chunk is not safe to do in parallel
+    std::vector<std::shared_ptr<EdgeList> *> lists(adjacencyList.size());
+    for (int vertex = 0; vertex < adjacencyList.size(); ++vertex)
+    {
+        lists[vertex] = &adjacencyList.slot(vertex);
+    }
+
+    affinity::parallelStripes(lists.size(), cpus, [&lists](size_t begin, size_t end)
+                              {
+        for (size_t i = begin; i < end; ++i)
+        {
+            std::shared_ptr<EdgeList> &edges = *lists[i];
+            // Copy into a freshly allocated, exactly sized list (first touch on this node)
+            auto local = makeEdgeList();
+            local->reserve(edges->size());
+            local->assign(edges->begin(), edges->end());
+            edges = std::move(local);
+        } });
+}
+
+// Converts the adjacency to the requested form, from whichever form it is in.
+// Lists cost 12 bytes per Edge plus growth slack, and each vertex adds a table
+// slot and a list header. Packed costs 8 bytes per edge direction and one
+// offset per vertex; Compressed typically 2-4 bytes, but decodes as it reads.
+void Graph::compact(AdjacencyStorage target)
+{
+    if (target == storage())
+    {
+        return;
+    }
+    // A reordered graph keeps its order across compact forms
+    std::shared_ptr<const std::vector<int>> order = vertexIds;
+    expand();
+    if (target == AdjacencyStorage::Lists)
+    {
+        return;
+    }
+    if (order)
+    {
+        applyOrder(order);
+    }
+    buildCompact(target);
+}
+
+// Replaces the lists with the given compact form of them
+void Graph::buildCompact(AdjacencyStorage target)
+{
+    if (target == AdjacencyStorage::Packed)
+    {
+        compactAdjacency = packAdjacency();
+    }
+    else
+    {
+        compressedAdjacency = compressAdjacency();
+    }
+    adjacencyList.clear();
+}
+
+// The offsets of whichever compact form is set (null for lists)
+const std::vector<size_t> *Graph::compactOffsets() const
+{
+    if (compactAdjacency)
+    {
+        return &compactAdjacency->offsets;
+    }
+    if (compressedAdjacency)
+    {
+        return &compressedAdjacency->offsets;
+    }
+    return nullptr;
+}
+
+// Copies the lists into one CompactAdjacency, in list order
+std::shared_ptr<const CompactAdjacency> Graph::packAdjacency() const
+{
+    int vertices = getVertices();
+    auto packed = std::make_shared<CompactAdjacency>();
+    packed->offsets.resize(vertices + 1);
+    packed->offsets[0] = 0;
+    for (int vertex = 0; vertex < vertices; ++vertex)
+    {
+        packed->offsets[vertex + 1] = packed->offsets[vertex] + adjacencyList[vertex]->size();
+    }
+    packed->neighbors.reset(new Neighbor[packed->neighborCount()]);
+    Neighbor *out = packed->neighbors.get();
+    for (int vertex = 0; vertex < vertices; ++vertex)
+    {
+        for (const Edge &edge : *adjacencyList[vertex])
+        {
+            *out++ = {edge.destination, edge.weight};
+        }
+    }
+    return packed;
+}
+
+namespace
+{
+    // Append value in little-endian order using exactly length bytes
+    void appendValue(std::vector<uint8_t> &out, uint32_t value, int length)
+    {
+        for (int i = 0; i < length; ++i)
+        {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    int valueLength(uint32_t value)
+    {
+        return value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+    }
+
+    // Append values as group varint: per group of four, a tag byte with each
+    // value's length minus one in 2 bits (first value lowest), then the values
+    void appendGroupVarint(std::vector<uint8_t> &out, const std::vector<uint32_t> &values)
+    {
+        for (size_t first = 0; first < values.size(); first += 4)
+        {
+            size_t group = std::min<size_t>(4, values.size() - first);
+            uint8_t tag = 0;
+            for (size_t k = 0; k < group; ++k)
+            {
+                tag |= static_cast<uint8_t>((valueLength(values[first + k]) - 1) << (2 * k));
+            }
+            out.push_back(tag);
+            for (size_t k = 0; k < group; ++k)
             {
-                oss << "  -> " << edge.destination << " (weight: " << edge.weight << ")\n";
+                appendValue(out, values[first + k], valueLength(values[first + k]));
             }
         }
     }
-    return oss.str();
 }
 
-// Checks if the graph is connected (all vertices are reachable from any other vertex)
-bool Graph::isConnected() const
+// Encodes the lists into one CompressedAdjacency (see its description)
+std::shared_ptr<const CompressedAdjacency> Graph::compressAdjacency() const
 {
-    if (adjacencyList.empty())
+    int vertices = getVertices();
+    auto compressed = std::make_shared<CompressedAdjacency>();
+    compressed->offsets.resize(vertices + 1);
+    compressed->dataOffsets.resize(vertices + 1);
+    compressed->offsets[0] = 0;
+
+    // The weight width is chosen from the range of all weights
+    int minWeight = 0, maxWeight = 0;
+    bool any = false;
+    for (int vertex = 0; vertex < vertices; ++vertex)
     {
-        return false; // An empty graph is not considered connected
+        const EdgeList &edges = *adjacencyList[vertex];
+        compressed->offsets[vertex + 1] = compressed->offsets[vertex] + edges.size();
+        for (const Edge &edge : edges)
+        {
+            minWeight = any ? std::min(minWeight, edge.weight) : edge.weight;
+            maxWeight = any ? std::max(maxWeight, edge.weight) : edge.weight;
+            any = true;
+        }
     }
+    uint32_t range = static_cast<uint32_t>(maxWeight) - static_cast<uint32_t>(minWeight);
+    compressed->minWeight = minWeight;
+    compressed->weightBytes = range < (1u << 8) ? 1 : range < (1u << 16) ? 2 : 4;
+    compressed->weights.reserve(compressed->neighborCount() * compressed->weightBytes);
 
-    // Note: This implementation is incorrect and always returns true
-    // A proper implementation would use a graph traversal algorithm (e.g., DFS or BFS)
-    // to check if all vertices are reachable from a single starting point
-    return true;
+    std::vector<Neighbor> sorted;
+    std::vector<uint32_t> gaps;
+    for (int vertex = 0; vertex < vertices; ++vertex)
+    {
+        const EdgeList &edges = *adjacencyList[vertex];
+        sorted.clear();
+        for (const Edge &edge : edges)
+        {
+            sorted.push_back({edge.destination, edge.weight});
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Neighbor &a, const Neighbor &b)
+                  { return a.destination != b.destination ? a.destination < b.destination : a.weight < b.weight; });
+
+        gaps.clear();
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+            if (i == 0)
+            {
+                int distance = sorted[0].destination - vertex;
+                gaps.push_back((static_cast<uint32_t>(distance) << 1) ^ static_cast<uint32_t>(distance >> 31)); // zigzag
+            }
+            else
+            {
+                gaps.push_back(static_cast<uint32_t>(sorted[i].destination - sorted[i - 1].destination));
+            }
+            appendValue(compressed->weights, static_cast<uint32_t>(sorted[i].weight) - static_cast<uint32_t>(minWeight), compressed->weightBytes);
+        }
+        compressed->dataOffsets[vertex] = compressed->data.size();
+        appendGroupVarint(compressed->data, gaps);
+    }
+    compressed->dataOffsets[vertices] = compressed->data.size();
+    // The decoder loads whole 32-bit words, the last value may start 1 byte from the end
+    compressed->data.insert(compressed->data.end(), 3, 0);
+    compressed->data.shrink_to_fit();
+    return compressed;
 }
 
-// Checks if the graph has been initialized with any vertices
-bool Graph::isInitialized() const
+// The form the adjacency is currently held in
+AdjacencyStorage Graph::storage() const
 {
-    return !adjacencyList.empty(); // Returns true if the adjacency list is not empty
+    if (compactAdjacency)
+    {
+        return AdjacencyStorage::Packed;
+    }
+    if (compressedAdjacency)
+    {
+        return AdjacencyStorage::Compressed;
+    }
+    return AdjacencyStorage::Lists;
 }
 
-// Clears all vertices and edges from the graph
-void Graph::clear()
+const char *Graph::storageName(AdjacencyStorage storage)
+{
+    switch (storage)
+    {
+    case AdjacencyStorage::Packed:
+        return "packed";
+    case AdjacencyStorage::Compressed:
+        return "compressed";
+    default:
+        return "lists";
+    }
+}
+
+AdjacencyStorage Graph::parseStorage(const std::string &name)
+{
+    for (AdjacencyStorage storage : {AdjacencyStorage::Lists, AdjacencyStorage::Packed, AdjacencyStorage::Compressed})
+    {
+        if (name == storageName(storage))
+        {
+            return storage;
+        }
+    }
+    throw std::invalid_argument("Unknown storage '" + name + "' (expected lists, packed or compressed)");
+}
+
+// Renumbers the vertices so that the one placed at index i is the one the
+// order computes for it, and keeps the resulting compact form
+void Graph::reorder(VertexOrder order)
+{
+    AdjacencyStorage target = storage() == AdjacencyStorage::Lists ? AdjacencyStorage::Packed : storage();
+    std::vector<int> sequence = computeOrder(order);
+    auto ids = std::make_shared<std::vector<int>>(sequence.size());
+    for (size_t index = 0; index < sequence.size(); ++index)
+    {
+        (*ids)[index] = vertexAt(sequence[index]);
+    }
+    expand();
+    applyOrder(std::move(ids));
+    buildCompact(target);
+}
+
+bool Graph::isReordered() const
 {
-    adjacencyList.clear(); // Removes all entries from the adjacency list
-    // The comment below is in Hebrew and states:
-    // "There's no need to reset nextVertexId here"
-    // אין צורך לאפס את nextVertexId כאן
+    return vertexIds != nullptr;
+}
+
+// The current indices in the new order: breadth-first orders are built one
+// component at a time, so every vertex lands next to the vertices that
+// reached it
+std::vector<int> Graph::computeOrder(VertexOrder order) const
+{
+    int vertices = getVertices();
+    std::vector<int> byDegree(vertices);
+    std::iota(byDegree.begin(), byDegree.end(), 0);
+    auto lowerDegree = [this](int a, int b)
+    { return degreeAt(a) < degreeAt(b); };
+    if (order == VertexOrder::Degree)
+    {
+        std::stable_sort(byDegree.begin(), byDegree.end(), [this](int a, int b)
+                         { return degreeAt(a) > degreeAt(b); });
+        return byDegree;
+    }
+    if (order == VertexOrder::Rcm)
+    {
+        // A low-degree start sits at the rim of its component, which keeps the
+        // breadth-first levels (and so the bandwidth) narrow
+        std::stable_sort(byDegree.begin(), byDegree.end(), lowerDegree);
+    }
+
+    std::vector<int> sequence;
+    sequence.reserve(vertices);
+    std::vector<bool> visited(vertices, false);
+    for (int start : byDegree)
+    {
+        if (visited[start])
+        {
+            continue;
+        }
+        visited[start] = true;
+        size_t head = sequence.size();
+        sequence.push_back(start);
+        for (; head < sequence.size(); ++head)
+        {
+            size_t firstNew = sequence.size();
+            forEachNeighborAt(sequence[head], [&visited, &sequence](int destination, int)
+                              {
+                if (!visited[destination])
+                {
+                    visited[destination] = true;
+                    sequence.push_back(destination);
+                } });
+            if (order == VertexOrder::Rcm)
+            {
+                std::stable_sort(sequence.begin() + firstNew, sequence.end(), lowerDegree);
+            }
+        }
+    }
+    if (order == VertexOrder::Rcm)
+    {
+        std::reverse(sequence.begin(), sequence.end());
+    }
+    return sequence;
+}
+
+// Rewrites the lists (in ID order) so that list i holds the vertex order[i],
+// with every destination replaced by its index, and records the maps
+void Graph::applyOrder(std::shared_ptr<const std::vector<int>> order)
+{
+    const std::vector<int> &ids = *order;
+    auto indices = std::make_shared<std::vector<int>>(ids.size());
+    for (size_t index = 0; index < ids.size(); ++index)
+    {
+        (*indices)[ids[index]] = static_cast<int>(index);
+    }
+    VertexTable lists;
+    lists.reserve(static_cast<int>(ids.size()));
+    for (size_t index = 0; index < ids.size(); ++index)
+    {
+        const EdgeList &edges = *adjacencyList[ids[index]];
+        auto renamed = makeEdgeList();
+        renamed->reserve(edges.size());
+        for (const Edge &edge : edges)
+        {
+            renamed->push_back(Edge(static_cast<int>(index), (*indices)[edge.destination], edge.weight));
+        }
+        lists.push_back(std::move(renamed));
+    }
+    adjacencyList = std::move(lists);
+    vertexIds = std::move(order);
+    vertexIndices = std::move(indices);
+}
+
+const char *Graph::orderName(VertexOrder order)
+{
+    switch (order)
+    {
+    case VertexOrder::Bfs:
+        return "bfs";
+    case VertexOrder::Rcm:
+        return "rcm";
+    default:
+        return "degree";
+    }
+}
+
+VertexOrder Graph::parseOrder(const std::string &name)
+{
+    for (VertexOrder order : {VertexOrder::Bfs, VertexOrder::Rcm, VertexOrder::Degree})
+    {
+        if (name == orderName(order))
+        {
+            return order;
+        }
+    }
+    throw std::invalid_argument("Unknown order '" + name + "' (expected bfs, rcm or degree)");
+}
+
+// Mean |index(u) - index(v)| over both directions of every edge
+double Graph::averageNeighborDistance() const
+{
+    double total = 0;
+    size_t count = 0;
+    for (int index = 0; index < getVertices(); ++index)
+    {
+        forEachNeighborAt(index, [&total, &count, index](int destination, int)
+                          {
+            total += std::abs(destination - index);
+            ++count; });
+    }
+    return count > 0 ? total / count : 0;
+}
+
+// Rebuilds exactly sized per-vertex lists from a compact form
+void Graph::expand()
+{
+    if (storage() == AdjacencyStorage::Lists)
+    {
+        return;
+    }
+    int vertices = getVertices();
+    VertexTable lists;
+    lists.reserve(vertices);
+    for (int vertex = 0; vertex < vertices; ++vertex)
+    {
+        auto edges = makeEdgeList();
+        edges->reserve(degree(vertex));
+        forEachNeighbor(vertex, [&edges, vertex](int destination, int weight)
+                        { edges->push_back(Edge(vertex, destination, weight)); });
+        lists.push_back(std::move(edges));
+    }
+    compactAdjacency.reset();
+    compressedAdjacency.reset();
+    vertexIds.reset();
+    vertexIndices.reset();
+    adjacencyList = std::move(lists);
+}
+
+namespace
+{
+    // libstdc++ layout: make_shared puts two reference counts and a vtable
+    // pointer in front of the object
+    const size_t CONTROL_BLOCK_BYTES = sizeof(void *) + 2 * sizeof(int);
+    const size_t LIST_HEADER_BYTES = CONTROL_BLOCK_BYTES + sizeof(EdgeList);
+    const size_t CHUNK_BYTES = CONTROL_BLOCK_BYTES + sizeof(VertexTable::Chunk);
+}
+
+// Accounts the bytes of each structure of the graph
+GraphMemory Graph::memoryUsage() const
+{
+    GraphMemory memory;
+    if (vertexIds)
+    {
+        memory.vertexMaps = (vertexIds->capacity() + vertexIndices->capacity()) * sizeof(int);
+    }
+    if (compactAdjacency)
+    {
+        memory.compactOffsets = compactAdjacency->offsets.capacity() * sizeof(size_t);
+        memory.compactNeighbors = compactAdjacency->neighborCount() * sizeof(Neighbor);
+        return memory;
+    }
+    if (compressedAdjacency)
+    {
+        memory.compressedOffsets = (compressedAdjacency->offsets.capacity() + compressedAdjacency->dataOffsets.capacity()) * sizeof(size_t);
+        memory.compressedNeighbors = compressedAdjacency->data.capacity();
+        memory.compressedWeights = compressedAdjacency->weights.capacity();
+        return memory;
+    }
+    memory.vertexTable = adjacencyList.chunkCapacity() * sizeof(std::shared_ptr<VertexTable::Chunk>) +
+                         adjacencyList.chunkCount() * CHUNK_BYTES;
+    memory.listHeaders = adjacencyList.size() * LIST_HEADER_BYTES;
+    for (size_t chunk = 0; chunk < adjacencyList.chunkCount(); ++chunk)
+    {
+        if (adjacencyList.chunkShared(chunk))
+        {
+            memory.sharedLists += CHUNK_BYTES;
+        }
+    }
+    for (int vertex = 0; vertex < adjacencyList.size(); ++vertex)
+    {
+        const std::shared_ptr<EdgeList> &list = adjacencyList[vertex];
+        const EdgeList &edges = *list;
+        memory.edgeArrays += edges.size() * sizeof(Edge);
+        memory.edgeSlack += (edges.capacity() - edges.size()) * sizeof(Edge);
+        // Every list of a shared chunk is shared, whatever its own count
+        if (list.use_count() > 1 || adjacencyList.chunkShared(vertex >> VertexTable::CHUNK_BITS))
+        {
+            memory.sharedLists += LIST_HEADER_BYTES + edges.capacity() * sizeof(Edge);
+        }
+    }
+    return memory;
+}
+
+// Sum of every structure (shared lists are already counted in them)
+size_t GraphMemory::total() const
+{
+    return vertexTable + listHeaders + edgeArrays + edgeSlack + compactOffsets + compactNeighbors +
+           compressedOffsets + compressedNeighbors + compressedWeights + vertexMaps + mstCache;
+}
+
+// Formats the breakdown, e.g. "edge_arrays        2400000 bytes  24.00 per edge"
+std::string GraphMemory::toString(long long edges) const
+{
+    const std::pair<const char *, size_t> rows[] = {
+        {"vertex_table", vertexTable}, {"list_headers", listHeaders},
+        {"edge_arrays", edgeArrays}, {"edge_slack", edgeSlack}, {"compact_offsets", compactOffsets},
+        {"compact_neighbors", compactNeighbors}, {"compressed_offsets", compressedOffsets},
+        {"compressed_neighbors", compressedNeighbors}, {"compressed_weights", compressedWeights},
+        {"vertex_maps", vertexMaps}, {"mst_cache", mstCache}, {"total", total()},
+        {"shared_with_snapshots", sharedLists}};
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    for (const auto &row : rows)
+    {
+        out << std::left << std::setw(22) << row.first << std::right << std::setw(14) << row.second << " bytes";
+        if (edges > 0)
+        {
+            out << std::setw(10) << static_cast<double>(row.second) / edges << " per edge";
+        }
+        out << "\n";
+    }
+    return out.str();
 }
@@ -1,7 +1,11 @@
 #pragma once
-#include <unordered_map>
+#include <array>
 #include <vector>
 #include <string>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include "../utils/slabpool.hpp"
 
 struct Edge
 {
@@ -14,26 +18,320 @@ struct Edge
     }
 };
 
+// Adjacency lists are held through shared pointers so that copying a Graph
+// shares every list with the original; a list is only cloned when a copy
+// mutates it (copy-on-write). Lists and their control blocks come from the
+// slab pool, so per-vertex allocations skip the general-purpose heap.
+using EdgeList = std::vector<Edge, SlabAllocator<Edge>>;
+
+// The edge lists of a graph by vertex ID (IDs are dense, 0..size()-1). The
+// list pointers sit in chunks of CHUNK_SIZE that are shared the same way as
+// the lists: copying a table copies one pointer per chunk, and a slot is only
+// written after its chunk is cloned if another table still holds it. A write
+// to a copied graph therefore costs O(lists touched), not O(V).
+class VertexTable
+{
+public:
+    static const int CHUNK_BITS = 10;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+    using Chunk = std::array<std::shared_ptr<EdgeList>, CHUNK_SIZE>;
+
+    int size() const { return size_; }
+    bool contains(int vertex) const { return vertex >= 0 && vertex < size_; }
+    // the list of an existing vertex
+    const std::shared_ptr<EdgeList> &operator[](int vertex) const
+    {
+        return (*chunks_[vertex >> CHUNK_BITS])[vertex & (CHUNK_SIZE - 1)];
+    }
+    // the writable slot of an existing vertex, cloning its chunk first if it
+    // is shared; throws std::out_of_range for a missing vertex
+    std::shared_ptr<EdgeList> &slot(int vertex);
+    // append the next vertex
+    void push_back(std::shared_ptr<EdgeList> edges);
+    void reserve(int vertices);
+    void clear();
+
+    size_t chunkCount() const { return chunks_.size(); }
+    size_t chunkCapacity() const { return chunks_.capacity(); }
+    bool chunkShared(size_t chunk) const { return chunks_[chunk].use_count() > 1; }
+
+private:
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    int size_ = 0;
+};
+
+// An edge in compact storage; its source is the vertex whose range holds it
+struct Neighbor
+{
+    int destination;
+    int weight;
+};
+
+// Adjacency in compressed sparse row form: the neighbors of vertex v are
+// neighbors[offsets[v]] up to neighbors[offsets[v + 1]], all in one exactly
+// sized array. Immutable once built, so snapshots share it freely.
+struct CompactAdjacency
+{
+    std::vector<size_t> offsets; // one entry per vertex, plus the end
+    std::unique_ptr<Neighbor[]> neighbors;
+
+    int vertices() const { return static_cast<int>(offsets.size()) - 1; }
+    size_t neighborCount() const { return offsets.back(); }
+};
+
+// Adjacency for very large read-mostly graphs. Each vertex's neighbors are
+// sorted by destination and stored as gaps in group varint: a group of four
+// values starts with a tag byte holding their lengths (2 bits each, 1-4 bytes),
+// so one load tells the decoder where all four values end. The first value of
+// a vertex is the zigzag-encoded distance of its first destination from the
+// vertex itself. Weights, in the same order, sit in a separate array as
+// (weight - minWeight) in the narrowest of 1, 2 or 4 bytes that fits them all.
+struct CompressedAdjacency
+{
+    std::vector<size_t> offsets;     // per vertex, plus the end: index of its first neighbor
+    std::vector<size_t> dataOffsets; // per vertex, plus the end: byte offset of its first tag
+    std::vector<uint8_t> data;       // tags and values, plus 3 padding bytes for whole-word loads
+    std::vector<uint8_t> weights;
+    int weightBytes = 1;
+    int minWeight = 0;
+
+    int vertices() const { return static_cast<int>(offsets.size()) - 1; }
+    size_t neighborCount() const { return offsets.back(); }
+    // call fn(destination, weight) for each neighbor, in destination order
+    template <typename Fn>
+    void forEach(int vertex, Fn &&fn) const;
+};
+
+// How a Graph holds its adjacency
+enum class AdjacencyStorage
+{
+    Lists,     // an EdgeList per vertex; the only form that is mutated in place
+    Packed,    // CompactAdjacency, 8 bytes per edge direction
+    Compressed // CompressedAdjacency, a few bytes per edge direction
+};
+
+// Locality-improving vertex orders (see Graph::reorder)
+enum class VertexOrder
+{
+    Bfs,   // breadth-first, each component from its first vertex
+    Rcm,   // reverse Cuthill-McKee: breadth-first from a low-degree vertex,
+           // neighbors by increasing degree, then the whole order reversed
+    Degree // by decreasing degree, so the hubs share cache lines
+};
+
+// Bytes held by a graph, by structure. Allocator internals (shared_ptr
+// control blocks) are estimated from the libstdc++ layouts.
+struct GraphMemory
+{
+    size_t vertexTable = 0;      // VertexTable chunks and the array pointing to them
+    size_t listHeaders = 0;      // per vertex: shared_ptr control block holding the std::vector
+    size_t edgeArrays = 0;       // Edge entries in use; each edge is stored twice
+    size_t edgeSlack = 0;        // reserved but unused Edge capacity
+    size_t compactOffsets = 0;   // packed form: per-vertex offsets
+    size_t compactNeighbors = 0; // packed form: Neighbor entries, each edge twice
+    size_t compressedOffsets = 0;   // compressed form: per-vertex neighbor and byte offsets
+    size_t compressedNeighbors = 0; // compressed form: group varint tags and gaps
+    size_t compressedWeights = 0;   // compressed form: narrow weights
+    size_t vertexMaps = 0;       // reordered form: index <-> vertex ID maps
+    size_t mstCache = 0;         // cached MSTs (filled in by GraphStore)
+    size_t sharedLists = 0;      // part of the table and lists shared with other snapshots (not extra)
+
+    size_t total() const;
+    // one line per structure with bytes and bytes per edge
+    std::string toString(long long edges) const;
+};
+
 class Graph
 {
 public:
     Graph();
     Graph(int numVertices);
+    // a graph in the packed form, with each vertex's neighbors in the given order
+    explicit Graph(std::shared_ptr<const CompactAdjacency> adjacency);
     void addEdge(int source, int destination, int weight);
+    // bulk insert: add the directions of every edge in batches that start at a
+    // vertex in [firstVertex, lastVertex). Only those vertices' lists are
+    // written, so calls over disjoint ranges may run concurrently while the
+    // vertex table is not shared with a copy (as after clear() and addVertex()),
+    // and calls covering all vertices add every edge once. Throws std::out_of_range
+    // (before changing anything) for an edge to a missing vertex, and
+    // std::logic_error unless the graph is in list form (see expand()).
+    void addEdgesInRange(const std::vector<std::vector<Edge>> &batches, int firstVertex, int lastVertex);
     int addVertex();
     bool removeEdge(int source, int destination);
     bool removeVertex(int vertex);
     bool changeWeight(int source, int destination, int newWeight);
+    bool hasVertex(int vertex) const;
     std::vector<Edge> getAdjacentEdges(int vertex) const;
+    // call fn(destination, weight) for each edge of the vertex, without copying
+    // (nothing for a missing vertex); works on every storage form
+    template <typename Fn>
+    void forEachNeighbor(int vertex, Fn &&fn) const;
+    // the same on internal indices: index and the destinations passed to fn
+    // are positions 0..V-1 in storage order, which differ from vertex IDs only
+    // while the graph is reordered. For traversals that keep per-vertex arrays;
+    // results are translated back with vertexAt.
+    template <typename Fn>
+    void forEachNeighborAt(int index, Fn &&fn) const;
+    int indexOf(int vertex) const;
+    int vertexAt(int index) const;
+    size_t degree(int vertex) const;
     int getVertices() const;
     int getEdges() const;
     void printGraph() const;
     std::string toString() const;
     bool isConnected() const;
+    // number of connected components (an isolated vertex is one)
+    int componentCount() const;
     bool isInitialized() const;
     void clear();
+    // re-allocate adjacency lists in parallel from threads pinned to these CPUs (NUMA placement)
+    void redistribute(const std::vector<int> &cpus);
+
+    // repack the adjacency into a read-optimized form (Packed or Compressed,
+    // or back to Lists); the next mutation unpacks it into lists again
+    void compact(AdjacencyStorage storage = AdjacencyStorage::Packed);
+    AdjacencyStorage storage() const;
+    // "lists", "packed" or "compressed"
+    static const char *storageName(AdjacencyStorage storage);
+    // inverse of storageName; throws std::invalid_argument for other names
+    static AdjacencyStorage parseStorage(const std::string &name);
+
+    // renumber the vertices internally in the given order and keep the compact
+    // form (Packed if the graph is still in lists) in that order. Vertex IDs
+    // seen through the rest of the API stay the same; the next mutation goes
+    // back to lists in ID order.
+    void reorder(VertexOrder order);
+    bool isReordered() const;
+    // "bfs", "rcm" or "degree"; parseOrder throws std::invalid_argument for other names
+    static const char *orderName(VertexOrder order);
+    static VertexOrder parseOrder(const std::string &name);
+    // mean distance between the indices of an edge's endpoints: the smaller,
+    // the more of a traversal's neighbor visits land on memory already cached
+    double averageNeighborDistance() const;
+    GraphMemory memoryUsage() const;
+
+    // version of the snapshot this graph was published as (0 if never published)
+    uint64_t getVersion() const;
+    void setVersion(uint64_t version);
 
 private:
-    std::unordered_map<int, std::vector<Edge>> adjacencyList;
-    static int nextVertexId;
+    EdgeList &mutableEdges(int vertex);
+    // back to per-vertex lists before a mutation (no-op unless compact)
+    void expand();
+    const std::vector<size_t> *compactOffsets() const;
+    size_t degreeAt(int index) const;
+    void buildCompact(AdjacencyStorage storage);
+    std::vector<int> computeOrder(VertexOrder order) const;
+    void applyOrder(std::shared_ptr<const std::vector<int>> order);
+    std::shared_ptr<const CompactAdjacency> packAdjacency() const;
+    std::shared_ptr<const CompressedAdjacency> compressAdjacency() const;
+
+    VertexTable adjacencyList;
+    // at most one of these is set, instead of adjacencyList, while the graph is compact
+    std::shared_ptr<const CompactAdjacency> compactAdjacency;
+    std::shared_ptr<const CompressedAdjacency> compressedAdjacency;
+    // set while reordered (compact forms only): the vertex ID at each index, and back
+    std::shared_ptr<const std::vector<int>> vertexIds;
+    std::shared_ptr<const std::vector<int>> vertexIndices;
+    uint64_t version = 0;
 };
+
+template <typename Fn>
+void CompressedAdjacency::forEach(int vertex, Fn &&fn) const
+{
+    static const uint32_t LENGTH_MASK[] = {0xff, 0xffff, 0xffffff, 0xffffffff};
+    size_t count = offsets[vertex + 1] - offsets[vertex];
+    const uint8_t *in = data.data() + dataOffsets[vertex];
+    const uint8_t *weight = weights.data() + offsets[vertex] * weightBytes;
+    int destination = vertex;
+    for (size_t done = 0; done < count; done += 4)
+    {
+        unsigned tag = *in++;
+        size_t group = count - done < 4 ? count - done : 4;
+        for (size_t k = 0; k < group; ++k, tag >>= 2)
+        {
+            // A whole-word load masked to the value's length (values are little-endian)
+            uint32_t value;
+            std::memcpy(&value, in, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            value = __builtin_bswap32(value);
+#endif
+            value &= LENGTH_MASK[tag & 3];
+            in += (tag & 3) + 1;
+            if (done + k == 0)
+            {
+                destination += static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+            }
+            else
+            {
+                destination += static_cast<int>(value);
+            }
+
+            uint32_t stored = weight[0];
+            if (weightBytes == 2)
+            {
+                stored |= static_cast<uint32_t>(weight[1]) << 8;
+            }
+            else if (weightBytes == 4)
+            {
+                std::memcpy(&stored, weight, sizeof(stored));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+                stored = __builtin_bswap32(stored);
+#endif
+            }
+            weight += weightBytes;
+            fn(destination, static_cast<int>(static_cast<uint32_t>(minWeight) + stored));
+        }
+    }
+}
+
+template <typename Fn>
+void Graph::forEachNeighbor(int vertex, Fn &&fn) const
+{
+    if (!vertexIds)
+    {
+        forEachNeighborAt(vertex, fn);
+        return;
+    }
+    if (vertex < 0 || vertex >= static_cast<int>(vertexIds->size()))
+    {
+        return;
+    }
+    const std::vector<int> &ids = *vertexIds;
+    forEachNeighborAt((*vertexIndices)[vertex], [&ids, &fn](int destination, int weight)
+                      { fn(ids[destination], weight); });
+}
+
+template <typename Fn>
+void Graph::forEachNeighborAt(int index, Fn &&fn) const
+{
+    if (compressedAdjacency)
+    {
+        if (index >= 0 && index < compressedAdjacency->vertices())
+        {
+            compressedAdjacency->forEach(index, fn);
+        }
+        return;
+    }
+    if (compactAdjacency)
+    {
+        if (index < 0 || index >= compactAdjacency->vertices())
+        {
+            return;
+        }
+        const Neighbor *neighbors = compactAdjacency->neighbors.get();
+        for (size_t i = compactAdjacency->offsets[index]; i < compactAdjacency->offsets[index + 1]; ++i)
+        {
+            fn(neighbors[i].destination, neighbors[i].weight);
+        }
+        return;
+    }
+    if (adjacencyList.contains(index))
+    {
+        for (const Edge &edge : *adjacencyList[index])
+        {
+            fn(edge.destination, edge.weight);
+        }
+    }
+}
@@ -0,0 +1,371 @@
+#include "GraphGenerators.hpp"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+// This file implements the synthetic graph generators.
+
+namespace
+{
+    // Small, fast generator whose output is the same on every platform
+    // (unlike the std:: distributions), so a seed always means the same graph
+    class SplitMix64
+    {
+    public:
+        explicit SplitMix64(uint64_t seed) : state_(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+        // uniform in [0, bound)
+        uint64_t below(uint64_t bound) { return next() % bound; }
+        // uniform in [0, 1)
+        double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+    private:
+        uint64_t state_;
+    };
+
+    // Draw an edge weight according to the spec's distribution
+    int drawWeight(const GeneratorSpec &spec, SplitMix64 &rng)
+    {
+        if (spec.weights == "constant")
+        {
+            return spec.minWeight;
+        }
+        long long range = static_cast<long long>(spec.maxWeight) - spec.minWeight + 1;
+        if (spec.weights == "exponential")
+        {
+            // mean a quarter of the range, clipped to the maximum
+            double value = -std::log(1.0 - rng.unit()) * range / 4.0;
+            return spec.minWeight + static_cast<int>(std::min<double>(value, range - 1));
+        }
+        return spec.minWeight + static_cast<int>(rng.below(range));
+    }
+
+    // Parse a whole string as a number, naming the key on failure
+    long long toNumber(const std::string &key, const std::string &value)
+    {
+        size_t used = 0;
+        long long number = 0;
+        try
+        {
+            // accept 1e6-style sizes as well as plain integers
+            number = value.find_first_of("eE.") == std::string::npos ? std::stoll(value, &used)
+                                                                      : static_cast<long long>(std::stod(value, &used));
+        }
+        catch (const std::logic_error &)
+        {
+        }
+        if (used == 0 || used != value.size())
+        {
+            throw std::invalid_argument("Bad value for " + key + ": '" + value + "'");
+        }
+        return number;
+    }
+}
+
+void GeneratorSpec::set(const std::string &key, const std::string &value)
+{
+    if (key == "kind")
+    {
+        kind = value;
+    }
+    else if (key == "vertices")
+    {
+        long long number = toNumber(key, value);
+        if (number > 0x7fffffff)
+        {
+            throw std::invalid_argument("Too many vertices: " + value);
+        }
+        vertices = static_cast<int>(number);
+    }
+    else if (key == "edges")
+    {
+        edges = toNumber(key, value);
+    }
+    else if (key == "seed")
+    {
+        seed = static_cast<uint64_t>(toNumber(key, value));
+    }
+    else if (key == "weights")
+    {
+        weights = value;
+    }
+    else if (key == "min_weight")
+    {
+        minWeight = static_cast<int>(toNumber(key, value));
+    }
+    else if (key == "max_weight")
+    {
+        maxWeight = static_cast<int>(toNumber(key, value));
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown generator option: " + key);
+    }
+}
+
+GeneratorSpec GeneratorSpec::parse(const std::string &text)
+{
+    GeneratorSpec spec;
+    std::istringstream words(text);
+    std::string word;
+    while (words >> word)
+    {
+        size_t equals = word.find('=');
+        if (equals == std::string::npos)
+        {
+            throw std::invalid_argument("Expected key=value, got '" + word + "'");
+        }
+        spec.set(word.substr(0, equals), word.substr(equals + 1));
+    }
+    return spec;
+}
+
+std::string GeneratorSpec::toString() const
+{
+    std::ostringstream oss;
+    oss << "kind=" << kind << " vertices=" << vertices << " edges=" << edges << " seed=" << seed
+        << " weights=" << weights << " min_weight=" << minWeight << " max_weight=" << maxWeight;
+    return oss.str();
+}
+
+const long long GraphGenerator::CHUNK_EDGES;
+
+GraphGenerator::GraphGenerator(const GeneratorSpec &spec)
+    : spec_(spec), chunks_(0), stride_(1), cellsPerSide_(1), radius_(0)
+{
+    if (spec.vertices < 2)
+    {
+        throw std::invalid_argument("A generated graph needs at least 2 vertices");
+    }
+    if (spec.minWeight > spec.maxWeight)
+    {
+        throw std::invalid_argument("Minimum weight is above the maximum");
+    }
+    if (spec.weights != "uniform" && spec.weights != "exponential" && spec.weights != "constant")
+    {
+        throw std::invalid_argument("Unknown weight distribution: " + spec.weights);
+    }
+    long long vertices = spec.vertices;
+
+    if (spec.kind == "erdos_renyi" || spec.kind == "rmat")
+    {
+        if (spec.edges < 0)
+        {
+            throw std::invalid_argument("Negative edge count");
+        }
+        chunks_ = (spec.edges + CHUNK_EDGES - 1) / CHUNK_EDGES;
+    }
+    else if (spec.kind == "grid")
+    {
+        stride_ = static_cast<long long>(std::ceil(std::sqrt(static_cast<double>(vertices))));
+        chunks_ = (vertices + CHUNK_EDGES / 2 - 1) / (CHUNK_EDGES / 2);
+    }
+    else if (spec.kind == "complete")
+    {
+        if (vertices * (vertices - 1) / 2 > (1LL << 31) - 1)
+        {
+            throw std::invalid_argument("Complete graph too large");
+        }
+        stride_ = std::max(1LL, CHUNK_EDGES / vertices);
+        chunks_ = (vertices + stride_ - 1) / stride_;
+    }
+    else if (spec.kind == "geometric")
+    {
+        // Expected edges: pairs * pi * r^2 (ignoring the border)
+        double pairs = vertices * (vertices - 1) / 2.0;
+        radius_ = std::sqrt(std::max<double>(spec.edges, 0) / (pairs * M_PI));
+        cellsPerSide_ = static_cast<int>(std::max(1.0, std::min(1.0 / std::max(radius_, 1e-9), std::sqrt(static_cast<double>(vertices)))));
+
+        // Points and a cell index (counting sort by cell) for neighbour search
+        xs_.resize(vertices);
+        ys_.resize(vertices);
+        std::vector<int> cellOf(vertices);
+        cellStart_.assign(static_cast<size_t>(cellsPerSide_) * cellsPerSide_ + 1, 0);
+        for (long long v = 0; v < vertices; ++v)
+        {
+            SplitMix64 rng(spec.seed * 0x100000001B3ULL + v);
+            xs_[v] = static_cast<float>(rng.unit());
+            ys_[v] = static_cast<float>(rng.unit());
+            int cx = std::min(cellsPerSide_ - 1, static_cast<int>(xs_[v] * cellsPerSide_));
+            int cy = std::min(cellsPerSide_ - 1, static_cast<int>(ys_[v] * cellsPerSide_));
+            cellOf[v] = cy * cellsPerSide_ + cx;
+            ++cellStart_[cellOf[v] + 1];
+        }
+        for (size_t c = 1; c < cellStart_.size(); ++c)
+        {
+            cellStart_[c] += cellStart_[c - 1];
+        }
+        cellVertices_.resize(vertices);
+        std::vector<int> fill(cellStart_.begin(), cellStart_.end() - 1);
+        for (long long v = 0; v < vertices; ++v)
+        {
+            cellVertices_[fill[cellOf[v]]++] = static_cast<int>(v);
+        }
+
+        double degree = std::max(1.0, 2.0 * spec.edges / vertices);
+        stride_ = std::max(1LL, static_cast<long long>(CHUNK_EDGES / degree));
+        chunks_ = (vertices + stride_ - 1) / stride_;
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown graph kind: " + spec.kind);
+    }
+}
+
+// Independent seed of each chunk
+uint64_t GraphGenerator::chunkSeed(size_t chunk) const
+{
+    SplitMix64 mix(spec_.seed ^ (static_cast<uint64_t>(chunk) * 0xD1B54A32D192ED03ULL));
+    return mix.next();
+}
+
+void GraphGenerator::generateChunk(size_t chunk, std::vector<Edge> &out) const
+{
+    if (chunk >= chunks_)
+    {
+        return;
+    }
+    if (spec_.kind == "erdos_renyi" || spec_.kind == "rmat")
+    {
+        generateRandom(chunk, out, spec_.kind == "rmat");
+    }
+    else if (spec_.kind == "grid")
+    {
+        generateGrid(chunk, out);
+    }
+    else if (spec_.kind == "complete")
+    {
+        generateComplete(chunk, out);
+    }
+    else
+    {
+        generateGeometric(chunk, out);
+    }
+}
+
+std::vector<Edge> GraphGenerator::generateAll() const
+{
+    std::vector<Edge> edges;
+    for (size_t chunk = 0; chunk < chunks_; ++chunk)
+    {
+        generateChunk(chunk, edges);
+    }
+    return edges;
+}
+
+// Uniform endpoint pairs, or R-MAT's recursive quadrant choice; no self-loops
+void GraphGenerator::generateRandom(size_t chunk, std::vector<Edge> &out, bool rmat) const
+{
+    SplitMix64 rng(chunkSeed(chunk));
+    long long first = static_cast<long long>(chunk) * CHUNK_EDGES;
+    long long count = std::min(CHUNK_EDGES, spec_.edges - first);
+    int scale = 1;
+    while ((1LL << scale) < spec_.vertices)
+    {
+        ++scale;
+    }
+    for (long long i = 0; i < count; ++i)
+    {
+        long long source, destination;
+        do
+        {
+            if (rmat)
+            {
+                source = 0;
+                destination = 0;
+                for (int level = 0; level < scale; ++level)
+                {
+                    double r = rng.unit();
+                    int row = r >= 0.57 + 0.19 ? 1 : 0;              // quadrants c and d
+                    int column = (r >= 0.57 && r < 0.76) || r >= 0.95; // quadrants b and d
+                    source = (source << 1) | row;
+                    destination = (destination << 1) | column;
+                }
+                // fold IDs beyond V back so that no draw is wasted
+                source %= spec_.vertices;
+                destination %= spec_.vertices;
+            }
+            else
+            {
+                source = rng.below(spec_.vertices);
+                destination = rng.below(spec_.vertices);
+            }
+        } while (source == destination);
+        out.emplace_back(static_cast<int>(source), static_cast<int>(destination), drawWeight(spec_, rng));
+    }
+}
+
+// Right and down neighbours of a range of vertices
+void GraphGenerator::generateGrid(size_t chunk, std::vector<Edge> &out) const
+{
+    SplitMix64 rng(chunkSeed(chunk));
+    long long first = static_cast<long long>(chunk) * (CHUNK_EDGES / 2);
+    long long last = std::min<long long>(spec_.vertices, first + CHUNK_EDGES / 2);
+    long long columns = stride_;
+    for (long long v = first; v < last; ++v)
+    {
+        if ((v + 1) % columns != 0 && v + 1 < spec_.vertices)
+        {
+            out.emplace_back(static_cast<int>(v), static_cast<int>(v + 1), drawWeight(spec_, rng));
+        }
+        if (v + columns < spec_.vertices)
+        {
+            out.emplace_back(static_cast<int>(v), static_cast<int>(v + columns), drawWeight(spec_, rng));
+        }
+    }
+}
+
+// Every pair (u, v > u) for a range of u
+void GraphGenerator::generateComplete(size_t chunk, std::vector<Edge> &out) const
+{
+    SplitMix64 rng(chunkSeed(chunk));
+    long long first = static_cast<long long>(chunk) * stride_;
+    long long last = std::min<long long>(spec_.vertices, first + stride_);
+    for (long long u = first; u < last; ++u)
+    {
+        for (long long v = u + 1; v < spec_.vertices; ++v)
+        {
+            out.emplace_back(static_cast<int>(u), static_cast<int>(v), drawWeight(spec_, rng));
+        }
+    }
+}
+
+// Pairs closer than the radius, found through the neighbouring cells of each vertex
+void GraphGenerator::generateGeometric(size_t chunk, std::vector<Edge> &out) const
+{
+    SplitMix64 rng(chunkSeed(chunk));
+    long long first = static_cast<long long>(chunk) * stride_;
+    long long last = std::min<long long>(spec_.vertices, first + stride_);
+    double radiusSquared = radius_ * radius_;
+    for (long long u = first; u < last; ++u)
+    {
+        int cx = std::min(cellsPerSide_ - 1, static_cast<int>(xs_[u] * cellsPerSide_));
+        int cy = std::min(cellsPerSide_ - 1, static_cast<int>(ys_[u] * cellsPerSide_));
+        for (int y = std::max(0, cy - 1); y <= std::min(cellsPerSide_ - 1, cy + 1); ++y)
+        {
+            for (int x = std::max(0, cx - 1); x <= std::min(cellsPerSide_ - 1, cx + 1); ++x)
+            {
+                int cell = y * cellsPerSide_ + x;
+                for (int i = cellStart_[cell]; i < cellStart_[cell + 1]; ++i)
+                {
+                    int v = cellVertices_[i];
+                    double dx = xs_[u] - xs_[v];
+                    double dy = ys_[u] - ys_[v];
+                    if (v > u && dx * dx + dy * dy < radiusSquared)
+                    {
+                        out.emplace_back(static_cast<int>(u), v, drawWeight(spec_, rng));
+                    }
+                }
+            }
+        }
+    }
+}
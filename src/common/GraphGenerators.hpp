@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Graph.hpp"
+
+// Parameters of a synthetic graph
+struct GeneratorSpec
+{
+    // erdos_renyi, grid, rmat, complete or geometric
+    std::string kind = "erdos_renyi";
+    int vertices = 1000;
+    // target edge count; grid and complete graphs derive it from vertices
+    long long edges = 5000;
+    uint64_t seed = 1;
+    // uniform, exponential or constant (always minWeight)
+    std::string weights = "uniform";
+    int minWeight = 1;
+    int maxWeight = 1000;
+
+    // set one field by key (kind, vertices, edges, seed, weights, min_weight,
+    // max_weight); throws std::invalid_argument for unknown keys or bad numbers
+    void set(const std::string &key, const std::string &value);
+    // parse whitespace-separated key=value pairs, e.g. "kind=rmat vertices=1000 edges=16000"
+    static GeneratorSpec parse(const std::string &text);
+    // every field in the form parse() reads back
+    std::string toString() const;
+};
+
+// Generates the edges of a synthetic graph in independent chunks.
+// A chunk's edges depend only on the spec and the chunk index, so chunks can
+// be produced by any number of threads in any order and the same seed always
+// yields the same graph.
+//
+//   erdos_renyi  G(n, m): m endpoint pairs drawn uniformly (with replacement)
+//   grid         a 2D lattice of about `vertices` vertices, 4-neighbour edges
+//   rmat         R-MAT power-law graph (a=0.57, b=0.19, c=0.19)
+//   complete     every pair of vertices
+//   geometric    vertices at random points of the unit square, joined when
+//                closer than the radius that gives about `edges` edges
+class GraphGenerator
+{
+public:
+    // edges per chunk (except possibly the last one)
+    static const long long CHUNK_EDGES = 1 << 16;
+
+    // throws std::invalid_argument for unknown kinds or impossible sizes
+    explicit GraphGenerator(const GeneratorSpec &spec);
+
+    int vertices() const { return spec_.vertices; }
+    size_t chunks() const { return chunks_; }
+    // append the edges of one chunk to out; safe to call concurrently
+    void generateChunk(size_t chunk, std::vector<Edge> &out) const;
+    // all edges, chunk after chunk
+    std::vector<Edge> generateAll() const;
+
+private:
+    uint64_t chunkSeed(size_t chunk) const;
+    void generateRandom(size_t chunk, std::vector<Edge> &out, bool rmat) const;
+    void generateGrid(size_t chunk, std::vector<Edge> &out) const;
+    void generateComplete(size_t chunk, std::vector<Edge> &out) const;
+    void generateGeometric(size_t chunk, std::vector<Edge> &out) const;
+
+    GeneratorSpec spec_;
+    size_t chunks_;
+    // grid: columns per row; complete and geometric: vertices per chunk
+    long long stride_;
+    // geometric: point coordinates, a cell grid over them and the join radius
+    std::vector<float> xs_, ys_;
+    std::vector<int> cellStart_, cellVertices_;
+    int cellsPerSide_;
+    double radius_;
+};
@@ -0,0 +1,78 @@
+#include "GraphMutation.hpp"
+#include <stdexcept>
+
+// This file implements applying GraphMutation values to a Graph.
+
+int GraphMutation::applyTo(Graph &graph) const
+{
+    switch (type)
+    {
+    case Type::Clear:
+        graph.clear();
+        return 1;
+    case Type::AddVertex:
+        return graph.addVertex();
+    case Type::AddEdge:
+        graph.addEdge(a, b, c);
+        return 1;
+    case Type::RemoveVertex:
+        return graph.removeVertex(a) ? 1 : 0;
+    case Type::RemoveEdge:
+        return graph.removeEdge(a, b) ? 1 : 0;
+    case Type::ChangeWeight:
+        return graph.changeWeight(a, b, c) ? 1 : 0;
+    }
+    return 0;
+}
+
+void GraphMutation::checkGroup(const std::vector<GraphMutation> &group, int vertices)
+{
+    for (size_t i = 0; i < group.size(); ++i)
+    {
+        const GraphMutation &mutation = group[i];
+        switch (mutation.type)
+        {
+        case Type::Clear:
+            vertices = 0;
+            break;
+        case Type::AddVertex:
+            ++vertices;
+            break;
+        case Type::RemoveVertex:
+            if (mutation.a >= 0 && mutation.a < vertices)
+            {
+                --vertices;
+            }
+            break;
+        case Type::AddEdge:
+            if (mutation.a < 0 || mutation.a >= vertices || mutation.b < 0 || mutation.b >= vertices)
+            {
+                throw std::out_of_range("Edge " + std::to_string(mutation.a) + " - " + std::to_string(mutation.b) +
+                                        " refers to a missing vertex");
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+std::string GraphMutation::toString() const
+{
+    switch (type)
+    {
+    case Type::Clear:
+        return "clear";
+    case Type::AddVertex:
+        return "add_vertex";
+    case Type::AddEdge:
+        return "add_edge " + std::to_string(a) + " " + std::to_string(b) + " " + std::to_string(c);
+    case Type::RemoveVertex:
+        return "remove_vertex " + std::to_string(a);
+    case Type::RemoveEdge:
+        return "remove_edge " + std::to_string(a) + " " + std::to_string(b);
+    case Type::ChangeWeight:
+        return "change_weight " + std::to_string(a) + " " + std::to_string(b) + " " + std::to_string(c);
+    }
+    return "unknown";
+}
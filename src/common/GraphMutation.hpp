@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Graph.hpp"
+
+// A single graph mutation as a value, so that every front end (interactive
+// text, binary frames, batches) applies changes through the same code path.
+struct GraphMutation
+{
+    enum class Type : uint8_t
+    {
+        Clear = 1,
+        AddVertex = 2,
+        AddEdge = 3,
+        RemoveVertex = 4,
+        RemoveEdge = 5,
+        ChangeWeight = 6
+    };
+
+    Type type;
+    int a, b, c;
+
+    static GraphMutation clear() { return {Type::Clear, 0, 0, 0}; }
+    static GraphMutation addVertex() { return {Type::AddVertex, 0, 0, 0}; }
+    static GraphMutation addEdge(int source, int destination, int weight) { return {Type::AddEdge, source, destination, weight}; }
+    static GraphMutation removeVertex(int vertex) { return {Type::RemoveVertex, vertex, 0, 0}; }
+    static GraphMutation removeEdge(int source, int destination) { return {Type::RemoveEdge, source, destination, 0}; }
+    static GraphMutation changeWeight(int source, int destination, int weight) { return {Type::ChangeWeight, source, destination, weight}; }
+
+    // Apply to a graph. Returns the new vertex ID for AddVertex, 1/0 for
+    // whether a remove or weight change found its target, and 1 otherwise.
+    // Throws std::out_of_range for edges between missing vertices.
+    int applyTo(Graph &graph) const;
+    // Whether applying it with the given result modified the graph
+    bool changed(int result) const { return type == Type::Clear || type == Type::AddVertex || type == Type::AddEdge || result != 0; }
+
+    std::string toString() const;
+
+    // Throws std::out_of_range if applying the mutations in order to a graph
+    // with this many vertices would add an edge to a missing vertex, so that a
+    // group of edits can be rejected as a whole before any of it is applied.
+    static void checkGroup(const std::vector<GraphMutation> &group, int vertices);
+};
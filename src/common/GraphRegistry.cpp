@@ -0,0 +1,122 @@
+#include "GraphRegistry.hpp"
+#include "MutationLog.hpp"
+#include <algorithm>
+#include <functional>
+
+// This file implements GraphRegistry, the sharded name -> graph map used for multi-tenant graphs.
+
+const std::string GraphRegistry::DEFAULT_GRAPH = "default";
+
+// The default graph always exists so a new session has something selected
+GraphRegistry::GraphRegistry()
+{
+    create(DEFAULT_GRAPH);
+}
+
+GraphRegistry::Shard &GraphRegistry::shardFor(const std::string &name) const
+{
+    return shards_[std::hash<std::string>()(name) % SHARD_COUNT];
+}
+
+// Creates and drops are appended to the log under the shard lock, so the log
+// has them in the same order as the map, and waited for after releasing it.
+// The new store starts at the CreateGraph record's LSN: records of a dropped
+// graph of the same name are older and never replayed into it.
+std::shared_ptr<GraphStore> GraphRegistry::create(const std::string &name, uint64_t lsn)
+{
+    Shard &shard = shardFor(name);
+    MutationLog *log = log_.load();
+    std::shared_ptr<GraphStore> store;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.graphs.count(name))
+        {
+            return nullptr;
+        }
+        if (log)
+        {
+            LogRecord record;
+            record.kind = LogRecord::Kind::CreateGraph;
+            record.graph = name;
+            lsn = log->append(record);
+        }
+        store = std::make_shared<GraphStore>(name, lsn);
+        if (log)
+        {
+            store->attachLog(log);
+        }
+        shard.graphs[name] = store;
+    }
+    if (log)
+    {
+        log->waitDurable(lsn);
+    }
+    return store;
+}
+
+std::shared_ptr<GraphStore> GraphRegistry::find(const std::string &name) const
+{
+    Shard &shard = shardFor(name);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.graphs.find(name);
+    return it != shard.graphs.end() ? it->second : nullptr;
+}
+
+// The default graph cannot be dropped
+bool GraphRegistry::drop(const std::string &name)
+{
+    if (name == DEFAULT_GRAPH)
+    {
+        return false;
+    }
+    Shard &shard = shardFor(name);
+    MutationLog *log = log_.load();
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.graphs.erase(name) == 0)
+        {
+            return false;
+        }
+        if (log)
+        {
+            LogRecord record;
+            record.kind = LogRecord::Kind::DropGraph;
+            record.graph = name;
+            lsn = log->append(record);
+        }
+    }
+    if (log)
+    {
+        log->waitDurable(lsn);
+    }
+    return true;
+}
+
+std::vector<std::string> GraphRegistry::list() const
+{
+    std::vector<std::string> names;
+    for (const Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto &pair : shard.graphs)
+        {
+            names.push_back(pair.first);
+        }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+void GraphRegistry::attachLog(MutationLog *log)
+{
+    for (Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto &pair : shard.graphs)
+        {
+            pair.second->attachLog(log);
+        }
+    }
+    log_.store(log);
+}
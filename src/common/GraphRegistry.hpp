@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "GraphStore.hpp"
+
+// GraphRegistry maps graph names to their GraphStore.
+// Names are spread over independently locked shards; a shard lock is held only
+// for the map lookup, never while a graph is read or written, so work on
+// different graphs does not contend.
+class GraphRegistry
+{
+public:
+    static const std::string DEFAULT_GRAPH;
+
+    GraphRegistry();
+
+    // create a new empty graph, returns nullptr if the name is taken; without
+    // a log, lsn is the position of the CreateGraph record being replayed
+    std::shared_ptr<GraphStore> create(const std::string &name, uint64_t lsn = 0);
+    // find a graph by name, returns nullptr if it does not exist
+    std::shared_ptr<GraphStore> find(const std::string &name) const;
+    // remove a graph; sessions that still have it selected keep their reference
+    bool drop(const std::string &name);
+    // get the names of all graphs, sorted
+    std::vector<std::string> list() const;
+    // log creates, drops and every graph's commits to this log from now on
+    void attachLog(MutationLog *log);
+
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<GraphStore>> graphs;
+    };
+
+    Shard &shardFor(const std::string &name) const;
+
+    mutable Shard shards_[SHARD_COUNT];
+    std::atomic<MutationLog *> log_{nullptr};
+};
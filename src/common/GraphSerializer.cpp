@@ -0,0 +1,126 @@
+#include "GraphSerializer.hpp"
+#include <cstdio>
+
+// This file implements chunked serialization of graphs and MST results.
+
+namespace
+{
+    // Right-align a number in a table cell of the given width
+    void appendPadded(std::string &out, long long value, int width)
+    {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%*lld", width, value);
+        out.append(buffer, length);
+    }
+}
+
+std::string ChunkSource::drain()
+{
+    std::string out;
+    while (next(out, 64 * 1024))
+    {
+    }
+    return out;
+}
+
+GraphSerializer::GraphSerializer(std::shared_ptr<const Graph> graph, DumpFormat format)
+    : graph_(std::move(graph)), format_(format), vertex_(-1) {}
+
+// Write the header, then whole vertices until the chunk is full
+bool GraphSerializer::next(std::string &out, size_t maxBytes)
+{
+    size_t limit = out.size() + maxBytes;
+    if (vertex_ < 0)
+    {
+        if (format_ == DumpFormat::Compact)
+        {
+            out += std::to_string(graph_->getVertices()) + " " + std::to_string(graph_->getEdges()) + "\n";
+        }
+        else
+        {
+            out += "Graph has " + std::to_string(graph_->getVertices()) + " vertices.\n";
+        }
+        vertex_ = 0;
+    }
+    int vertices = graph_->getVertices();
+    while (vertex_ < vertices && out.size() < limit)
+    {
+        appendVertex(out, vertex_++);
+    }
+    return vertex_ < vertices;
+}
+
+// Append one vertex's lines; in the compact format each undirected edge is
+// written once, by its lower-numbered endpoint
+void GraphSerializer::appendVertex(std::string &out, int vertex) const
+{
+    if (format_ == DumpFormat::Compact)
+    {
+        bool loopOpen = false; // a self-loop is stored twice in its own list, write it once
+        graph_->forEachNeighbor(vertex, [&out, &loopOpen, vertex](int destination, int weight)
+                                {
+            if (destination < vertex)
+            {
+                return;
+            }
+            if (destination == vertex)
+            {
+                loopOpen = !loopOpen;
+                if (!loopOpen)
+                {
+                    return;
+                }
+            }
+            out += std::to_string(vertex);
+            out += ' ';
+            out += std::to_string(destination);
+            out += ' ';
+            out += std::to_string(weight);
+            out += '\n'; });
+        return;
+    }
+
+    out += "Vertex " + std::to_string(vertex) + ":\n";
+    if (graph_->degree(vertex) == 0)
+    {
+        out += "  (no edges)\n";
+    }
+    graph_->forEachNeighbor(vertex, [&out](int destination, int weight)
+                            { out += "  -> " + std::to_string(destination) + " (weight: " + std::to_string(weight) + ")\n"; });
+}
+
+MSTSerializer::MSTSerializer(std::string algorithm, std::shared_ptr<const std::vector<Edge>> edges)
+    : algorithm_(std::move(algorithm)), edges_(std::move(edges)), index_(0), started_(false), totalWeight_(0) {}
+
+// Write the table header, rows until the chunk is full, then the footer
+bool MSTSerializer::next(std::string &out, size_t maxBytes)
+{
+    size_t limit = out.size() + maxBytes;
+    if (!started_)
+    {
+        out += "\nMinimum Spanning Tree (" + algorithm_ + " algorithm):\n\n";
+        out += "+--------+--------+--------+\n";
+        out += "| Source | Dest   | Weight |\n";
+        out += "+--------+--------+--------+\n";
+        started_ = true;
+    }
+    while (index_ < edges_->size() && out.size() < limit)
+    {
+        const Edge &edge = (*edges_)[index_++];
+        out += "| ";
+        appendPadded(out, edge.source, 6);
+        out += " | ";
+        appendPadded(out, edge.destination, 6);
+        out += " | ";
+        appendPadded(out, edge.weight, 6);
+        out += " |\n";
+        totalWeight_ += edge.weight;
+    }
+    if (index_ < edges_->size())
+    {
+        return true;
+    }
+    out += "+--------+--------+--------+\n";
+    out += "\nTotal MST Weight: " + std::to_string(totalWeight_) + "\n";
+    return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "Graph.hpp"
+
+// Output formats for graph dumps
+enum class DumpFormat
+{
+    // human-readable adjacency listing (print_graph)
+    Text,
+    // machine-readable: a "V E" line, then one "source destination weight"
+    // line per edge; each line is a valid batch-mode add_edge argument list
+    Compact
+};
+
+// Produces a large response piece by piece, so the caller can send each piece
+// before the next is formatted and memory stays bounded by the chunk size.
+class ChunkSource
+{
+public:
+    virtual ~ChunkSource() = default;
+    // append roughly up to maxBytes of output to out; returns false once everything was produced
+    virtual bool next(std::string &out, size_t maxBytes) = 0;
+
+    // produce everything into one string (for small outputs)
+    std::string drain();
+};
+
+// Serializes a graph snapshot. The snapshot is immutable, so a dump is
+// consistent without holding any lock while it is written out.
+class GraphSerializer : public ChunkSource
+{
+public:
+    GraphSerializer(std::shared_ptr<const Graph> graph, DumpFormat format);
+    bool next(std::string &out, size_t maxBytes) override;
+
+private:
+    void appendVertex(std::string &out, int vertex) const;
+
+    std::shared_ptr<const Graph> graph_;
+    DumpFormat format_;
+    int vertex_;  // next vertex to write, -1 before the header
+};
+
+// Serializes an MST as the edge table and total weight sent by compute_mst
+class MSTSerializer : public ChunkSource
+{
+public:
+    MSTSerializer(std::string algorithm, std::shared_ptr<const std::vector<Edge>> edges);
+    bool next(std::string &out, size_t maxBytes) override;
+
+private:
+    std::string algorithm_;
+    std::shared_ptr<const std::vector<Edge>> edges_;
+    size_t index_;  // next edge to write
+    bool started_;
+    long long totalWeight_;
+};
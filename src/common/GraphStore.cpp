@@ -0,0 +1,224 @@
+#include "GraphStore.hpp"
+#include "MSTFactory.hpp"
+#include "MutationLog.hpp"
+#include "../utils/metrics.hpp"
+#include "../utils/tracing.hpp"
+#include <algorithm>
+
+// This file implements GraphStore, the copy-on-write snapshot holder for the shared graph.
+
+GraphStore::GraphStore(const std::string &name, uint64_t lsn)
+    : current_(std::make_shared<const Graph>()), version_(0), writerMutex_("graph writer"), name_(name),
+      mstCacheMutex_("mst cache"), log_(nullptr), lastLsn_(lsn) {}
+
+const std::string &GraphStore::name() const
+{
+    return name_;
+}
+
+// Returns the current snapshot; only an atomic pointer copy, never waits for writers
+std::shared_ptr<const Graph> GraphStore::snapshot() const
+{
+    return std::atomic_load(&current_);
+}
+
+uint64_t GraphStore::version() const
+{
+    return version_.load();
+}
+
+// Stamp the draft with the next version and swap it in
+void GraphStore::publish(std::shared_ptr<Graph> next)
+{
+    uint64_t nextVersion = version_.load() + 1;
+    next->setVersion(nextVersion);
+    std::atomic_store(&current_, std::shared_ptr<const Graph>(std::move(next)));
+    version_.store(nextVersion);
+}
+
+// Returns the cached MST for the snapshot's version, computing it on a miss.
+// The computation runs outside the cache lock, so concurrent misses may both
+// compute; the result for the newer version wins.
+std::shared_ptr<const std::vector<Edge>> GraphStore::findMST(const std::shared_ptr<const Graph> &graph, const std::string &algorithm)
+{
+    std::string key = algorithm;
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+    Metrics &metrics = Metrics::global();
+    static const size_t hits = metrics.counter("mst_cache_hits_total", "", "MST requests answered from the cache");
+    {
+        ProfiledLock<ProfiledMutex> lock(mstCacheMutex_, LOCK_SITE());
+        auto it = mstCache_.find(key);
+        if (it != mstCache_.end() && it->second.version == graph->getVersion())
+        {
+            metrics.add(hits);
+            return it->second.edges;
+        }
+    }
+
+    auto mst = MSTFactory::createMST(algorithm);
+    std::shared_ptr<const std::vector<Edge>> edges;
+    {
+        Metrics::Timer timer(metrics.histogram("mst_algorithm_duration_us", "algorithm=\"" + key + "\"", "Time to compute an MST, in microseconds"));
+        edges = std::make_shared<const std::vector<Edge>>(mst->findMST(*graph));
+    }
+
+    ProfiledLock<ProfiledMutex> lock(mstCacheMutex_, LOCK_SITE());
+    auto &entry = mstCache_[key];
+    if (!entry.edges || entry.version <= graph->getVersion())
+    {
+        entry.version = graph->getVersion();
+        entry.edges = edges;
+    }
+    return edges;
+}
+
+// Writer implementation
+GraphStore::Writer::Writer(GraphStore &store)
+    : store_(store), lock_(store.writerMutex_, LOCK_SITE(), std::defer_lock), committed_(false)
+{
+    auto start = std::chrono::steady_clock::now();
+    TraceSpan span("lock_wait", store_.name().c_str());
+    lock_.lock();
+    span.end();
+    waited_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    // Shallow copy: adjacency lists stay shared until they are modified
+    draft_ = std::make_shared<Graph>(*store_.snapshot());
+}
+
+GraphStore::Writer::Writer(GraphStore &store, std::chrono::milliseconds deadline)
+    : store_(store), lock_(store.writerMutex_, LOCK_SITE(), std::defer_lock), committed_(false)
+{
+    auto start = std::chrono::steady_clock::now();
+    TraceSpan span("lock_wait", store_.name().c_str());
+    if (!lock_.tryLockFor(deadline))
+    {
+        throw GraphBusyError(store_.name());
+    }
+    span.end();
+    waited_ = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    draft_ = std::make_shared<Graph>(*store_.snapshot());
+}
+
+std::chrono::microseconds GraphStore::Writer::waited() const
+{
+    return waited_;
+}
+
+GraphStore::Writer::~Writer() = default;
+
+Graph &GraphStore::Writer::graph()
+{
+    return *draft_;
+}
+
+// Only mutations that changed the draft are logged. A clear makes everything
+// before it irrelevant, and consecutive AddVertex entries become one run.
+int GraphStore::Writer::apply(const GraphMutation &mutation)
+{
+    int result = mutation.applyTo(*draft_);
+    if (store_.log_ && mutation.changed(result))
+    {
+        if (mutation.type == GraphMutation::Type::Clear)
+        {
+            logged_.clear();
+            generated_.clear();
+        }
+        if (mutation.type == GraphMutation::Type::AddVertex && !logged_.empty() &&
+            logged_.back().type == GraphMutation::Type::AddVertex)
+        {
+            ++logged_.back().a;
+        }
+        else if (mutation.type == GraphMutation::Type::AddVertex)
+        {
+            logged_.push_back({GraphMutation::Type::AddVertex, 1, 0, 0});
+        }
+        else
+        {
+            logged_.push_back(mutation);
+        }
+    }
+    return result;
+}
+
+void GraphStore::Writer::logGenerated(const std::string &spec)
+{
+    logged_.clear();
+    generated_ = spec;
+}
+
+// Publish all mutations made so far as one new version; ends the transaction
+void GraphStore::Writer::commit()
+{
+    if (committed_)
+    {
+        return;
+    }
+    MutationLog *log = store_.log_;
+    uint64_t lsn = 0;
+    if (log && !generated_.empty())
+    {
+        LogRecord record;
+        record.kind = LogRecord::Kind::Generate;
+        record.graph = store_.name();
+        record.spec = generated_;
+        lsn = log->append(record);
+    }
+    if (log && !logged_.empty())
+    {
+        LogRecord record;
+        record.kind = LogRecord::Kind::Mutations;
+        record.graph = store_.name();
+        record.mutations.swap(logged_);
+        lsn = log->append(record);
+    }
+    if (lsn != 0)
+    {
+        // The lock is held meanwhile: a later writer must start from this
+        // commit's state, which is not visible until it is durable. Commits
+        // to other graphs still share the sync.
+        log->waitDurable(lsn);
+        store_.lastLsn_.store(lsn);
+    }
+    store_.publish(std::move(draft_));
+    committed_ = true;
+}
+
+// Memory of the current snapshot and of every cached MST (stale ones included,
+// they are held until replaced)
+GraphMemory GraphStore::memoryUsage()
+{
+    GraphMemory memory = snapshot()->memoryUsage();
+    ProfiledLock<ProfiledMutex> lock(mstCacheMutex_, LOCK_SITE());
+    for (const auto &entry : mstCache_)
+    {
+        memory.mstCache += sizeof(std::vector<Edge>) + entry.second.edges->capacity() * sizeof(Edge);
+    }
+    return memory;
+}
+
+void GraphStore::attachLog(MutationLog *log)
+{
+    log_ = log;
+}
+
+uint64_t GraphStore::lastLsn() const
+{
+    return lastLsn_.load();
+}
+
+std::shared_ptr<const Graph> GraphStore::checkpointSnapshot(uint64_t &lsn)
+{
+    ProfiledLock<ProfiledTimedMutex> lock(writerMutex_, LOCK_SITE());
+    lsn = lastLsn_.load();
+    return snapshot();
+}
+
+void GraphStore::restore(std::shared_ptr<Graph> graph, uint64_t lsn)
+{
+    ProfiledLock<ProfiledTimedMutex> lock(writerMutex_, LOCK_SITE());
+    publish(std::move(graph));
+    lastLsn_.store(lsn);
+}
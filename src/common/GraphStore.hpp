@@ -0,0 +1,119 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <stdexcept>
+#include "Graph.hpp"
+#include "GraphMutation.hpp"
+#include "../utils/lockprofiler.hpp"
+
+class MutationLog;
+
+// Thrown when a write transaction cannot start before its deadline
+class GraphBusyError : public std::runtime_error
+{
+public:
+    explicit GraphBusyError(const std::string &graphName)
+        : std::runtime_error("Graph '" + graphName + "' is busy") {}
+};
+
+// GraphStore publishes immutable Graph snapshots (read-copy-update).
+// Readers grab the current snapshot without blocking on writers; writers are
+// serialized, mutate a private copy that shares untouched adjacency lists with
+// the current snapshot, and publish it atomically on commit. An old snapshot is
+// freed when the last reader holding it drops its pointer.
+// Each store also caches the MST of its latest snapshot per algorithm.
+// With a MutationLog attached, every commit that changed the graph is logged,
+// and in sync-on-commit mode published only once its record is durable, so no
+// reader or later writer sees a change that a crash could lose.
+class GraphStore
+{
+public:
+    // RAII write transaction: holds the writer lock for its lifetime.
+    // Mutations made through graph() become visible only after commit(),
+    // after which graph() must not be used; a Writer destroyed without
+    // commit() discards them.
+    class Writer
+    {
+    public:
+        explicit Writer(GraphStore &store);
+        // wait at most `deadline` for the writer lock, throws GraphBusyError otherwise
+        Writer(GraphStore &store, std::chrono::milliseconds deadline);
+        ~Writer();
+        Writer(const Writer &) = delete;
+        Writer &operator=(const Writer &) = delete;
+
+        Graph &graph();
+        // apply a mutation to the draft, returns GraphMutation::applyTo's result
+        int apply(const GraphMutation &mutation);
+        // log the draft as generated from this spec (GeneratorSpec::toString)
+        // instead of the mutations applied so far; for generators that fill
+        // graph() directly
+        void logGenerated(const std::string &spec);
+        // publish; with a log in sync-on-commit mode, first waits (holding
+        // the writer lock) for the record to be durable. Throws, publishing
+        // nothing, if the log fails.
+        void commit();
+        // time spent waiting for the writer lock
+        std::chrono::microseconds waited() const;
+
+    private:
+        GraphStore &store_;
+        ProfiledLock<ProfiledTimedMutex> lock_;
+        std::chrono::microseconds waited_;
+        std::shared_ptr<Graph> draft_;
+        bool committed_;
+        // changes to log on commit (only kept while a log is attached)
+        std::vector<GraphMutation> logged_;
+        std::string generated_;
+    };
+
+    // lsn is the log position of the record that created the graph, so replay
+    // skips what an earlier graph of the same name logged before it
+    explicit GraphStore(const std::string &name = "default", uint64_t lsn = 0);
+
+    // get the name of the graph
+    const std::string &name() const;
+    // get the current snapshot (never null)
+    std::shared_ptr<const Graph> snapshot() const;
+    // get the version of the current snapshot
+    uint64_t version() const;
+    // get the MST of a snapshot, computed once per version and algorithm
+    std::shared_ptr<const std::vector<Edge>> findMST(const std::shared_ptr<const Graph> &graph, const std::string &algorithm);
+    // bytes of the current snapshot by structure, plus the MST cache
+    GraphMemory memoryUsage();
+
+    // log commits to this log from now on
+    void attachLog(MutationLog *log);
+    // LSN of the last logged change included in the current snapshot
+    uint64_t lastLsn() const;
+    // the current snapshot and its lastLsn, read together under the writer lock
+    std::shared_ptr<const Graph> checkpointSnapshot(uint64_t &lsn);
+    // publish a graph rebuilt by recovery as the state up to log position lsn
+    void restore(std::shared_ptr<Graph> graph, uint64_t lsn);
+
+private:
+    struct CachedMST
+    {
+        uint64_t version;
+        std::shared_ptr<const std::vector<Edge>> edges;
+    };
+
+    void publish(std::shared_ptr<Graph> next);
+
+    // accessed only through std::atomic_load / std::atomic_store
+    std::shared_ptr<const Graph> current_;
+    std::atomic<uint64_t> version_;
+    ProfiledTimedMutex writerMutex_;
+    const std::string name_;
+    // algorithm name (lowercase) -> MST of the newest snapshot it was computed for
+    std::unordered_map<std::string, CachedMST> mstCache_;
+    ProfiledMutex mstCacheMutex_;
+    MutationLog *log_;
+    std::atomic<uint64_t> lastLsn_;
+};
@@ -1,4 +1,6 @@
 #include "KruskalMST.hpp"
+#include "../utils/tracing.hpp"
+#include "../utils/arena.hpp"
 #include <algorithm>
 #include <queue>
 #include <stdexcept>
@@ -8,29 +10,35 @@
 
 using namespace std;
 
-vector<Edge> KruskalMST::findMST(const Graph &graph)
+// Strict order of the edges Kruskal considers (see KruskalMST.hpp)
+bool KruskalMST::before(const Edge &a, const Edge &b)
 {
-    if (graph.getVertices() < 2)
+    if (a.weight != b.weight)
     {
-        throw std::runtime_error("Graph must have at least 2 vertices for MST");
+        return a.weight < b.weight;
     }
-
-    vector<Edge> mst;
-    vector<Edge> allEdges;
-    int numVertices = graph.getVertices();
-
-    // Collect all edges from the graph
-    for (int i = 0; i < numVertices; ++i)
+    if (a.source != b.source)
     {
-        vector<Edge> adjacentEdges = graph.getAdjacentEdges(i);
-        allEdges.insert(allEdges.end(), adjacentEdges.begin(), adjacentEdges.end());
+        return a.source < b.source;
     }
+    return a.destination < b.destination;
+}
+
+// Take the sorted edges that join two components until the forest spans
+// every component; the edges are in vertex-ID space, as is the disjoint set
+template <typename Edges>
+static vector<Edge> spanningForest(int numVertices, Edges &edges)
+{
+    vector<Edge> mst;
+    mst.reserve(numVertices > 0 ? numVertices - 1 : 0);
 
-    // Sort edges by weight
-    sort(allEdges.begin(), allEdges.end());
+    // Sort edges by weight, then endpoints
+    sort(edges.begin(), edges.end(), KruskalMST::before);
 
     // Initialize disjoint set
-    vector<int> parent(numVertices);
+    ScratchScope scratch;
+    ArenaAllocator<int> arena(scratch.arena());
+    ScratchVector<int> parent(numVertices, 0, arena);
     for (int i = 0; i < numVertices; ++i)
     {
         parent[i] = i;
@@ -58,7 +66,7 @@ vector<Edge> KruskalMST::findMST(const Graph &graph)
     };
 
     // Kruskal's algorithm
-    for (const Edge &edge : allEdges)
+    for (const Edge &edge : edges)
     {
         int sourceRoot = find(edge.source);
         int destRoot = find(edge.destination);
@@ -76,4 +84,44 @@ vector<Edge> KruskalMST::findMST(const Graph &graph)
     }
 
     return mst;
-}
\ No newline at end of file
+}
+
+vector<Edge> KruskalMST::findMST(const Graph &graph)
+{
+    TraceSpan span("kruskal");
+    if (graph.getVertices() < 2)
+    {
+        throw std::runtime_error("Graph must have at least 2 vertices for MST");
+    }
+
+    int numVertices = graph.getVertices();
+
+    // Working arrays live in this thread's scratch arena, reused across calls
+    ScratchScope scratch;
+    ArenaAllocator<Edge> arena(scratch.arena());
+    ScratchVector<Edge> allEdges(arena);
+
+    // Collect each edge once, from its lower-ID end, by storage position (see
+    // Graph::forEachNeighborAt); self-loops never join two components
+    allEdges.reserve(static_cast<size_t>(graph.getEdges()));
+    for (int i = 0; i < numVertices; ++i)
+    {
+        int source = graph.vertexAt(i);
+        graph.forEachNeighborAt(i, [&allEdges, &graph, source](int destination, int weight)
+                                {
+            int destinationId = graph.vertexAt(destination);
+            if (source < destinationId)
+            {
+                allEdges.push_back(Edge(source, destinationId, weight));
+            } });
+    }
+
+    return spanningForest(numVertices, allEdges);
+}
+
+// Minimum spanning forest of an edge list (see KruskalMST.hpp)
+vector<Edge> KruskalMST::fromEdges(int numVertices, vector<Edge> edges)
+{
+    TraceSpan span("kruskal_merge");
+    return spanningForest(numVertices, edges);
+}
@@ -5,4 +5,13 @@ class KruskalMST : public MST
 {
 public:
     std::vector<Edge> findMST(const Graph &graph) override;
-};
\ No newline at end of file
+
+    // Edges are taken by weight, ties broken by source and then destination
+    // (vertex IDs, source < destination), so the tree is the same whatever
+    // the graph's storage order and however the edges were gathered
+    static bool before(const Edge &a, const Edge &b);
+    // Kruskal over an edge list on vertices 0..numVertices-1, each edge given
+    // once with source < destination: the minimum spanning forest in the
+    // order findMST returns it. Used to merge partial forests (see cluster.hpp).
+    static std::vector<Edge> fromEdges(int numVertices, std::vector<Edge> edges);
+};
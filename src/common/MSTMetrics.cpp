@@ -1,4 +1,7 @@
 #include "MSTMetrics.hpp"
+#include "../utils/metrics.hpp"
+#include "../utils/tracing.hpp"
+#include "../utils/arena.hpp"
 #include <limits>
 #include <algorithm>
 #include <numeric>
@@ -6,6 +9,29 @@
 
 using namespace std;
 
+namespace
+{
+    // n x n distances, all "unreachable", as one block of scratch memory;
+    // dist[i][j] reads and writes like a nested vector
+    class DistanceMatrix
+    {
+    public:
+        DistanceMatrix(size_t n, Arena &arena)
+            : n_(n), cells_(n * n, numeric_limits<int>::max(), ArenaAllocator<int>(arena)) {}
+        int *operator[](size_t row) { return cells_.data() + row * n_; }
+
+    private:
+        size_t n_;
+        ScratchVector<int> cells_;
+    };
+}
+
+// Series timing one metric computation
+static size_t metricSeries(const string &metric)
+{
+    return Metrics::global().histogram("mst_metric_duration_us", "metric=\"" + metric + "\"", "Time to compute an MST metric, in microseconds");
+}
+
 int MSTMetrics::getTotalWeight(const vector<Edge> &mst)
 {
     int total = 0;
@@ -18,12 +44,16 @@ int MSTMetrics::getTotalWeight(const vector<Edge> &mst)
 //
 int MSTMetrics::getLongestDistance(const Graph &graph, const vector<Edge> &mst)
 {
+    static const size_t series = metricSeries("longest");
+    Metrics::Timer timer(series);
+    TraceSpan span("metric", "longest");
     if (mst.empty())
     {
         return 0;
     }
 
-    vector<vector<int>> dist(graph.getVertices(), vector<int>(graph.getVertices(), numeric_limits<int>::max()));
+    ScratchScope scratch;
+    DistanceMatrix dist(graph.getVertices(), scratch.arena());
 
     // Initialize distances with MST edges
     for (const auto &edge : mst)
@@ -67,13 +97,17 @@ int MSTMetrics::getLongestDistance(const Graph &graph, const vector<Edge> &mst)
 
 double MSTMetrics::getAverageDistance(const Graph &graph, const vector<Edge> &mst)
 {
+    static const size_t series = metricSeries("average");
+    Metrics::Timer timer(series);
+    TraceSpan span("metric", "average");
     if (mst.empty())
     {
         return 0.0;
     }
 
     int numVertices = graph.getVertices();
-    vector<vector<int>> dist(numVertices, vector<int>(numVertices, numeric_limits<int>::max()));
+    ScratchScope scratch;
+    DistanceMatrix dist(numVertices, scratch.arena());
 
     // Initialize distances with MST edges
     for (const auto &edge : mst)
@@ -120,11 +154,20 @@ double MSTMetrics::getAverageDistance(const Graph &graph, const vector<Edge> &ms
 
 int MSTMetrics::getShortestDistance(const vector<Edge> &mst)
 {
+    static const size_t series = metricSeries("shortest");
+    Metrics::Timer timer(series);
+    TraceSpan span("metric", "shortest");
     if (mst.empty())
         return 0;
 
-    size_t size = mst.size();
-    vector<vector<int>> dist(size + 1, vector<int>(size + 1, numeric_limits<int>::max()));
+    // Index by vertex ID; when the MST is a forest the IDs can exceed the edge count
+    size_t size = 0;
+    for (const auto &edge : mst)
+    {
+        size = max(size, static_cast<size_t>(max(edge.source, edge.destination)));
+    }
+    ScratchScope scratch;
+    DistanceMatrix dist(size + 1, scratch.arena());
 
     // Initialize distances with MST edges
     for (const auto &edge : mst)
@@ -0,0 +1,837 @@
+#include "MutationLog.hpp"
+#include "GraphRegistry.hpp"
+#include "GraphGenerators.hpp"
+#include "Protocol.hpp"
+#include "../utils/metrics.hpp"
+#include "../utils/tracing.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// This file implements the write-ahead mutation log: framing, group commit,
+// snapshots, checkpoints and recovery.
+
+using protocol::PayloadReader;
+using protocol::PayloadWriter;
+
+namespace
+{
+    const char *const CHECKPOINT_FILE = "checkpoint.bin";
+    const char *const CHECKPOINT_TEMP = "checkpoint.tmp";
+    const uint32_t CHECKPOINT_MAGIC = 0x4d535443; // "MSTC"
+    const size_t FRAME_HEADER = 8;                // u32 length, u32 CRC
+
+    // Lookup table of the reflected CRC-32 polynomial (as used by zlib)
+    struct CrcTable
+    {
+        uint32_t entries[256];
+        CrcTable()
+        {
+            for (uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+                }
+                entries[i] = crc;
+            }
+        }
+    };
+
+    // Continue a CRC-32 over more data; start from 0xFFFFFFFF and invert the end result
+    uint32_t crcUpdate(uint32_t crc, const char *data, size_t size)
+    {
+        static const CrcTable table;
+        for (size_t i = 0; i < size; ++i)
+        {
+            crc = table.entries[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    // Append body as one frame
+    void appendFrame(std::string &out, const std::string &body)
+    {
+        PayloadWriter writer(out);
+        writer.u32(static_cast<uint32_t>(body.size()));
+        writer.u32(crcUpdate(0xFFFFFFFFu, body.data(), body.size()) ^ 0xFFFFFFFFu);
+        out += body;
+    }
+
+    // Find the body of the frame at offset and move past it. Returns false if
+    // what is there is not a whole frame with a matching CRC.
+    bool nextFrame(const std::string &data, size_t &offset, const char *&body, size_t &size)
+    {
+        if (data.size() - offset < FRAME_HEADER)
+        {
+            return false;
+        }
+        PayloadReader header(data.data() + offset, FRAME_HEADER);
+        size = header.u32();
+        uint32_t crc = header.u32();
+        if (data.size() - offset - FRAME_HEADER < size)
+        {
+            return false;
+        }
+        body = data.data() + offset + FRAME_HEADER;
+        if ((crcUpdate(0xFFFFFFFFu, body, size) ^ 0xFFFFFFFFu) != crc)
+        {
+            return false;
+        }
+        offset += FRAME_HEADER + size;
+        return true;
+    }
+
+    std::string segmentName(uint64_t firstLsn)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "wal-%016llx.log", static_cast<unsigned long long>(firstLsn));
+        return name;
+    }
+
+    std::string readFile(const std::string &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        return contents.str();
+    }
+
+    void writeAll(int fd, const std::string &data)
+    {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+            if (count < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                throw std::runtime_error(std::string("write: ") + std::strerror(errno));
+            }
+            written += static_cast<size_t>(count);
+        }
+    }
+}
+
+// LogRecord implementation
+
+// kind, graph name, then the kind's payload. Mutations carry only the fields
+// their type uses, so a bulk build costs about 13 bytes per edge.
+std::string LogRecord::encode() const
+{
+    std::string out;
+    PayloadWriter writer(out);
+    writer.u8(static_cast<uint8_t>(kind));
+    writer.str(graph);
+    if (kind == Kind::Generate)
+    {
+        writer.str(spec);
+    }
+    else if (kind == Kind::Mutations)
+    {
+        writer.u32(static_cast<uint32_t>(mutations.size()));
+        for (const GraphMutation &mutation : mutations)
+        {
+            writer.u8(static_cast<uint8_t>(mutation.type));
+            switch (mutation.type)
+            {
+            case GraphMutation::Type::Clear:
+                break;
+            case GraphMutation::Type::AddVertex:
+            case GraphMutation::Type::RemoveVertex:
+                writer.i32(mutation.a);
+                break;
+            case GraphMutation::Type::RemoveEdge:
+                writer.i32(mutation.a);
+                writer.i32(mutation.b);
+                break;
+            default:
+                writer.i32(mutation.a);
+                writer.i32(mutation.b);
+                writer.i32(mutation.c);
+                break;
+            }
+        }
+    }
+    return out;
+}
+
+LogRecord LogRecord::decode(const char *data, size_t size)
+{
+    PayloadReader reader(data, size);
+    LogRecord record;
+    uint8_t kind = reader.u8();
+    if (kind < static_cast<uint8_t>(Kind::Mutations) || kind > static_cast<uint8_t>(Kind::DropGraph))
+    {
+        throw protocol::ProtocolError("Unknown log record kind " + std::to_string(kind));
+    }
+    record.kind = static_cast<Kind>(kind);
+    record.graph = reader.str();
+    if (record.kind == Kind::Generate)
+    {
+        record.spec = reader.str();
+    }
+    else if (record.kind == Kind::Mutations)
+    {
+        uint32_t count = reader.u32();
+        record.mutations.reserve(std::min<size_t>(count, reader.remaining()));
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            GraphMutation mutation{static_cast<GraphMutation::Type>(reader.u8()), 0, 0, 0};
+            switch (mutation.type)
+            {
+            case GraphMutation::Type::Clear:
+                break;
+            case GraphMutation::Type::AddVertex:
+            case GraphMutation::Type::RemoveVertex:
+                mutation.a = reader.i32();
+                break;
+            case GraphMutation::Type::RemoveEdge:
+                mutation.a = reader.i32();
+                mutation.b = reader.i32();
+                break;
+            case GraphMutation::Type::AddEdge:
+            case GraphMutation::Type::ChangeWeight:
+                mutation.a = reader.i32();
+                mutation.b = reader.i32();
+                mutation.c = reader.i32();
+                break;
+            default:
+                throw protocol::ProtocolError("Unknown mutation type in log record");
+            }
+            record.mutations.push_back(mutation);
+        }
+    }
+    return record;
+}
+
+// MutationLog implementation
+
+MutationLog::MutationLog(const MutationLogOptions &options) : options_(options)
+{
+}
+
+MutationLog::~MutationLog()
+{
+    stop();
+}
+
+std::string MutationLog::path(const std::string &file) const
+{
+    return options_.directory + "/" + file;
+}
+
+// Make renames and newly created files in the log directory durable
+void MutationLog::syncDirectory() const
+{
+    int fd = ::open(options_.directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd != -1)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
+
+void MutationLog::openSegment(uint64_t firstLsn)
+{
+    std::string file = path(segmentName(firstLsn));
+    int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Cannot open " + file + ": " + std::strerror(errno));
+    }
+    if (fd_ != -1)
+    {
+        ::close(fd_);
+    }
+    fd_ = fd;
+    syncDirectory();
+}
+
+size_t MutationLog::recover(GraphRegistry &registry)
+{
+    if (::mkdir(options_.directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        throw std::runtime_error("Cannot create " + options_.directory + ": " + std::strerror(errno));
+    }
+    ::unlink(path(CHECKPOINT_TEMP).c_str());
+    uint64_t checkpointSegment = loadCheckpoint(registry);
+    uint64_t lastLsn = checkpointSegment > 0 ? checkpointSegment - 1 : 0;
+
+    std::vector<uint64_t> found;
+    if (DIR *dir = ::opendir(options_.directory.c_str()))
+    {
+        while (struct dirent *entry = ::readdir(dir))
+        {
+            unsigned long long firstLsn;
+            char suffix[8];
+            if (std::sscanf(entry->d_name, "wal-%16llx.%4s", &firstLsn, suffix) == 2 && std::string(suffix) == "log")
+            {
+                found.push_back(firstLsn);
+            }
+        }
+        ::closedir(dir);
+    }
+    std::sort(found.begin(), found.end());
+
+    // Segments before the checkpoint's are covered by it. A torn record ends
+    // the log: the segment is cut there and anything after it is dropped.
+    size_t replayed = 0;
+    bool torn = false;
+    for (uint64_t firstLsn : found)
+    {
+        std::string file = path(segmentName(firstLsn));
+        if (torn || firstLsn < checkpointSegment)
+        {
+            ::unlink(file.c_str());
+            continue;
+        }
+        std::string data = readFile(file);
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            size_t start = offset;
+            LogRecord record;
+            bool valid = nextRecord(data, offset, record);
+            if (!valid)
+            {
+                std::cerr << "Write-ahead log: torn record at " << file << ":" << start << ", ignoring the rest" << std::endl;
+                if (::truncate(file.c_str(), static_cast<off_t>(start)) != 0)
+                {
+                    throw std::runtime_error("Cannot truncate " + file + ": " + std::strerror(errno));
+                }
+                torn = true;
+                offset = start;
+                break;
+            }
+            replay(registry, record);
+            lastLsn = std::max(lastLsn, record.lsn);
+            ++replayed;
+        }
+        segments_.push_back(firstLsn);
+        bytesSinceCheckpoint_ += offset;
+    }
+
+    // New records go to a new segment
+    nextLsn_ = lastLsn + 1;
+    durableLsn_ = lastLsn;
+    openSegment(nextLsn_);
+    if (segments_.empty() || segments_.back() != nextLsn_)
+    {
+        segments_.push_back(nextLsn_);
+    }
+    return replayed;
+}
+
+bool MutationLog::nextRecord(const std::string &data, size_t &offset, LogRecord &record)
+{
+    size_t start = offset;
+    const char *body;
+    size_t size;
+    if (!nextFrame(data, offset, body, size) || size < sizeof(uint64_t))
+    {
+        offset = start;
+        return false;
+    }
+    try
+    {
+        record = LogRecord::decode(body, size - sizeof(uint64_t));
+        record.lsn = PayloadReader(body + size - sizeof(uint64_t), sizeof(uint64_t)).u64();
+    }
+    catch (const protocol::ProtocolError &)
+    {
+        offset = start;
+        return false;
+    }
+    return true;
+}
+
+// A graph skips records at or below the LSN its state already includes
+// (from a checkpoint or snapshot)
+void MutationLog::replay(GraphRegistry &registry, const LogRecord &record)
+{
+    std::shared_ptr<GraphStore> store = registry.find(record.graph);
+    if (store && record.lsn <= store->lastLsn())
+    {
+        return;
+    }
+    switch (record.kind)
+    {
+    case LogRecord::Kind::CreateGraph:
+        if (!store)
+        {
+            registry.create(record.graph, record.lsn);
+        }
+        break;
+    case LogRecord::Kind::DropGraph:
+        if (store)
+        {
+            registry.drop(record.graph);
+        }
+        break;
+    case LogRecord::Kind::Mutations:
+        if (store)
+        {
+            auto graph = std::make_shared<Graph>(*store->snapshot());
+            for (const GraphMutation &mutation : record.mutations)
+            {
+                if (mutation.type == GraphMutation::Type::AddVertex)
+                {
+                    for (int i = 0; i < mutation.a; ++i)
+                    {
+                        graph->addVertex();
+                    }
+                }
+                else
+                {
+                    mutation.applyTo(*graph);
+                }
+            }
+            store->restore(graph, record.lsn);
+        }
+        break;
+    case LogRecord::Kind::Generate:
+        if (store)
+        {
+            GraphGenerator generator(GeneratorSpec::parse(record.spec));
+            std::vector<std::vector<Edge>> batches(generator.chunks());
+            for (size_t chunk = 0; chunk < batches.size(); ++chunk)
+            {
+                generator.generateChunk(chunk, batches[chunk]);
+            }
+            auto graph = std::make_shared<Graph>(generator.vertices());
+            graph->addEdgesInRange(batches, 0, generator.vertices());
+            store->restore(graph, record.lsn);
+        }
+        break;
+    }
+}
+
+// Snapshot layout: a header body (u32 magic, u64 log position, u32 graph
+// count), then one body per graph: str name, u64 last LSN, u32 vertices,
+// u32 degree per vertex, then (i32 destination, i32 weight) per neighbor in
+// adjacency order. Each graph is read under its writer lock, so its snapshot
+// and LSN agree.
+std::vector<std::string> MutationLog::encodeSnapshot(GraphRegistry &registry, uint64_t position)
+{
+    std::vector<std::string> names = registry.list();
+    std::vector<std::string> bodies(1);
+    PayloadWriter header(bodies[0]);
+    header.u32(CHECKPOINT_MAGIC);
+    header.u64(position);
+    header.u32(static_cast<uint32_t>(names.size()));
+    for (const std::string &name : names)
+    {
+        // A graph dropped meanwhile is saved empty; its drop record follows in the log
+        std::shared_ptr<GraphStore> store = registry.find(name);
+        uint64_t lastLsn = 0;
+        std::shared_ptr<const Graph> graph = store ? store->checkpointSnapshot(lastLsn) : std::make_shared<const Graph>();
+        bodies.emplace_back();
+        PayloadWriter writer(bodies.back());
+        writer.str(name);
+        writer.u64(lastLsn);
+        int vertices = graph->getVertices();
+        writer.u32(static_cast<uint32_t>(vertices));
+        for (int vertex = 0; vertex < vertices; ++vertex)
+        {
+            writer.u32(static_cast<uint32_t>(graph->degree(vertex)));
+        }
+        for (int vertex = 0; vertex < vertices; ++vertex)
+        {
+            graph->forEachNeighbor(vertex, [&writer](int destination, int weight)
+                                   {
+                writer.i32(destination);
+                writer.i32(weight); });
+        }
+    }
+    return bodies;
+}
+
+uint64_t MutationLog::decodeSnapshotHeader(const char *data, size_t size, uint32_t &graphs)
+{
+    PayloadReader header(data, size);
+    if (header.u32() != CHECKPOINT_MAGIC)
+    {
+        throw protocol::ProtocolError("Not a graph snapshot");
+    }
+    uint64_t position = header.u64();
+    graphs = header.u32();
+    return position;
+}
+
+std::string MutationLog::restoreSnapshotGraph(GraphRegistry &registry, const char *data, size_t size)
+{
+    PayloadReader reader(data, size);
+    std::string name = reader.str();
+    uint64_t lastLsn = reader.u64();
+    uint32_t vertices = reader.u32();
+    auto adjacency = std::make_shared<CompactAdjacency>();
+    adjacency->offsets.resize(vertices + 1);
+    adjacency->offsets[0] = 0;
+    for (uint32_t vertex = 0; vertex < vertices; ++vertex)
+    {
+        adjacency->offsets[vertex + 1] = adjacency->offsets[vertex] + reader.u32();
+    }
+    if (reader.remaining() != adjacency->neighborCount() * 2 * sizeof(int32_t))
+    {
+        throw protocol::ProtocolError("Malformed snapshot of graph '" + name + "'");
+    }
+    adjacency->neighbors.reset(new Neighbor[adjacency->neighborCount()]);
+    for (size_t k = 0; k < adjacency->neighborCount(); ++k)
+    {
+        adjacency->neighbors[k].destination = reader.i32();
+        adjacency->neighbors[k].weight = reader.i32();
+    }
+
+    std::shared_ptr<GraphStore> store = registry.find(name);
+    if (!store)
+    {
+        store = registry.create(name);
+    }
+    store->restore(vertices > 0 ? std::make_shared<Graph>(std::move(adjacency)) : std::make_shared<Graph>(), lastLsn);
+    return name;
+}
+
+// The checkpoint file holds a snapshot, one frame per body
+uint64_t MutationLog::loadCheckpoint(GraphRegistry &registry)
+{
+    std::string file = path(CHECKPOINT_FILE);
+    if (::access(file.c_str(), F_OK) != 0)
+    {
+        return 0;
+    }
+    std::string data = readFile(file);
+    size_t offset = 0;
+    const char *body;
+    size_t size;
+    uint32_t graphs = 0;
+    uint64_t position = 0;
+    try
+    {
+        if (!nextFrame(data, offset, body, size))
+        {
+            throw protocol::ProtocolError("bad header");
+        }
+        position = decodeSnapshotHeader(body, size, graphs);
+        for (uint32_t i = 0; i < graphs; ++i)
+        {
+            if (!nextFrame(data, offset, body, size))
+            {
+                throw protocol::ProtocolError("bad graph frame");
+            }
+            restoreSnapshotGraph(registry, body, size);
+        }
+    }
+    catch (const protocol::ProtocolError &e)
+    {
+        throw std::runtime_error("Corrupt checkpoint " + file + ": " + e.what());
+    }
+    return position;
+}
+
+void MutationLog::start(GraphRegistry &registry)
+{
+    registry_ = &registry;
+    syncer_ = std::thread(&MutationLog::syncerThread, this);
+    checkpointer_ = std::thread(&MutationLog::checkpointThread, this);
+}
+
+void MutationLog::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex_);
+        checkpointStopping_ = true;
+    }
+    checkpointCondition_.notify_all();
+    if (checkpointer_.joinable())
+    {
+        checkpointer_.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(appendMutex_);
+        stopping_ = true;
+    }
+    appendCondition_.notify_all();
+    if (syncer_.joinable())
+    {
+        syncer_.join();
+    }
+    if (fd_ != -1)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+// The body is encoded and most of its CRC computed before taking the lock;
+// only the LSN, which goes last, is added under it
+uint64_t MutationLog::append(LogRecord &record)
+{
+    static const size_t records = Metrics::global().counter("mst_wal_records_total", "", "Records appended to the write-ahead log");
+    std::string body = record.encode();
+    uint32_t crc = crcUpdate(0xFFFFFFFFu, body.data(), body.size());
+    {
+        std::lock_guard<std::mutex> lock(appendMutex_);
+        if (!failed_.empty())
+        {
+            throw std::runtime_error("Write-ahead log failed: " + failed_);
+        }
+        record.lsn = nextLsn_++;
+        std::string lsn;
+        PayloadWriter(lsn).u64(record.lsn);
+        crc = crcUpdate(crc, lsn.data(), lsn.size()) ^ 0xFFFFFFFFu;
+        PayloadWriter writer(pending_);
+        writer.u32(static_cast<uint32_t>(body.size() + lsn.size()));
+        writer.u32(crc);
+        pending_ += body;
+        pending_ += lsn;
+    }
+    appendCondition_.notify_one();
+    Metrics::global().add(records);
+    return record.lsn;
+}
+
+void MutationLog::waitDurable(uint64_t lsn)
+{
+    if (!options_.syncOnCommit)
+    {
+        return;
+    }
+    static const size_t waits = Metrics::global().histogram("mst_wal_commit_wait_us", "", "Time a commit waited for its log record to be durable, in microseconds");
+    Metrics::Timer timer(waits);
+    TraceSpan span("wal_wait");
+    std::unique_lock<std::mutex> lock(durableMutex_);
+    durableCondition_.wait(lock, [this, lsn]
+                           { return durableLsn_ >= lsn || !error_.empty(); });
+    if (durableLsn_ < lsn)
+    {
+        throw std::runtime_error("Write-ahead log failed: " + error_);
+    }
+}
+
+void MutationLog::setListener(std::function<void(const std::string &, uint64_t)> listener)
+{
+    std::lock_guard<std::mutex> lock(appendMutex_);
+    listener_ = std::move(listener);
+}
+
+uint64_t MutationLog::durableLsn() const
+{
+    std::lock_guard<std::mutex> lock(durableMutex_);
+    return durableLsn_;
+}
+
+// Write out the pending batch with one fdatasync per round. Records appended
+// while a round is on disk form the next batch. Rotation requests from the
+// checkpoint thread are handled between rounds.
+void MutationLog::syncerThread()
+{
+    tracing::setThreadName("wal syncer");
+    Metrics &metrics = Metrics::global();
+    static const size_t syncs = metrics.counter("mst_wal_syncs_total", "", "Batches of log records made durable with one fdatasync");
+    static const size_t bytes = metrics.counter("mst_wal_bytes_total", "", "Bytes written to the write-ahead log");
+    static const size_t syncTime = metrics.histogram("mst_wal_sync_us", "", "Time to write and fdatasync one batch of log records, in microseconds");
+
+    std::unique_lock<std::mutex> lock(appendMutex_);
+    while (true)
+    {
+        appendCondition_.wait(lock, [this]
+                              { return stopping_ || !pending_.empty() || rotateRequested_; });
+        if (pending_.empty() && !rotateRequested_)
+        {
+            break;
+        }
+        if (!failed_.empty())
+        {
+            // Fail-stop: nothing may follow a batch that did not reach the
+            // disk, or a later sync would report its lost records durable.
+            // Records that raced in before append saw the failure are dropped
+            // and their waiters get the error.
+            pending_.clear();
+            rotateRequested_ = false;
+            rotationCondition_.notify_all();
+            continue;
+        }
+        if (options_.groupDelayUs > 0 && !stopping_ && !rotateRequested_)
+        {
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::microseconds(options_.groupDelayUs));
+            lock.lock();
+        }
+        std::string batch;
+        batch.swap(pending_);
+        uint64_t last = nextLsn_ - 1;
+        bool rotate = rotateRequested_;
+        std::function<void(const std::string &, uint64_t)> listener = listener_;
+        lock.unlock();
+
+        std::string failure;
+        try
+        {
+            if (!batch.empty())
+            {
+                TraceSpan span("wal_sync");
+                Metrics::Timer timer(syncTime);
+                writeAll(fd_, batch);
+                if (::fdatasync(fd_) != 0)
+                {
+                    throw std::runtime_error(std::string("fdatasync: ") + std::strerror(errno));
+                }
+                metrics.add(syncs);
+                metrics.add(bytes, batch.size());
+                bytesSinceCheckpoint_ += batch.size();
+            }
+            if (rotate)
+            {
+                openSegment(last + 1);
+                bytesSinceCheckpoint_ = 0;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            failure = e.what();
+        }
+        {
+            std::lock_guard<std::mutex> durable(durableMutex_);
+            if (failure.empty())
+            {
+                durableLsn_ = last;
+            }
+            else if (error_.empty())
+            {
+                error_ = failure;
+                std::cerr << "Write-ahead log: " << failure << std::endl;
+            }
+        }
+        durableCondition_.notify_all();
+        if (listener && failure.empty() && !batch.empty())
+        {
+            listener(batch, last);
+        }
+        if (bytesSinceCheckpoint_ >= options_.checkpointBytes)
+        {
+            checkpointCondition_.notify_one();
+        }
+
+        lock.lock();
+        if (!failure.empty())
+        {
+            failed_ = failure;
+        }
+        if (rotate)
+        {
+            if (failure.empty() && (segments_.empty() || segments_.back() != last + 1))
+            {
+                segments_.push_back(last + 1);
+            }
+            rotateRequested_ = false;
+            rotatedAt_ = last + 1;
+            rotationCondition_.notify_all();
+        }
+    }
+}
+
+// Checkpoint whenever the log has grown past checkpointBytes
+void MutationLog::checkpointThread()
+{
+    tracing::setThreadName("wal checkpoint");
+    std::unique_lock<std::mutex> lock(checkpointMutex_);
+    while (!checkpointStopping_)
+    {
+        checkpointCondition_.wait_for(lock, std::chrono::seconds(1));
+        if (checkpointStopping_ || bytesSinceCheckpoint_ < options_.checkpointBytes)
+        {
+            continue;
+        }
+        lock.unlock();
+        try
+        {
+            checkpoint();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Write-ahead log: checkpoint failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+// Start a new segment, then save a snapshot of every graph. Every record of
+// the older segments is at or below its graph's LSN in the snapshot, which
+// makes those segments redundant once the checkpoint file is in place.
+void MutationLog::checkpoint()
+{
+    static const size_t checkpoints = Metrics::global().counter("mst_wal_checkpoints_total", "", "Checkpoints written by the write-ahead log");
+    TraceSpan span("wal_checkpoint");
+    uint64_t segment;
+    {
+        std::unique_lock<std::mutex> lock(appendMutex_);
+        rotateRequested_ = true;
+        appendCondition_.notify_one();
+        rotationCondition_.wait(lock, [this]
+                                { return !rotateRequested_; });
+        if (!failed_.empty())
+        {
+            throw std::runtime_error("the log failed: " + failed_);
+        }
+        segment = rotatedAt_;
+    }
+
+    std::string data;
+    for (const std::string &body : encodeSnapshot(*registry_, segment))
+    {
+        appendFrame(data, body);
+    }
+
+    std::string temp = path(CHECKPOINT_TEMP);
+    int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        throw std::runtime_error("Cannot open " + temp + ": " + std::strerror(errno));
+    }
+    try
+    {
+        writeAll(fd, data);
+        if (::fsync(fd) != 0)
+        {
+            throw std::runtime_error(std::string("fsync: ") + std::strerror(errno));
+        }
+    }
+    catch (...)
+    {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (::rename(temp.c_str(), path(CHECKPOINT_FILE).c_str()) != 0)
+    {
+        throw std::runtime_error("Cannot rename " + temp + ": " + std::strerror(errno));
+    }
+    syncDirectory();
+
+    std::vector<uint64_t> obsolete;
+    {
+        std::lock_guard<std::mutex> lock(appendMutex_);
+        auto keep = std::lower_bound(segments_.begin(), segments_.end(), segment);
+        obsolete.assign(segments_.begin(), keep);
+        segments_.erase(segments_.begin(), keep);
+    }
+    for (uint64_t firstLsn : obsolete)
+    {
+        ::unlink(path(segmentName(firstLsn)).c_str());
+    }
+    Metrics::global().add(checkpoints);
+}
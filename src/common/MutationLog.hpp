@@ -0,0 +1,161 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GraphMutation.hpp"
+
+class GraphRegistry;
+
+// One change to the set of graphs, as written to the log
+struct LogRecord
+{
+    enum class Kind : uint8_t
+    {
+        Mutations = 1,   // one committed write transaction
+        Generate = 2,    // the graph replaced by a synthetic one
+        CreateGraph = 3,
+        DropGraph = 4
+    };
+
+    uint64_t lsn = 0; // log sequence number, assigned by MutationLog::append
+    Kind kind = Kind::Mutations;
+    std::string graph;
+    // Mutations: in order; an AddVertex entry stands for a run of `a` vertices
+    std::vector<GraphMutation> mutations;
+    // Generate: the GeneratorSpec in GeneratorSpec::toString form
+    std::string spec;
+
+    // body of the record without its LSN (see MutationLog for the framing)
+    std::string encode() const;
+    // inverse of encode; throws protocol::ProtocolError if malformed
+    static LogRecord decode(const char *data, size_t size);
+};
+
+// Settings of a MutationLog
+struct MutationLogOptions
+{
+    std::string directory;
+    // commit waits until its record is on disk; otherwise it returns at once
+    // and a crash may lose the last few milliseconds of commits
+    bool syncOnCommit = true;
+    // the syncer waits this long after the first record of a batch so that
+    // more commits share its fdatasync
+    int groupDelayUs = 0;
+    // log bytes written since the last checkpoint that trigger the next one
+    size_t checkpointBytes = 64 * 1024 * 1024;
+};
+
+// Write-ahead log of graph mutations with group commit.
+//
+// Committing writers append their record to an in-memory batch and wait; one
+// syncer thread writes the whole batch and makes it durable with a single
+// fdatasync, then wakes every writer it covered. Under concurrent load each
+// commit therefore pays a share of one sync instead of a sync of its own.
+//
+// The log is a sequence of segment files wal-<first LSN>.log in the log
+// directory. A record is framed as u32 length, u32 CRC-32 and the body
+// (LogRecord::encode followed by the u64 LSN), all big-endian. When the log
+// outgrows checkpointBytes, a background thread starts a new segment, writes
+// every graph's snapshot to checkpoint.bin and deletes the older segments.
+// Recovery loads the checkpoint and replays the remaining records; a torn or
+// corrupt tail (a crash in the middle of a write) ends the replay.
+//
+// A failed write or sync stops the log for good: every waiting and later
+// commit fails, so none is acknowledged past a record that was lost.
+class MutationLog
+{
+public:
+    explicit MutationLog(const MutationLogOptions &options);
+    ~MutationLog();
+    MutationLog(const MutationLog &) = delete;
+    MutationLog &operator=(const MutationLog &) = delete;
+
+    // Rebuild the graphs of a registry that no log is attached to yet from
+    // the checkpoint and the log, and open a fresh segment. Returns the
+    // number of records replayed. Throws std::runtime_error on I/O errors.
+    size_t recover(GraphRegistry &registry);
+    // start the syncer and checkpoint threads; the registry must outlive stop()
+    void start(GraphRegistry &registry);
+    // make every appended record durable and join the threads
+    void stop();
+
+    // queue a record for the next batch and return its LSN; throws
+    // std::runtime_error once a write to the log has failed
+    uint64_t append(LogRecord &record);
+    // block until the record with this LSN is on disk (no-op unless syncOnCommit);
+    // throws std::runtime_error if the log could not be written
+    void waitDurable(uint64_t lsn);
+    uint64_t durableLsn() const;
+    // called by the syncer with every batch of framed records once it is
+    // durable, and the batch's last LSN (log shipping); must not block long
+    void setListener(std::function<void(const std::string &, uint64_t)> listener);
+
+    const MutationLogOptions &options() const { return options_; }
+
+    // The record framed at offset; moves offset past it. Returns false,
+    // leaving offset alone, if there is no whole, intact record there.
+    static bool nextRecord(const std::string &data, size_t &offset, LogRecord &record);
+    // Apply a record to a registry unless its graph's state already includes
+    // it (record LSN at or below the graph's lastLsn)
+    static void replay(GraphRegistry &registry, const LogRecord &record);
+
+    // A snapshot of every graph with the LSN of its last logged change, as a
+    // header body naming a log position and one body per graph. Checkpoints
+    // store one; replicas are seeded with one.
+    static std::vector<std::string> encodeSnapshot(GraphRegistry &registry, uint64_t position);
+    // the header's log position and graph count; throws protocol::ProtocolError
+    static uint64_t decodeSnapshotHeader(const char *data, size_t size, uint32_t &graphs);
+    // publish one graph body into the registry (creating the graph), returns its name
+    static std::string restoreSnapshotGraph(GraphRegistry &registry, const char *data, size_t size);
+
+private:
+    void syncerThread();
+    void checkpointThread();
+    void checkpoint();
+    void openSegment(uint64_t firstLsn);
+    // returns the first LSN of the segment the checkpoint was taken at (0 if none)
+    uint64_t loadCheckpoint(GraphRegistry &registry);
+    std::string path(const std::string &file) const;
+    void syncDirectory() const;
+
+    MutationLogOptions options_;
+    GraphRegistry *registry_ = nullptr;
+
+    // appends, the pending batch and rotation requests
+    std::mutex appendMutex_;
+    std::condition_variable appendCondition_;
+    std::string pending_;
+    uint64_t nextLsn_ = 1;
+    bool rotateRequested_ = false;
+    uint64_t rotatedAt_ = 0; // first LSN of the segment started for the last rotation request
+    std::condition_variable rotationCondition_;
+    bool stopping_ = false;
+    // first write or sync error; from then on nothing is appended or written
+    std::string failed_;
+    std::function<void(const std::string &, uint64_t)> listener_;
+
+    // durable position, for waiting committers
+    mutable std::mutex durableMutex_;
+    std::condition_variable durableCondition_;
+    uint64_t durableLsn_ = 0;
+    std::string error_;
+
+    // segment being written (owned by the syncer once started)
+    int fd_ = -1;
+    // first LSN of every segment, oldest first (under appendMutex_)
+    std::vector<uint64_t> segments_;
+    std::atomic<size_t> bytesSinceCheckpoint_{0};
+
+    // wakes the checkpoint thread
+    std::mutex checkpointMutex_;
+    std::condition_variable checkpointCondition_;
+    bool checkpointStopping_ = false;
+
+    std::thread syncer_;
+    std::thread checkpointer_;
+};
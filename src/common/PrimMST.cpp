@@ -1,4 +1,6 @@
 #include "PrimMST.hpp"
+#include "../utils/tracing.hpp"
+#include "../utils/arena.hpp"
 #include <queue>
 #include <unordered_set>
 #include <limits>
@@ -8,6 +10,7 @@ using namespace std;
 
 std::vector<Edge> PrimMST::findMST(const Graph &graph)
 {
+    TraceSpan span("prim");
     if (graph.getVertices() < 2)
     {
         throw std::runtime_error("Graph must have at least 2 vertices for MST");
@@ -15,13 +18,20 @@ std::vector<Edge> PrimMST::findMST(const Graph &graph)
 
     vector<Edge> mst;
     int n = graph.getVertices();
-    vector<bool> visited(n, false);
-    vector<int> key(n, numeric_limits<int>::max());
-    vector<int> parent(n, -1);
+    mst.reserve(n - 1);
 
-    priority_queue<pair<int, int>, vector<pair<int, int>>, greater<pair<int, int>>> pq;
+    // Working arrays live in this thread's scratch arena, reused across calls
+    ScratchScope scratch;
+    ArenaAllocator<int> arena(scratch.arena());
+    ScratchVector<char> visited(n, false, arena);
+    ScratchVector<int> key(n, numeric_limits<int>::max(), arena);
+    ScratchVector<int> parent(n, -1, arena);
 
-    int startVertex = 0;
+    using Entry = pair<int, int>;
+    priority_queue<Entry, ScratchVector<Entry>, greater<Entry>> pq{greater<Entry>(), ScratchVector<Entry>(arena)};
+
+    // Arrays are indexed by storage position (see Graph::forEachNeighborAt)
+    int startVertex = graph.indexOf(0);
     pq.push({0, startVertex});
     key[startVertex] = 0;
 
@@ -37,21 +47,17 @@ std::vector<Edge> PrimMST::findMST(const Graph &graph)
 
         if (parent[u] != -1)
         {
-            mst.push_back({parent[u], u, key[u]});
+            mst.push_back({graph.vertexAt(parent[u]), graph.vertexAt(u), key[u]});
         }
 
-        for (const auto &neighbor : graph.getAdjacentEdges(u))
-        {
-            int v = neighbor.destination;
-            int weight = neighbor.weight;
-
+        graph.forEachNeighborAt(u, [&](int v, int weight)
+                                {
             if (!visited[v] && weight < key[v])
             {
                 parent[v] = u;
                 key[v] = weight;
                 pq.push({key[v], v});
-            }
-        }
+            } });
     }
 
     return mst;
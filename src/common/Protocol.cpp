@@ -0,0 +1,217 @@
+#include "Protocol.hpp"
+#include <cstring>
+
+// This file implements encoding and decoding of binary protocol frames.
+
+namespace protocol
+{
+    const char *opcodeName(uint8_t opcode)
+    {
+        switch (opcode)
+        {
+        case BUILD_GRAPH:
+            return "build_graph";
+        case ADD_VERTEX:
+            return "add_vertex";
+        case ADD_EDGE:
+            return "add_edge";
+        case REMOVE_VERTEX:
+            return "remove_vertex";
+        case REMOVE_EDGE:
+            return "remove_edge";
+        case COMPUTE_MST:
+            return "compute_mst";
+        case QUERY_MST:
+            return "query_mst";
+        case PRINT_GRAPH:
+            return "print_graph";
+        case CREATE_GRAPH:
+            return "create_graph";
+        case SELECT_GRAPH:
+            return "select_graph";
+        case DROP_GRAPH:
+            return "drop_graph";
+        case LIST_GRAPHS:
+            return "list_graphs";
+        case SUBMIT_JOB:
+            return "submit_job";
+        case POLL_JOB:
+            return "poll_job";
+        case FETCH_JOB:
+            return "fetch_job";
+        case GENERATE_GRAPH:
+            return "generate_graph";
+        case CHANGE_WEIGHT:
+            return "change_weight";
+        case PING:
+            return "ping";
+        case STATS:
+            return "stats";
+        case LOCK_REPORT:
+            return "lock_report";
+        case EXPORT_TRACE:
+            return "export_trace";
+        case MEMORY_REPORT:
+            return "memory_report";
+        case COMPACT_GRAPH:
+            return "compact_graph";
+        case REORDER_GRAPH:
+            return "reorder_graph";
+        case REPLICATION_STATUS:
+            return "replication_status";
+        case PARTITION_GRAPH:
+            return "partition_graph";
+        case CLUSTER_MST:
+            return "cluster_mst";
+        case ATTACH_REGION:
+            return "attach_region";
+        case LOAD_EDGES:
+            return "load_edges";
+        case EXPORT_REGION:
+            return "export_region";
+        default:
+            return "unknown";
+        }
+    }
+
+    void PayloadWriter::u8(uint8_t value)
+    {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void PayloadWriter::u32(uint32_t value)
+    {
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            out_.push_back(static_cast<char>((value >> shift) & 0xFF));
+        }
+    }
+
+    void PayloadWriter::i32(int32_t value)
+    {
+        u32(static_cast<uint32_t>(value));
+    }
+
+    void PayloadWriter::u64(uint64_t value)
+    {
+        u32(static_cast<uint32_t>(value >> 32));
+        u32(static_cast<uint32_t>(value));
+    }
+
+    void PayloadWriter::i64(int64_t value)
+    {
+        u64(static_cast<uint64_t>(value));
+    }
+
+    void PayloadWriter::f64(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        u64(bits);
+    }
+
+    void PayloadWriter::str(const std::string &value)
+    {
+        u32(static_cast<uint32_t>(value.size()));
+        out_.append(value);
+    }
+
+    const char *PayloadReader::take(size_t count)
+    {
+        if (size_ - pos_ < count)
+        {
+            throw ProtocolError("Payload too short");
+        }
+        const char *start = data_ + pos_;
+        pos_ += count;
+        return start;
+    }
+
+    uint8_t PayloadReader::u8()
+    {
+        return static_cast<uint8_t>(*take(1));
+    }
+
+    uint32_t PayloadReader::u32()
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char *>(take(4));
+        return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+               (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+    }
+
+    int32_t PayloadReader::i32()
+    {
+        return static_cast<int32_t>(u32());
+    }
+
+    uint64_t PayloadReader::u64()
+    {
+        uint64_t high = u32();
+        return (high << 32) | u32();
+    }
+
+    int64_t PayloadReader::i64()
+    {
+        return static_cast<int64_t>(u64());
+    }
+
+    double PayloadReader::f64()
+    {
+        uint64_t bits = u64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string PayloadReader::str()
+    {
+        uint32_t length = u32();
+        const char *start = take(length);
+        return std::string(start, length);
+    }
+
+    void appendFrame(std::string &out, uint8_t opcode, uint16_t status, uint32_t requestId, const std::string &payload)
+    {
+        PayloadWriter writer(out);
+        writer.u8(FRAME_MAGIC);
+        writer.u8(opcode);
+        writer.u8(static_cast<uint8_t>(status >> 8));
+        writer.u8(static_cast<uint8_t>(status));
+        writer.u32(requestId);
+        writer.u32(static_cast<uint32_t>(payload.size()));
+        out.append(payload);
+    }
+
+    bool parseFrame(const std::string &buffer, size_t &offset, Frame &frame)
+    {
+        if (buffer.size() - offset < HEADER_SIZE)
+        {
+            return false;
+        }
+        PayloadReader header(buffer.data() + offset, HEADER_SIZE);
+        if (header.u8() != FRAME_MAGIC)
+        {
+            throw ProtocolError("Bad frame magic");
+        }
+        uint8_t opcode = header.u8();
+        uint16_t status = static_cast<uint16_t>(header.u8() << 8);
+        status |= header.u8();
+        uint32_t requestId = header.u32();
+        uint32_t length = header.u32();
+        if (length > MAX_PAYLOAD)
+        {
+            throw ProtocolError("Frame payload too large");
+        }
+        if (buffer.size() - offset - HEADER_SIZE < length)
+        {
+            return false;
+        }
+
+        frame.opcode = opcode;
+        frame.status = status;
+        frame.requestId = requestId;
+        frame.payload.assign(buffer, offset + HEADER_SIZE, length);
+        offset += HEADER_SIZE + length;
+        return true;
+    }
+}
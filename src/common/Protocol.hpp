@@ -0,0 +1,209 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Length-prefixed binary wire protocol, served on its own port next to the
+// interactive text protocol.
+//
+// Every request and response is a frame: a 12-byte header followed by the
+// payload. All integers are big-endian.
+//
+//   offset  size  field
+//   0       1     magic (FRAME_MAGIC)
+//   1       1     opcode (requests) / opcode echoed back (responses)
+//   2       2     status (0 in requests, see Status for responses)
+//   4       4     request ID, chosen by the client and echoed in the response
+//   8       4     payload length
+//
+// Clients may pipeline any number of requests without waiting; responses come
+// back in request order, tagged with the request's ID.
+namespace protocol
+{
+    const uint8_t FRAME_MAGIC = 0xB7;
+    const size_t HEADER_SIZE = 12;
+    const uint32_t MAX_PAYLOAD = 256u << 20;
+
+    enum class WireProtocol
+    {
+        Text,
+        Binary
+    };
+
+    enum Opcode : uint8_t
+    {
+        // payload: i32 V, i32 E, E x (i32 source, i32 destination, i32 weight)
+        BUILD_GRAPH = 1,
+        // response: i32 new vertex ID
+        ADD_VERTEX = 2,
+        // payload: one or more (i32 source, i32 destination, i32 weight); the
+        // edges of one frame are added all or none
+        ADD_EDGE = 3,
+        // payload: i32 vertex; response: u8 removed
+        REMOVE_VERTEX = 4,
+        // payload: i32 source, i32 destination; response: u8 removed
+        REMOVE_EDGE = 5,
+        // payload: str algorithm; response: i32 count, count x (i32 source, i32 destination, i32 weight)
+        COMPUTE_MST = 6,
+        // payload: str algorithm; response: i64 total, i64 longest, f64 average, i64 shortest
+        QUERY_MST = 7,
+        // response: str text dump, split over MORE frames and a final OK frame
+        PRINT_GRAPH = 8,
+        // payload: str name
+        CREATE_GRAPH = 10,
+        SELECT_GRAPH = 11,
+        DROP_GRAPH = 12,
+        // response: u32 count, count x str name
+        LIST_GRAPHS = 13,
+        // payload: str type ("mst"/"metrics"), str algorithm; response: u64 job ID
+        SUBMIT_JOB = 14,
+        // payload: u64 job ID; response: str state
+        POLL_JOB = 15,
+        // payload: u64 job ID; response: str state, str result
+        FETCH_JOB = 16,
+        // payload: str generator options ("kind=rmat vertices=N edges=N seed=S ...",
+        // see GeneratorSpec); response: i32 vertices, i64 edges
+        GENERATE_GRAPH = 17,
+        // payload: i32 source, i32 destination, i32 weight; response: u8 changed
+        CHANGE_WEIGHT = 20,
+        // empty request and response, for latency probes
+        PING = 30,
+        // response: str report (counters, gauges and latency percentiles)
+        STATS = 31,
+        // response: str lock contention report, ranked by wait time (see lockprofiler.hpp)
+        LOCK_REPORT = 32,
+        // response: str Chrome trace-event JSON of the recorded spans (empty
+        // trace unless the server runs with --trace-events N)
+        EXPORT_TRACE = 33,
+        // response: str bytes of the selected graph by structure (see GraphMemory)
+        MEMORY_REPORT = 34,
+        // repack the selected graph (Graph::compact); payload: optional str
+        // storage ("packed" by default, "compressed" or "lists");
+        // response: u64 bytes before, u64 bytes after
+        COMPACT_GRAPH = 35,
+        // renumber the selected graph internally (Graph::reorder); payload: str
+        // order ("bfs", "rcm" or "degree"); response: f64 average neighbor
+        // distance before, f64 after
+        REORDER_GRAPH = 36,
+        // response: str replication role and position (standalone, primary or
+        // replica with its applied LSN and lag)
+        REPLICATION_STATUS = 37,
+        // cluster coordinator only (see cluster.hpp): split the selected graph
+        // across the shards; response: u32 shards, i64 shard edges, i64 cut edges
+        PARTITION_GRAPH = 38,
+        // MST of the selected graph from its shards, the same as COMPUTE_MST
+        // "kruskal"; response: i32 count, count x (i32 source, i32 destination, i32 weight)
+        CLUSTER_MST = 39,
+
+        // Shared-memory bulk transfer, Unix domain socket only (see SharedRegion).
+        // Edge data in a region is an array of EdgeRecord in host byte order.
+        //
+        // request carries a memfd (SCM_RIGHTS) sealed with F_SEAL_SHRINK;
+        // payload: u64 size; response: u32 region ID.
+        // The region stays mapped for the rest of the session.
+        ATTACH_REGION = 40,
+        // payload: u32 region ID, u64 offset, u32 count, i32 vertices.
+        // Adds count edges read from the region at offset. vertices >= 0 first
+        // replaces the graph with that many isolated vertices; -1 appends.
+        // Once answered, the client may reuse that part of the region (ring).
+        LOAD_EDGES = 41,
+        // response carries a memfd holding a RegionHeader followed by
+        // RegionHeader::edges EdgeRecords; payload: u64 size
+        EXPORT_REGION = 42
+    };
+
+    // One edge in a shared region
+    struct EdgeRecord
+    {
+        int32_t source;
+        int32_t destination;
+        int32_t weight;
+    };
+
+    // Start of an exported region
+    struct RegionHeader
+    {
+        uint32_t magic; // REGION_MAGIC
+        int32_t vertices;
+        int64_t edges;
+    };
+    const uint32_t REGION_MAGIC = 0x47524150; // "GRAP"
+
+    enum Status : uint16_t
+    {
+        OK = 0,
+        // payload: str message
+        ERROR = 1,
+        // payload: u32 retry after (ms)
+        BUSY = 2,
+        // part of a streamed response; more frames with the same request ID
+        // follow, the last one with OK (or ERROR if the command failed)
+        MORE = 3
+    };
+
+    struct Frame
+    {
+        uint8_t opcode = 0;
+        uint16_t status = 0;
+        uint32_t requestId = 0;
+        std::string payload;
+    };
+
+    // Thrown for malformed frames or payloads
+    class ProtocolError : public std::runtime_error
+    {
+    public:
+        explicit ProtocolError(const std::string &message) : std::runtime_error(message) {}
+    };
+
+    // Appends big-endian values to a payload
+    class PayloadWriter
+    {
+    public:
+        explicit PayloadWriter(std::string &out) : out_(out) {}
+        void u8(uint8_t value);
+        void u32(uint32_t value);
+        void i32(int32_t value);
+        void u64(uint64_t value);
+        void i64(int64_t value);
+        void f64(double value);
+        void str(const std::string &value);
+
+    private:
+        std::string &out_;
+    };
+
+    // Reads big-endian values from a payload, throwing ProtocolError past the end
+    class PayloadReader
+    {
+    public:
+        PayloadReader(const char *data, size_t size) : data_(data), size_(size), pos_(0) {}
+        explicit PayloadReader(const std::string &payload) : PayloadReader(payload.data(), payload.size()) {}
+        uint8_t u8();
+        uint32_t u32();
+        int32_t i32();
+        uint64_t u64();
+        int64_t i64();
+        double f64();
+        std::string str();
+        size_t remaining() const { return size_ - pos_; }
+
+    private:
+        const char *take(size_t count);
+
+        const char *data_;
+        size_t size_;
+        size_t pos_;
+    };
+
+    // lowercase name of an opcode, e.g. "compute_mst" ("unknown" if it has none)
+    const char *opcodeName(uint8_t opcode);
+
+    // Append a complete frame (header and payload) to out
+    void appendFrame(std::string &out, uint8_t opcode, uint16_t status, uint32_t requestId, const std::string &payload);
+
+    // Parse one frame starting at offset; returns false if the buffer does not
+    // hold a complete frame yet, throws ProtocolError on a malformed header
+    bool parseFrame(const std::string &buffer, size_t &offset, Frame &frame);
+}
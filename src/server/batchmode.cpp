@@ -0,0 +1,310 @@
+// This file implements the scripted batch mode of ServerClient.
+//
+// After `batch` the client sends one command per line, for example
+// `add_edge 3 7 12`, and ends the block with `end`. Each command gets exactly
+// one reply line and no menu or prompt text is sent:
+//   ok [value]                   success, with the command's result if it has one
+//   error <message>              the command failed and changed nothing
+//   busy retry_after_ms=<N>      the graph's write lock was not free in time,
+//                                or max_active_jobs are pending or running
+// The block is closed by `end <number of commands>`. Consecutive mutations
+// are applied as one write transaction, so ingesting a script costs one lock
+// acquisition and one published snapshot per run of edits. A run is cut after
+// MAX_BATCH_RUN commands, and replies are sent while the block is still being
+// read, so a block of any length uses bounded memory.
+
+#include "server.hpp"
+#include "../common/MSTMetrics.hpp"
+#include <sstream>
+
+// Split a command line into words
+static std::vector<std::string> splitWords(const std::string &line)
+{
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while (pos < line.size())
+    {
+        size_t start = line.find_first_not_of(" \t", pos);
+        if (start == std::string::npos)
+        {
+            break;
+        }
+        size_t stop = line.find_first_of(" \t", start);
+        if (stop == std::string::npos)
+        {
+            stop = line.size();
+        }
+        words.push_back(line.substr(start, stop - start));
+        pos = stop;
+    }
+    return words;
+}
+
+// Parse the idx-th argument of a command as an integer
+static int intArg(const std::vector<std::string> &args, size_t idx)
+{
+    if (idx >= args.size())
+    {
+        throw std::invalid_argument(args[0] + ": missing argument " + std::to_string(idx));
+    }
+    size_t used = 0;
+    int value = 0;
+    try
+    {
+        value = std::stoi(args[idx], &used);
+    }
+    catch (const std::logic_error &)
+    {
+    }
+    if (used == 0 || used != args[idx].size())
+    {
+        throw std::invalid_argument(args[0] + ": bad number '" + args[idx] + "'");
+    }
+    return value;
+}
+
+// Translate a mutating command into mutations; returns false if it is not one.
+// build_graph may ask for at most maxVertices vertices.
+static bool parseMutation(const std::vector<std::string> &args, std::vector<GraphMutation> &mutations, int maxVertices)
+{
+    const std::string &name = args[0];
+    if (name == "build_graph")
+    {
+        int vertices = intArg(args, 1);
+        if (vertices < 0)
+        {
+            throw std::invalid_argument("build_graph: negative vertex count");
+        }
+        if (vertices > maxVertices)
+        {
+            throw std::invalid_argument("build_graph: vertex count " + std::to_string(vertices) +
+                                        " is above max_vertices (" + std::to_string(maxVertices) + ")");
+        }
+        mutations.push_back(GraphMutation::clear());
+        mutations.insert(mutations.end(), vertices, GraphMutation::addVertex());
+    }
+    else if (name == "add_vertex")
+    {
+        mutations.push_back(GraphMutation::addVertex());
+    }
+    else if (name == "add_edge")
+    {
+        mutations.push_back(GraphMutation::addEdge(intArg(args, 1), intArg(args, 2), intArg(args, 3)));
+    }
+    else if (name == "remove_vertex")
+    {
+        mutations.push_back(GraphMutation::removeVertex(intArg(args, 1)));
+    }
+    else if (name == "remove_edge")
+    {
+        mutations.push_back(GraphMutation::removeEdge(intArg(args, 1), intArg(args, 2)));
+    }
+    else if (name == "change_weight")
+    {
+        mutations.push_back(GraphMutation::changeWeight(intArg(args, 1), intArg(args, 2), intArg(args, 3)));
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Reply line of a mutating command that succeeded
+static std::string mutationReply(const std::string &name, int value)
+{
+    if (name == "add_vertex" || name == "remove_vertex" || name == "remove_edge" || name == "change_weight")
+    {
+        return "ok " + std::to_string(value);
+    }
+    return "ok";
+}
+
+// Read a block of commands up to `end` and answer each with one line.
+// The block is never held in memory: a run of mutations is applied once it
+// reaches MAX_BATCH_RUN commands, when a non-mutation arrives, or when no
+// further line has been received yet, and the replies go out as they are made.
+void ServerClient::handleBatch()
+{
+    const int maxVertices = threadPool.getConfig().maxVertices;
+    size_t count = 0;
+    std::vector<std::string> names;
+    std::vector<std::vector<GraphMutation>> groups;
+    std::vector<std::string> parseErrors;
+
+    // Apply the pending run as one write transaction and queue its replies
+    auto applyRun = [&]()
+    {
+        if (groups.empty())
+        {
+            return;
+        }
+        std::vector<MutationResult> results;
+        bool applied = applyMutationRun(groups, results);
+        std::string out;
+        for (size_t j = 0; j < groups.size(); ++j)
+        {
+            if (!applied)
+            {
+                out += "busy retry_after_ms=" + std::to_string(threadPool.getConfig().retryAfterMs) + "\n";
+                continue;
+            }
+            const std::string &error = parseErrors[j].empty() ? results[j].error : parseErrors[j];
+            out += error.empty() ? mutationReply(names[j], results[j].value) : "error " + error;
+            out += "\n";
+        }
+        sendResponse(std::move(out));
+        names.clear();
+        groups.clear();
+        parseErrors.clear();
+    };
+
+    while (connected_)
+    {
+        // Answer what we have before waiting for the client, who may be
+        // waiting for these replies before sending more
+        if (!hasBufferedLine())
+        {
+            applyRun();
+        }
+        std::string line = receiveChoice();
+        if (!connected_)
+        {
+            return;
+        }
+        std::vector<std::string> words = splitWords(line);
+        if (words.empty() || words[0][0] == '#')
+        {
+            continue;
+        }
+        if (words[0] == "end")
+        {
+            break;
+        }
+        ++count;
+
+        std::vector<GraphMutation> mutations;
+        std::string parseError;
+        bool mutation = true;
+        try
+        {
+            mutation = parseMutation(words, mutations, maxVertices);
+        }
+        catch (const std::exception &e)
+        {
+            parseError = e.what();
+        }
+        if (!mutation)
+        {
+            applyRun();
+            sendResponse(runBatchCommand(words) + "\n");
+        }
+        else
+        {
+            names.push_back(words[0]);
+            groups.push_back(std::move(mutations));
+            parseErrors.push_back(std::move(parseError));
+            if (groups.size() >= MAX_BATCH_RUN)
+            {
+                applyRun();
+            }
+        }
+        // A client that sends a long block before reading gets its replies
+        // in chunks rather than all at the end
+        if (output.size() >= STREAM_CHUNK_SIZE && !output.flush(socket_, true))
+        {
+            connected_ = false;
+        }
+    }
+    applyRun();
+    sendResponse("end " + std::to_string(count) + "\n");
+}
+
+// Run one non-mutating batch command and return its reply line
+std::string ServerClient::runBatchCommand(const std::vector<std::string> &args)
+{
+    const std::string &name = args[0];
+    try
+    {
+        checkWritable(name);
+        if ((name == "compute_mst" || name == "query_mst") && args.size() == 2)
+        {
+            std::string algorithm = args[1];
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            std::shared_ptr<GraphStore> store = graph_;
+            bool metrics = name == "query_mst";
+            return runScheduled(metrics ? "metrics" : "mst", *graph, [store, graph, algorithm, metrics]()
+                                {
+                std::shared_ptr<const std::vector<Edge>> mstEdges = store->findMST(graph, algorithm);
+                std::ostringstream reply;
+                reply << "ok total=" << MSTMetrics::getTotalWeight(*mstEdges);
+                if (metrics)
+                {
+                    reply << " longest=" << MSTMetrics::getLongestDistance(*graph, *mstEdges)
+                          << " average=" << MSTMetrics::getAverageDistance(*graph, *mstEdges)
+                          << " shortest=" << MSTMetrics::getShortestDistance(*mstEdges);
+                }
+                else
+                {
+                    reply << " edges=";
+                    for (size_t k = 0; k < mstEdges->size(); ++k)
+                    {
+                        const Edge &edge = (*mstEdges)[k];
+                        reply << (k ? "," : "") << edge.source << "-" << edge.destination << ":" << edge.weight;
+                    }
+                }
+                return reply.str(); });
+        }
+        else if (name == "graph_info" && args.size() == 1)
+        {
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            return "ok name=" + graph_->name() + " vertices=" + std::to_string(graph->getVertices()) +
+                   " edges=" + std::to_string(graph->getEdges()) + " version=" + std::to_string(graph->getVersion());
+        }
+        else if ((name == "create_graph" || name == "select_graph") && args.size() == 2)
+        {
+            auto store = name == "create_graph" ? threadPool.getGraphs().create(args[1]) : threadPool.getGraphs().find(args[1]);
+            if (!store)
+            {
+                return "error " + name + ": cannot use graph '" + args[1] + "'";
+            }
+            graph_ = store;
+            return "ok";
+        }
+        else if (name == "submit_job" && args.size() == 3)
+        {
+            std::string description;
+            return "ok " + std::to_string(submitJob(args[1], args[2], description));
+        }
+        else if (name == "generate_graph")
+        {
+            std::string options;
+            for (size_t k = 1; k < args.size(); ++k)
+            {
+                options += args[k] + " ";
+            }
+            GeneratorSpec spec = GeneratorSpec::parse(options);
+            long long edges = generateGraph(spec);
+            return "ok vertices=" + std::to_string(spec.vertices) + " edges=" + std::to_string(edges);
+        }
+        else if (name == "poll_job" && args.size() == 2)
+        {
+            std::string description;
+            return "ok " + JobManager::stateName(threadPool.getJobs().poll(std::stoull(args[1]), description));
+        }
+        return "error unknown batch command: " + name;
+    }
+    catch (const GraphBusyError &)
+    {
+        threadPool.getAdmissionStats().commandsRejected.fetch_add(1, std::memory_order_relaxed);
+        return "busy retry_after_ms=" + std::to_string(threadPool.getConfig().retryAfterMs);
+    }
+    catch (const JobsFullError &)
+    {
+        return "busy retry_after_ms=" + std::to_string(threadPool.getConfig().retryAfterMs);
+    }
+    catch (const std::exception &e)
+    {
+        return std::string("error ") + e.what();
+    }
+}
@@ -0,0 +1,600 @@
+// This file implements the binary wire protocol side of ServerClient (see Protocol.hpp).
+
+#include "server.hpp"
+#include "../common/MSTFactory.hpp"
+#include "../common/MSTMetrics.hpp"
+#include "../utils/arena.hpp"
+#include <sys/socket.h>
+#include <cstring>
+#include <sstream>
+
+using namespace protocol;
+
+// Whether an opcode mutates the selected graph
+static bool isMutation(uint8_t opcode)
+{
+    return opcode == BUILD_GRAPH || opcode == ADD_VERTEX || opcode == ADD_EDGE ||
+           opcode == REMOVE_VERTEX || opcode == REMOVE_EDGE || opcode == CHANGE_WEIGHT || opcode == LOAD_EDGES;
+}
+
+// Decode a mutation frame into the mutations it stands for. Multi-edge frames
+// are checked as a whole when applied (GraphMutation::checkGroup).
+std::vector<GraphMutation> ServerClient::decodeMutations(const Frame &frame) const
+{
+    PayloadReader reader(frame.payload);
+    std::vector<GraphMutation> mutations;
+    switch (frame.opcode)
+    {
+    case BUILD_GRAPH:
+    {
+        int32_t vertices = reader.i32();
+        int32_t edges = reader.i32();
+        if (vertices < 0 || edges < 0 || reader.remaining() != static_cast<size_t>(edges) * 12)
+        {
+            throw ProtocolError("Malformed build_graph payload");
+        }
+        checkVertexCount(vertices);
+        mutations.reserve(1 + vertices + edges);
+        mutations.push_back(GraphMutation::clear());
+        for (int32_t i = 0; i < vertices; ++i)
+        {
+            mutations.push_back(GraphMutation::addVertex());
+        }
+        for (int32_t i = 0; i < edges; ++i)
+        {
+            int32_t source = reader.i32();
+            int32_t destination = reader.i32();
+            mutations.push_back(GraphMutation::addEdge(source, destination, reader.i32()));
+        }
+        break;
+    }
+    case ADD_VERTEX:
+        mutations.push_back(GraphMutation::addVertex());
+        break;
+    case ADD_EDGE:
+    {
+        if (reader.remaining() == 0 || reader.remaining() % 12 != 0)
+        {
+            throw ProtocolError("Malformed add_edge payload");
+        }
+        mutations.reserve(reader.remaining() / 12);
+        while (reader.remaining() > 0)
+        {
+            int32_t source = reader.i32();
+            int32_t destination = reader.i32();
+            mutations.push_back(GraphMutation::addEdge(source, destination, reader.i32()));
+        }
+        break;
+    }
+    case REMOVE_VERTEX:
+        mutations.push_back(GraphMutation::removeVertex(reader.i32()));
+        break;
+    case REMOVE_EDGE:
+    {
+        int32_t source = reader.i32();
+        mutations.push_back(GraphMutation::removeEdge(source, reader.i32()));
+        break;
+    }
+    case CHANGE_WEIGHT:
+    {
+        int32_t source = reader.i32();
+        int32_t destination = reader.i32();
+        mutations.push_back(GraphMutation::changeWeight(source, destination, reader.i32()));
+        break;
+    }
+    case LOAD_EDGES:
+    {
+        uint32_t id = reader.u32();
+        uint64_t offset = reader.u64();
+        uint32_t count = reader.u32();
+        int32_t vertices = reader.i32();
+        if (id >= regions.size())
+        {
+            throw std::invalid_argument("Unknown region " + std::to_string(id));
+        }
+        const SharedRegion &region = regions[id];
+        if (offset > region.size() || count > (region.size() - offset) / sizeof(EdgeRecord))
+        {
+            throw std::out_of_range("Edge range exceeds region " + std::to_string(id));
+        }
+
+        if (vertices >= 0)
+        {
+            checkVertexCount(vertices);
+        }
+
+        const char *records = region.data() + offset;
+        mutations.reserve(count + (vertices >= 0 ? 1 + vertices : 0));
+        if (vertices >= 0)
+        {
+            mutations.push_back(GraphMutation::clear());
+            mutations.insert(mutations.end(), vertices, GraphMutation::addVertex());
+        }
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            EdgeRecord edge;
+            std::memcpy(&edge, records + i * sizeof(EdgeRecord), sizeof(EdgeRecord));
+            mutations.push_back(GraphMutation::addEdge(edge.source, edge.destination, edge.weight));
+        }
+        break;
+    }
+    }
+    return mutations;
+}
+
+// Series of a binary opcode; registered once, then read without locking
+static const CommandSeries &frameSeries(uint8_t opcode)
+{
+    static const std::vector<CommandSeries> table = []()
+    {
+        std::vector<CommandSeries> series;
+        for (int code = 0; code < 256; ++code)
+        {
+            series.push_back(commandSeries("binary", opcodeName(static_cast<uint8_t>(code))));
+        }
+        return series;
+    }();
+    return table[opcode];
+}
+
+// Append an ERROR response carrying the message
+static void appendError(std::string &out, const Frame &frame, const std::string &message)
+{
+    std::string payload;
+    PayloadWriter(payload).str(message);
+    appendFrame(out, frame.opcode, ERROR, frame.requestId, payload);
+}
+
+// Serve a binary protocol connection: read whatever arrived, answer every
+// complete frame in it, and send all the answers back with one write
+void ServerClient::serveBinary()
+{
+    while (connected_ && fillInput())
+    {
+        std::vector<Frame> frames;
+        size_t offset = 0;
+        bool malformed = false;
+        std::string error;
+        try
+        {
+            Frame frame;
+            while (parseFrame(inputBuffer, offset, frame))
+            {
+                frames.push_back(std::move(frame));
+            }
+        }
+        catch (const ProtocolError &e)
+        {
+            // The stream can not be resynchronized after a bad header
+            malformed = true;
+            Frame bad;
+            appendError(error, bad, e.what());
+        }
+        inputBuffer.erase(0, offset);
+
+        processFrames(frames, frameOutput);
+        frameOutput += error;
+        output.append(std::move(frameOutput));
+        frameOutput.clear();
+        if (!flushOutput() || malformed)
+        {
+            connected_ = false;
+        }
+    }
+}
+
+// Answer frames in order. Runs of consecutive mutations share one write
+// transaction, so a pipelined burst of edits takes the graph's lock and
+// publishes a snapshot once instead of once per frame.
+void ServerClient::processFrames(std::vector<Frame> &frames, std::string &out)
+{
+    auto it = frames.begin();
+    while (it != frames.end())
+    {
+        if (isMutation(it->opcode))
+        {
+            auto end = it;
+            while (end != frames.end() && isMutation(end->opcode))
+            {
+                ++end;
+            }
+            applyMutationFrames(it, end, out);
+            it = end;
+        }
+        else
+        {
+            handleFrame(*it, out);
+            ++it;
+        }
+    }
+}
+
+// Apply a run of mutation frames as one write transaction; a frame that fails
+// is answered with ERROR and leaves the graph as it was, the others still apply
+void ServerClient::applyMutationFrames(std::vector<Frame>::iterator begin, std::vector<Frame>::iterator end, std::string &out)
+{
+    // The run is timed as a whole: its frames share one transaction
+    static const CommandSeries series = commandSeries("binary", "mutation_run");
+    Metrics::Timer timer(series.duration);
+    TraceSpan span(series.name, "binary");
+    std::vector<std::vector<GraphMutation>> groups;
+    std::vector<std::string> decodeErrors;
+    for (auto it = begin; it != end; ++it)
+    {
+        try
+        {
+            groups.push_back(decodeMutations(*it));
+            decodeErrors.emplace_back();
+        }
+        catch (const std::exception &e)
+        {
+            groups.emplace_back();
+            decodeErrors.push_back(e.what());
+        }
+    }
+
+    std::vector<MutationResult> results;
+    if (!applyMutationRun(groups, results))
+    {
+        std::string payload;
+        PayloadWriter(payload).u32(threadPool.getConfig().retryAfterMs);
+        for (auto it = begin; it != end; ++it)
+        {
+            appendFrame(out, it->opcode, BUSY, it->requestId, payload);
+        }
+        return;
+    }
+
+    size_t i = 0;
+    for (auto it = begin; it != end; ++it, ++i)
+    {
+        const std::string &error = decodeErrors[i].empty() ? results[i].error : decodeErrors[i];
+        if (!error.empty())
+        {
+            Metrics::global().add(series.errors);
+            appendError(out, *it, error);
+            continue;
+        }
+        std::string payload;
+        PayloadWriter response(payload);
+        if (it->opcode == ADD_VERTEX)
+        {
+            response.i32(results[i].value);
+        }
+        else if (it->opcode == REMOVE_VERTEX || it->opcode == REMOVE_EDGE || it->opcode == CHANGE_WEIGHT)
+        {
+            response.u8(results[i].value != 0);
+        }
+        appendFrame(out, it->opcode, OK, it->requestId, payload);
+    }
+}
+
+// Answer a single non-mutating frame
+void ServerClient::handleFrame(const Frame &frame, std::string &out)
+{
+    const CommandSeries &series = frameSeries(frame.opcode);
+    Metrics::Timer timer(series.duration);
+    TraceSpan span(series.name, "binary");
+    ScratchScope scratch; // scratch memory of the command, released when it ends
+    std::string payload;
+    PayloadWriter response(payload);
+    try
+    {
+        checkWritable(series.name);
+        PayloadReader request(frame.payload);
+        switch (frame.opcode)
+        {
+        case COMPUTE_MST:
+        {
+            std::string algorithm = request.str();
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            std::shared_ptr<GraphStore> store = graph_;
+            payload = runScheduled("mst", *graph, [store, graph, algorithm]()
+                                   {
+                std::shared_ptr<const std::vector<Edge>> mstEdges = store->findMST(graph, algorithm);
+                std::string encoded;
+                PayloadWriter writer(encoded);
+                writer.i32(static_cast<int32_t>(mstEdges->size()));
+                for (const Edge &edge : *mstEdges)
+                {
+                    writer.i32(edge.source);
+                    writer.i32(edge.destination);
+                    writer.i32(edge.weight);
+                }
+                return encoded; });
+            break;
+        }
+        case QUERY_MST:
+        {
+            std::string algorithm = request.str();
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            std::shared_ptr<GraphStore> store = graph_;
+            payload = runScheduled("metrics", *graph, [store, graph, algorithm]()
+                                   {
+                std::shared_ptr<const std::vector<Edge>> mstEdges = store->findMST(graph, algorithm);
+                std::string encoded;
+                PayloadWriter writer(encoded);
+                writer.i64(MSTMetrics::getTotalWeight(*mstEdges));
+                writer.i64(MSTMetrics::getLongestDistance(*graph, *mstEdges));
+                writer.f64(MSTMetrics::getAverageDistance(*graph, *mstEdges));
+                writer.i64(MSTMetrics::getShortestDistance(*mstEdges));
+                return encoded; });
+            break;
+        }
+        case PRINT_GRAPH:
+            streamGraph(frame, out);
+            return;
+        case CREATE_GRAPH:
+        {
+            std::string name = request.str();
+            auto store = threadPool.getGraphs().create(name);
+            if (!store)
+            {
+                throw std::invalid_argument("Graph '" + name + "' already exists");
+            }
+            graph_ = store;
+            break;
+        }
+        case SELECT_GRAPH:
+        {
+            std::string name = request.str();
+            auto store = threadPool.getGraphs().find(name);
+            if (!store)
+            {
+                throw std::invalid_argument("Graph '" + name + "' does not exist");
+            }
+            graph_ = store;
+            break;
+        }
+        case DROP_GRAPH:
+        {
+            std::string name = request.str();
+            if (!threadPool.getGraphs().drop(name))
+            {
+                throw std::invalid_argument("Failed to drop graph '" + name + "'");
+            }
+            if (graph_->name() == name)
+            {
+                graph_ = threadPool.getGraphs().find(GraphRegistry::DEFAULT_GRAPH);
+            }
+            break;
+        }
+        case LIST_GRAPHS:
+        {
+            std::vector<std::string> names = threadPool.getGraphs().list();
+            response.u32(static_cast<uint32_t>(names.size()));
+            for (const std::string &name : names)
+            {
+                response.str(name);
+            }
+            break;
+        }
+        case SUBMIT_JOB:
+        {
+            std::string type = request.str();
+            std::string algorithm = request.str();
+            std::string description;
+            response.u64(submitJob(type, algorithm, description));
+            break;
+        }
+        case POLL_JOB:
+        {
+            std::string description;
+            response.str(JobManager::stateName(threadPool.getJobs().poll(request.u64(), description)));
+            break;
+        }
+        case FETCH_JOB:
+        {
+            std::string result;
+            JobManager::State state = threadPool.getJobs().fetch(request.u64(), result);
+            response.str(JobManager::stateName(state));
+            response.str(result);
+            break;
+        }
+        case GENERATE_GRAPH:
+        {
+            GeneratorSpec spec = GeneratorSpec::parse(request.str());
+            int64_t edges = generateGraph(spec);
+            response.i32(spec.vertices);
+            response.i64(edges);
+            break;
+        }
+        case PING:
+            break;
+        case STATS:
+            response.str(Metrics::global().renderText(threadPool.gauges()));
+            break;
+        case LOCK_REPORT:
+            response.str(lockprofiler::report());
+            break;
+        case MEMORY_REPORT:
+            response.str(memoryReport());
+            break;
+        case REPLICATION_STATUS:
+            response.str(threadPool.replicationStatus());
+            break;
+        case PARTITION_GRAPH:
+        {
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            ClusterCoordinator::PartitionStats stats = clusterCoordinator().partition(graph_->name(), graph, commandDeadline());
+            response.u32(static_cast<uint32_t>(stats.shards));
+            response.i64(stats.shardEdges);
+            response.i64(stats.cutEdges);
+            break;
+        }
+        case CLUSTER_MST:
+        {
+            std::shared_ptr<const Graph> graph = graph_->snapshot();
+            ClusterCoordinator::MSTResult result = clusterCoordinator().computeMST(graph_->name(), graph, commandDeadline());
+            response.i32(static_cast<int32_t>(result.edges.size()));
+            for (const Edge &edge : result.edges)
+            {
+                response.i32(edge.source);
+                response.i32(edge.destination);
+                response.i32(edge.weight);
+            }
+            break;
+        }
+        case COMPACT_GRAPH:
+        {
+            std::string storage = request.remaining() > 0 ? request.str() : "packed";
+            std::pair<size_t, size_t> bytes = compactGraph(Graph::parseStorage(storage));
+            response.u64(bytes.first);
+            response.u64(bytes.second);
+            break;
+        }
+        case REORDER_GRAPH:
+        {
+            std::pair<double, double> distance = reorderGraph(Graph::parseOrder(request.str()));
+            response.f64(distance.first);
+            response.f64(distance.second);
+            break;
+        }
+        case EXPORT_TRACE:
+        {
+            std::ostringstream json;
+            tracing::writeJson(json);
+            response.str(json.str());
+            break;
+        }
+        case ATTACH_REGION:
+            response.u32(attachRegion(request.u64()));
+            break;
+        case EXPORT_REGION:
+            exportRegion(frame, out);
+            return;
+        default:
+            throw ProtocolError("Unknown opcode " + std::to_string(frame.opcode));
+        }
+    }
+    catch (const GraphBusyError &)
+    {
+        threadPool.getAdmissionStats().commandsRejected.fetch_add(1, std::memory_order_relaxed);
+        std::string busy;
+        PayloadWriter(busy).u32(threadPool.getConfig().retryAfterMs);
+        appendFrame(out, frame.opcode, BUSY, frame.requestId, busy);
+        return;
+    }
+    catch (const JobsFullError &)
+    {
+        std::string busy;
+        PayloadWriter(busy).u32(threadPool.getConfig().retryAfterMs);
+        appendFrame(out, frame.opcode, BUSY, frame.requestId, busy);
+        return;
+    }
+    catch (const std::exception &e)
+    {
+        Metrics::global().add(series.errors);
+        appendError(out, frame, e.what());
+        return;
+    }
+    appendFrame(out, frame.opcode, OK, frame.requestId, payload);
+}
+
+// Send the text dump of the current snapshot as a series of MORE frames and a
+// final OK frame, each carrying the next piece. Every piece is flushed before
+// the next is formatted, so memory stays bounded by STREAM_CHUNK_SIZE however
+// large the graph. Earlier responses are sent first to keep the order.
+void ServerClient::streamGraph(const Frame &frame, std::string &out)
+{
+    GraphSerializer dump(graph_->snapshot(), DumpFormat::Text);
+    output.append(std::move(out));
+    out.clear();
+    bool more = true;
+    while (more && connected_)
+    {
+        std::string text;
+        more = dump.next(text, STREAM_CHUNK_SIZE);
+        std::string payload;
+        PayloadWriter(payload).str(text);
+        std::string response;
+        appendFrame(response, frame.opcode, more ? MORE : OK, frame.requestId, payload);
+        output.append(std::move(response));
+        if (more && output.size() >= STREAM_CHUNK_SIZE)
+        {
+            TraceSpan span("send_response", "chunk");
+            if (!output.flush(socket_, true))
+            {
+                connected_ = false;
+            }
+        }
+    }
+}
+
+// Descriptors can only be passed over Unix domain sockets
+static void requireUnixSocket(int socket)
+{
+    sockaddr_storage address;
+    socklen_t length = sizeof(address);
+    if (getsockname(socket, reinterpret_cast<sockaddr *>(&address), &length) != 0 || address.ss_family != AF_UNIX)
+    {
+        throw std::invalid_argument("Shared regions need the Unix domain socket");
+    }
+}
+
+// Map the next descriptor the client sent; returns the new region's ID
+uint32_t ServerClient::attachRegion(uint64_t size)
+{
+    requireUnixSocket(socket_);
+    if (receivedFds.empty())
+    {
+        throw std::invalid_argument("No descriptor was sent with attach_region");
+    }
+    int fd = receivedFds.front();
+    receivedFds.erase(receivedFds.begin());
+    regions.push_back(SharedRegion::map(fd, size));
+    return static_cast<uint32_t>(regions.size() - 1);
+}
+
+// Write the current snapshot's edges into a new shared region and send its
+// descriptor with the response. Earlier responses are sent first, so the
+// descriptor arrives with its own frame.
+void ServerClient::exportRegion(const Frame &frame, std::string &out)
+{
+    requireUnixSocket(socket_);
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    int64_t edges = graph->getEdges();
+    size_t size = sizeof(RegionHeader) + edges * sizeof(EdgeRecord);
+    SharedRegion region = SharedRegion::create("graph-export", size);
+
+    RegionHeader header = {REGION_MAGIC, graph->getVertices(), edges};
+    std::memcpy(region.data(), &header, sizeof(header));
+    char *records = region.data() + sizeof(header);
+    int64_t written = 0;
+    for (int vertex = 0; vertex < graph->getVertices(); ++vertex)
+    {
+        bool loopOpen = false; // a self-loop is stored twice in its own list, export it once
+        graph->forEachNeighbor(vertex, [&](int destination, int weight)
+                               {
+            if (destination < vertex)
+            {
+                return;
+            }
+            if (destination == vertex)
+            {
+                loopOpen = !loopOpen;
+                if (!loopOpen)
+                {
+                    return;
+                }
+            }
+            EdgeRecord record = {vertex, destination, weight};
+            std::memcpy(records + written * sizeof(EdgeRecord), &record, sizeof(record));
+            ++written; });
+    }
+
+    output.append(std::move(out));
+    out.clear();
+    if (!flushOutput())
+    {
+        return;
+    }
+    std::string payload;
+    PayloadWriter(payload).u64(size);
+    std::string response;
+    appendFrame(response, frame.opcode, OK, frame.requestId, payload);
+    if (!sendWithFds(socket_, response.data(), response.size(), {region.fd()}))
+    {
+        connected_ = false;
+    }
+}
@@ -5,29 +5,48 @@
 #include "../utils/threadpool.hpp"
 #include "../common/MSTFactory.hpp"
 #include "../common/MSTMetrics.hpp"
+#include "../common/GraphSerializer.hpp"
+#include "../utils/arena.hpp"
 #include <iostream>
 #include <cstring>
 #include <sstream>
 #include <iomanip>
 #include <atomic>
 #include <thread>
+#include <future>
 
 // Global flag to control server running state
 std::atomic<bool> running(true);
 
 // ServerClient class implementation
-ServerClient::ServerClient(int socket, std::shared_ptr<Graph> graph, ThreadPool &pool)
-    : Client(socket, graph), threadPool(pool) {}
+ServerClient::ServerClient(int socket, std::shared_ptr<GraphStore> graph, ThreadPool &pool,
+                           protocol::WireProtocol wireProtocol)
+    : Client(socket, graph), threadPool(pool), wireProtocol(wireProtocol) {}
+
+// Close descriptors the client sent but never attached
+ServerClient::~ServerClient()
+{
+    for (int fd : receivedFds)
+    {
+        close(fd);
+    }
+}
 
 // Main handler for client connections
 void ServerClient::handle()
 {
     std::lock_guard<std::mutex> lock(clientMutex);
+    if (wireProtocol == protocol::WireProtocol::Binary)
+    {
+        serveBinary();
+        return;
+    }
+
     sendMenu(); // Send menu immediately after connection
     while (connected_)
     {
         std::string choice = receiveChoice();
-        if (choice.empty()) // If client disconnected
+        if (!connected_) // If client disconnected
         {
             break;
         }
@@ -36,8 +55,12 @@ void ServerClient::handle()
         {
             break;
         }
-        sendMenu(); // Send menu again after each choice
+        if (choice != "batch" && choice != "17") // batch replies are meant for scripts, not people
+        {
+            sendMenu(); // Send menu again after each choice
+        }
     }
+    flushOutput();
 }
 
 // Send menu options to the client
@@ -52,36 +75,462 @@ void ServerClient::sendMenu()
                        "6. compute_mst\n"
                        "7. query_mst\n"
                        "8. print_graph\n"
-                       "9. exit\n";
+                       "9. exit\n"
+                       "10. create_graph\n"
+                       "11. select_graph\n"
+                       "12. drop_graph\n"
+                       "13. list_graphs\n"
+                       "14. submit_job\n"
+                       "15. poll_job\n"
+                       "16. fetch_job\n"
+                       "17. batch\n"
+                       "18. export_graph\n"
+                       "19. generate_graph\n"
+                       "20. stats\n"
+                       "21. lock_report\n"
+                       "22. export_trace\n"
+                       "23. memory_report\n"
+                       "24. compact_graph\n"
+                       "25. reorder_graph\n"
+                       "26. replication_status\n"
+                       "27. partition_graph\n"
+                       "28. cluster_mst\n";
     sendResponse(menu);
 }
 
-// Receive client's choice
-std::string ServerClient::receiveChoice()
+// Read whatever the socket has into the input buffer; false once the client is gone
+bool ServerClient::fillInput()
 {
-    char buffer[1024] = {0};
-    int valread = read(socket_, buffer, 1024);
+    char buffer[65536];
+    TraceSpan span("receive"); // mostly the client's think time
+    ssize_t valread = receiveWithFds(socket_, buffer, sizeof(buffer), receivedFds);
+    span.end();
     if (valread <= 0)
     {
         connected_ = false;
-        return "";
+        return false;
+    }
+    inputBuffer.append(buffer, valread);
+    return true;
+}
+
+// Receive client's choice: one newline-terminated line, however TCP split or
+// merged the segments that carried it
+std::string ServerClient::receiveChoice()
+{
+    // Consumed lines are dropped from the buffer in bulk rather than one by one,
+    // so a long batch of lines is scanned once
+    if (inputPos > 0 && inputPos * 2 >= inputBuffer.size())
+    {
+        inputBuffer.erase(0, inputPos);
+        inputPos = 0;
+    }
+    size_t newline;
+    size_t scanned = inputPos;
+    while ((newline = inputBuffer.find('\n', scanned)) == std::string::npos)
+    {
+        scanned = inputBuffer.size();
+        // Everything answered so far goes out before we wait for the client
+        if (!flushOutput() || !fillInput())
+        {
+            return "";
+        }
+    }
+    std::string line = inputBuffer.substr(inputPos, newline - inputPos);
+    inputPos = newline + 1;
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+    return line;
+}
+
+// Whether a whole line has been received and not consumed yet
+bool ServerClient::hasBufferedLine() const
+{
+    return inputBuffer.find('\n', inputPos) != std::string::npos;
+}
+
+// Send buffered responses to the client with a single write
+bool ServerClient::flushOutput()
+{
+    if (output.empty())
+    {
+        return true;
+    }
+    TraceSpan span("send_response");
+    if (!output.flush(socket_))
+    {
+        connected_ = false;
+        return false;
     }
-    return std::string(buffer);
+    return true;
 }
 
-// Send response to the client
+// Send a large response chunk by chunk. Each full chunk is flushed before the
+// next is produced, so a slow reader holds the session back (backpressure)
+// instead of the server buffering the whole response.
+void ServerClient::streamResponse(ChunkSource &source)
+{
+    bool more = true;
+    while (more && connected_)
+    {
+        more = source.next(output.tail(), STREAM_CHUNK_SIZE);
+        if (more && output.size() >= STREAM_CHUNK_SIZE)
+        {
+            TraceSpan span("send_response", "chunk");
+            if (!output.flush(socket_, true))
+            {
+                connected_ = false;
+            }
+        }
+    }
+}
+
+// Queue a response for the client; it is sent when the session next waits for input
 void ServerClient::sendResponse(const std::string &response)
 {
-    send(socket_, response.c_str(), response.length(), 0);
+    output.append(response);
+}
+
+// Queue a response the caller no longer needs; large ones are sent without a copy
+void ServerClient::sendResponse(std::string &&response)
+{
+    output.append(std::move(response));
+}
+
+CommandSeries commandSeries(const std::string &protocolName, const char *command)
+{
+    std::string labels = "protocol=\"" + protocolName + "\",command=\"" + command + "\"";
+    Metrics &metrics = Metrics::global();
+    return {metrics.histogram("mst_command_duration_us", labels, "Time from receiving a command to queuing its last reply, in microseconds"),
+            metrics.counter("mst_command_errors_total", labels, "Commands that failed"),
+            command};
+}
+
+// Series of a text command given by menu name or number; registered once, then read without locking
+static const CommandSeries &textCommandSeries(const std::string &choice)
+{
+    static const std::unordered_map<std::string, CommandSeries> table = []()
+    {
+        const char *names[] = {"build_graph", "add_vertex", "add_edge", "remove_vertex", "remove_edge",
+                               "compute_mst", "query_mst", "print_graph", "exit", "create_graph",
+                               "select_graph", "drop_graph", "list_graphs", "submit_job", "poll_job",
+                               "fetch_job", "batch", "export_graph", "generate_graph", "stats", "lock_report", "export_trace",
+                               "memory_report", "compact_graph", "reorder_graph", "replication_status",
+                               "partition_graph", "cluster_mst"};
+        std::unordered_map<std::string, CommandSeries> series;
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i)
+        {
+            series[names[i]] = series[std::to_string(i + 1)] = commandSeries("text", names[i]);
+        }
+        series["invalid"] = commandSeries("text", "invalid");
+        return series;
+    }();
+    auto it = table.find(choice);
+    return it != table.end() ? it->second : table.at("invalid");
 }
 
 // Handle client's choice
+// No graph-wide lock is taken here: mutating commands open a GraphStore::Writer
+// and read-only commands work on an immutable snapshot.
 void ServerClient::handleChoice(const std::string &choice)
 {
-    threadPool.lockGraph();
-    std::lock_guard<std::mutex> lock(threadPool.getGraphMutex(), std::adopt_lock);
+    const CommandSeries &series = textCommandSeries(choice);
+    Metrics::Timer timer(series.duration);
+    TraceSpan span(series.name, "text");
+    ScratchScope scratch; // scratch memory of the command, released when it ends
+    try
+    {
+        checkWritable(series.name);
+        dispatchChoice(choice);
+    }
+    catch (const GraphBusyError &)
+    {
+        // The graph's writer lock was not free within the command deadline
+        threadPool.getAdmissionStats().commandsRejected.fetch_add(1, std::memory_order_relaxed);
+        sendResponse("BUSY retry_after_ms=" + std::to_string(threadPool.getConfig().retryAfterMs) + "\n");
+    }
+    catch (const JobsFullError &)
+    {
+        // max_active_jobs are pending or running; counted by the JobManager
+        sendResponse("BUSY retry_after_ms=" + std::to_string(threadPool.getConfig().retryAfterMs) + "\n");
+    }
+    catch (const std::exception &e)
+    {
+        // Uncommitted writers are discarded, so a failed command leaves the graph unchanged
+        Metrics::global().add(series.errors);
+        sendResponse(std::string("Error: ") + e.what());
+    }
+}
+
+// Maximum time a command waits for its graph's write lock
+std::chrono::milliseconds ServerClient::commandDeadline() const
+{
+    return std::chrono::milliseconds(threadPool.getConfig().commandDeadlineMs);
+}
+
+// Refuse to build a graph with a negative or larger than configured vertex
+// count before anything is allocated for it
+void ServerClient::checkVertexCount(long long vertices) const
+{
+    int limit = threadPool.getConfig().maxVertices;
+    if (vertices < 0 || vertices > limit)
+    {
+        throw std::invalid_argument("Vertex count " + std::to_string(vertices) + " is outside 0.." + std::to_string(limit) +
+                                    " (max_vertices)");
+    }
+}
+
+// Error of a write sent to a replica
+static std::string readOnlyMessage(const ReplicaClient &replica)
+{
+    return "read-only replica of " + replica.primary() + "; send writes to the primary";
+}
+
+// Refuse a command that changes a graph on a read-only replica
+void ServerClient::checkWritable(const std::string &command) const
+{
+    ReplicaClient *replica = threadPool.getReplica();
+    if (replica && replication::isWriteCommand(command))
+    {
+        throw std::runtime_error(readOnlyMessage(*replica));
+    }
+}
+
+// Record how long a command waited for its graph's write lock
+void ServerClient::recordLockWait(const GraphStore::Writer &writer)
+{
+    threadPool.getAdmissionStats().recordLockWait(writer.waited().count());
+}
+
+// Classify a command by its estimated cost on the given graph
+CostClass ServerClient::costOf(const std::string &command, const Graph &graph) const
+{
+    const ServerConfig &config = threadPool.getConfig();
+    double cost = CommandCost::estimate(command, graph.getVertices(), graph.getEdges());
+    return CommandCost::classify(cost, config.interactiveCost, config.heavyCost);
+}
+
+// Run a read-only command according to its cost class: cheap work runs inline
+// on the session thread, anything else waits its turn in the compute pool's
+// lane for that class, so expensive work cannot take every core from cheap commands.
+std::string ServerClient::runScheduled(const std::string &command, const Graph &graph, std::function<std::string()> work)
+{
+    CostClass costClass = costOf(command, graph);
+    if (costClass == CostClass::Interactive)
+    {
+        return work();
+    }
+    auto task = std::make_shared<std::packaged_task<std::string()>>(std::move(work));
+    std::future<std::string> result = task->get_future();
+    threadPool.getComputePool().submit([task]()
+                                       { (*task)(); }, costClass);
+    return result.get();
+}
+
+// Apply one mutation as its own write transaction; nothing is published if it changed nothing
+int ServerClient::applyMutation(const GraphMutation &mutation)
+{
+    GraphStore::Writer writer(*graph_, commandDeadline());
+    recordLockWait(writer);
+    int result = writer.apply(mutation);
+    if (mutation.changed(result))
+    {
+        writer.commit();
+    }
+    return result;
+}
+
+// Apply groups of mutations in order under a single writer and publish them as
+// one snapshot. A group whose edges would reference missing vertices is
+// rejected whole and its error recorded; the groups after it still apply. Returns false, applying nothing, if the graph's
+// write lock was busy past the command deadline.
+bool ServerClient::applyMutationRun(const std::vector<std::vector<GraphMutation>> &groups, std::vector<MutationResult> &results)
+{
+    if (ReplicaClient *replica = threadPool.getReplica())
+    {
+        // A replica's graphs change only through its primary's log
+        results.assign(groups.size(), MutationResult());
+        for (MutationResult &result : results)
+        {
+            result.error = readOnlyMessage(*replica);
+        }
+        return true;
+    }
+    std::unique_ptr<GraphStore::Writer> writer;
+    try
+    {
+        writer.reset(new GraphStore::Writer(*graph_, commandDeadline()));
+    }
+    catch (const GraphBusyError &)
+    {
+        threadPool.getAdmissionStats().commandsRejected.fetch_add(groups.size(), std::memory_order_relaxed);
+        return false;
+    }
+    recordLockWait(*writer);
+
+    results.assign(groups.size(), MutationResult());
+    bool changed = false;
+    bool rebuilt = false;
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        try
+        {
+            if (groups[i].size() > 1)
+            {
+                GraphMutation::checkGroup(groups[i], writer->graph().getVertices());
+            }
+            for (const GraphMutation &mutation : groups[i])
+            {
+                results[i].value = writer->apply(mutation);
+                changed = changed || mutation.changed(results[i].value);
+                rebuilt = rebuilt || mutation.type == GraphMutation::Type::Clear;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            results[i].error = e.what();
+        }
+    }
+
+    if (rebuilt)
+    {
+        placeGraph(writer->graph());
+    }
+    if (changed)
+    {
+        writer->commit();
+    }
+    return true;
+}
+
+// Spread a large graph's memory over the NUMA nodes of the pinned workers that will read it
+void ServerClient::placeGraph(Graph &graph)
+{
+    if (!threadPool.getPinnedCpus().empty() && graph.getEdges() >= threadPool.getConfig().numaMinEdges)
+    {
+        graph.redistribute(threadPool.getPinnedCpus());
+    }
+}
 
-    // Call appropriate function based on client's choice
+// Run body(0) .. body(tasks - 1) on the compute pool and wait for all of them;
+// the first exception thrown by a task is rethrown here
+void ServerClient::runParallel(size_t tasks, const std::function<void(size_t)> &body)
+{
+    std::vector<std::future<void>> done;
+    for (size_t i = 0; i < tasks; ++i)
+    {
+        auto task = std::make_shared<std::packaged_task<void()>>([&body, i]()
+                                                                 { body(i); });
+        done.push_back(task->get_future());
+        threadPool.getComputePool().submit([task]()
+                                           { (*task)(); });
+    }
+    // body is borrowed by every task: wait for all before reporting any error
+    for (std::future<void> &result : done)
+    {
+        result.wait();
+    }
+    for (std::future<void> &result : done)
+    {
+        result.get();
+    }
+}
+
+// The memory breakdown of the selected graph, as sent by memory_report
+std::string ServerClient::memoryReport()
+{
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    std::string header = "Graph '" + graph_->name() + "': " + std::to_string(graph->getVertices()) + " vertices, " +
+                         std::to_string(graph->getEdges()) + " edges, " + Graph::storageName(graph->storage()) +
+                         (graph->isReordered() ? ", reordered" : "") + "\n";
+    return header + graph_->memoryUsage().toString(graph->getEdges());
+}
+
+// The coordinator of the shard servers; throws unless this server is one
+ClusterCoordinator &ServerClient::clusterCoordinator()
+{
+    ClusterCoordinator *coordinator = threadPool.getCluster();
+    if (!coordinator)
+    {
+        throw std::runtime_error("Not a cluster coordinator; start the server with --cluster-shards");
+    }
+    return *coordinator;
+}
+
+// Repack the selected graph into the given storage and publish it as a new
+// version; returns its bytes before and after. The next mutation of the graph
+// brings back per-vertex lists.
+std::pair<size_t, size_t> ServerClient::compactGraph(AdjacencyStorage storage)
+{
+    GraphStore::Writer writer(*graph_, commandDeadline());
+    recordLockWait(writer);
+    Graph &graph = writer.graph();
+    size_t before = graph.memoryUsage().total();
+    graph.compact(storage);
+    placeGraph(graph);
+    size_t after = graph.memoryUsage().total();
+    writer.commit();
+    return {before, after};
+}
+
+// Renumber the selected graph internally for locality and publish it as a new
+// version; returns its average neighbor distance before and after. Vertex IDs
+// seen by clients do not change.
+std::pair<double, double> ServerClient::reorderGraph(VertexOrder order)
+{
+    GraphStore::Writer writer(*graph_, commandDeadline());
+    recordLockWait(writer);
+    Graph &graph = writer.graph();
+    double before = graph.averageNeighborDistance();
+    graph.reorder(order);
+    placeGraph(graph);
+    double after = graph.averageNeighborDistance();
+    writer.commit();
+    return {before, after};
+}
+
+// Replace the selected graph with a synthetic one and return its edge count.
+// Chunks of edges are generated in parallel on the compute pool without
+// holding the write lock; then stripes of vertices take their edges in
+// parallel under one writer, and the graph is published as a single version.
+long long ServerClient::generateGraph(const GeneratorSpec &spec)
+{
+    GraphGenerator generator(spec);
+    std::vector<std::vector<Edge>> batches(generator.chunks());
+    runParallel(batches.size(), [&generator, &batches](size_t chunk)
+                { generator.generateChunk(chunk, batches[chunk]); });
+
+    GraphStore::Writer writer(*graph_, commandDeadline());
+    recordLockWait(writer);
+    writer.apply(GraphMutation::clear());
+    for (int i = 0; i < generator.vertices(); ++i)
+    {
+        writer.apply(GraphMutation::addVertex());
+    }
+    Graph &graph = writer.graph();
+    size_t stripes = std::max<size_t>(1, threadPool.getConfig().computeThreads);
+    int stripeSize = static_cast<int>((generator.vertices() + stripes - 1) / stripes);
+    runParallel(stripes, [&graph, &batches, stripeSize](size_t stripe)
+                {
+        int first = static_cast<int>(stripe) * stripeSize;
+        graph.addEdgesInRange(batches, first, std::min(graph.getVertices(), first + stripeSize)); });
+    placeGraph(graph);
+    writer.logGenerated(spec.toString());
+    writer.commit();
+
+    long long edges = 0;
+    for (const std::vector<Edge> &batch : batches)
+    {
+        edges += static_cast<long long>(batch.size());
+    }
+    return edges;
+}
+
+// Call appropriate function based on client's choice
+void ServerClient::dispatchChoice(const std::string &choice)
+{
     if (choice == "build_graph" || choice == "1")
     {
         buildGraphFromClientInput();
@@ -119,6 +568,82 @@ void ServerClient::handleChoice(const std::string &choice)
         sendResponse("Goodbye!");
         connected_ = false;
     }
+    else if (choice == "create_graph" || choice == "10")
+    {
+        handleCreateGraph();
+    }
+    else if (choice == "select_graph" || choice == "11")
+    {
+        handleSelectGraph();
+    }
+    else if (choice == "drop_graph" || choice == "12")
+    {
+        handleDropGraph();
+    }
+    else if (choice == "list_graphs" || choice == "13")
+    {
+        handleListGraphs();
+    }
+    else if (choice == "submit_job" || choice == "14")
+    {
+        handleSubmitJob();
+    }
+    else if (choice == "poll_job" || choice == "15")
+    {
+        handlePollJob();
+    }
+    else if (choice == "fetch_job" || choice == "16")
+    {
+        handleFetchJob();
+    }
+    else if (choice == "batch" || choice == "17")
+    {
+        handleBatch();
+    }
+    else if (choice == "export_graph" || choice == "18")
+    {
+        handleExportGraph();
+    }
+    else if (choice == "generate_graph" || choice == "19")
+    {
+        handleGenerateGraph();
+    }
+    else if (choice == "stats" || choice == "20")
+    {
+        handleStats();
+    }
+    else if (choice == "lock_report" || choice == "21")
+    {
+        handleLockReport();
+    }
+    else if (choice == "export_trace" || choice == "22")
+    {
+        handleExportTrace();
+    }
+    else if (choice == "memory_report" || choice == "23")
+    {
+        handleMemoryReport();
+    }
+    else if (choice == "compact_graph" || choice == "24")
+    {
+        handleCompactGraph();
+    }
+    else if (choice == "reorder_graph" || choice == "25")
+    {
+        handleReorderGraph();
+    }
+    else if (choice == "replication_status" || choice == "26")
+    {
+        handleReplicationStatus();
+    }
+    else if (choice == "partition_graph" || choice == "27")
+    {
+        handlePartitionGraph();
+    }
+    else if (choice == "cluster_mst" || choice == "28")
+    {
+        handleClusterMST();
+    }
     else
     {
         sendResponse("Invalid choice. Please try again.");
@@ -130,24 +655,24 @@ void ServerClient::buildGraphFromClientInput()
 {
     sendResponse("Enter the number of vertices: ");
     int numVertices = std::stoi(receiveChoice());
-    graph_->clear();
-    for (int i = 0; i < numVertices; ++i)
-    {
-        graph_->addVertex();
-    }
+    checkVertexCount(numVertices);
 
     sendResponse("Enter the number of edges: ");
     int numEdges = std::stoi(receiveChoice());
 
+    // Read every edge before taking the writer lock, so a slow client never
+    // holds up the other writers of this graph
+    std::vector<Edge> edges;
     sendResponse("Enter " + std::to_string(numEdges) + " edges in the format 'source destination weight':");
     for (int i = 0; i < numEdges; ++i)
     {
         std::string edgeInfo = receiveChoice();
         std::istringstream iss(edgeInfo);
         int source, destination, weight;
-        if (iss >> source >> destination >> weight)
+        if (iss >> source >> destination >> weight && source >= 0 && source < numVertices &&
+            destination >= 0 && destination < numVertices)
         {
-            graph_->addEdge(source, destination, weight);
+            edges.push_back(Edge(source, destination, weight));
         }
         else
         {
@@ -155,12 +680,90 @@ void ServerClient::buildGraphFromClientInput()
         }
     }
 
+    // The whole build is one write transaction, published as a single version
+    GraphStore::Writer writer(*graph_, commandDeadline());
+    recordLockWait(writer);
+    writer.apply(GraphMutation::clear());
+    for (int i = 0; i < numVertices; ++i)
+    {
+        writer.apply(GraphMutation::addVertex());
+    }
+    for (const Edge &edge : edges)
+    {
+        writer.apply(GraphMutation::addEdge(edge.source, edge.destination, edge.weight));
+    }
+
+    placeGraph(writer.graph());
+    writer.commit();
     sendResponse("Graph built successfully.");
 }
 
+// Generate a synthetic graph from key=value options
+void ServerClient::handleGenerateGraph()
+{
+    sendResponse("Enter the generator options, e.g. 'kind=rmat vertices=1000000 edges=16000000 seed=1 "
+                 "weights=uniform min_weight=1 max_weight=1000'\n"
+                 "(kinds: erdos_renyi, grid, rmat, complete, geometric; weights: uniform, exponential, constant):");
+    GeneratorSpec spec = GeneratorSpec::parse(receiveChoice());
+    long long edges = generateGraph(spec);
+    sendResponse("Generated graph with " + std::to_string(spec.vertices) + " vertices and " + std::to_string(edges) + " edges.");
+}
+
+// Report counters, pool state and latency percentiles
+void ServerClient::handleStats()
+{
+    sendResponse(Metrics::global().renderText(threadPool.gauges()));
+}
+
+// Report wait and hold times per lock call site (recorded with --lock-profile 1)
+void ServerClient::handleLockReport()
+{
+    sendResponse(lockprofiler::report());
+}
+
+// Report the selected graph's memory by structure
+void ServerClient::handleMemoryReport()
+{
+    sendResponse(memoryReport());
+}
+
+// Repack the selected graph into packed or compressed storage
+void ServerClient::handleCompactGraph()
+{
+    sendResponse("Enter the storage (packed, compressed or lists): ");
+    AdjacencyStorage storage = Graph::parseStorage(receiveChoice());
+    std::pair<size_t, size_t> bytes = compactGraph(storage);
+    sendResponse("Graph compacted: " + std::to_string(bytes.first) + " -> " + std::to_string(bytes.second) + " bytes.");
+}
+
+// Renumber the selected graph in a locality-improving order
+void ServerClient::handleReorderGraph()
+{
+    sendResponse("Enter the order (bfs, rcm or degree): ");
+    VertexOrder order = Graph::parseOrder(receiveChoice());
+    std::pair<double, double> distance = reorderGraph(order);
+    std::ostringstream response;
+    response << std::fixed << std::setprecision(1) << "Graph reordered: average neighbor distance "
+             << distance.first << " -> " << distance.second << ".";
+    sendResponse(response.str());
+}
+
+// Write the recorded spans (--trace-events N) to the server's trace file
+void ServerClient::handleExportTrace()
+{
+    if (!tracing::enabled())
+    {
+        sendResponse("Tracing is off; start the server with --trace-events N to record spans.");
+        return;
+    }
+    const std::string &path = threadPool.getConfig().traceFile;
+    size_t events = tracing::exportFile(path);
+    sendResponse("Wrote " + std::to_string(events) + " trace events to " + path + " (open it in ui.perfetto.dev or chrome://tracing).");
+}
+
 void ServerClient::handleAddVertex()
 {
-    int newVertex = graph_->addVertex();
+    int newVertex = applyMutation(GraphMutation::addVertex());
     sendResponse("Vertex " + std::to_string(newVertex) + " added successfully.");
 }
 
@@ -173,7 +776,7 @@ void ServerClient::handleAddEdge()
     int destination = std::stoi(receiveChoice());
     sendResponse("Enter weight: ");
     int weight = std::stoi(receiveChoice());
-    graph_->addEdge(source, destination, weight);
+    applyMutation(GraphMutation::addEdge(source, destination, weight));
     sendResponse("Edge added successfully.");
 }
 
@@ -182,7 +785,7 @@ void ServerClient::handleRemoveVertex()
 {
     sendResponse("Enter vertex to remove: ");
     int vertex = std::stoi(receiveChoice());
-    if (graph_->removeVertex(vertex))
+    if (applyMutation(GraphMutation::removeVertex(vertex)))
     {
         sendResponse("Vertex removed successfully.");
     }
@@ -199,7 +802,7 @@ void ServerClient::handleRemoveEdge()
     int source = std::stoi(receiveChoice());
     sendResponse("Enter destination vertex: ");
     int destination = std::stoi(receiveChoice());
-    if (graph_->removeEdge(source, destination))
+    if (applyMutation(GraphMutation::removeEdge(source, destination)))
     {
         sendResponse("Edge removed successfully.");
     }
@@ -209,6 +812,34 @@ void ServerClient::handleRemoveEdge()
     }
 }
 
+// Format MST edges as a table followed by the total weight
+static std::string formatMSTReport(const std::string &algorithm, std::shared_ptr<const std::vector<Edge>> mstEdges)
+{
+    return MSTSerializer(algorithm, std::move(mstEdges)).drain();
+}
+
+// Compute the metrics of an MST and format them
+static std::string formatMetricsReport(const Graph &graph, const std::vector<Edge> &mstEdges)
+{
+    // Create an MSTMetrics object to calculate various metrics
+    MSTMetrics metrics;
+    // Calculate metrics based on the graph and MST edges
+    metrics.calculateMetrics(graph, mstEdges);
+
+    // Prepare the response string with MST metrics
+    std::stringstream ss;
+    ss << "MST Metrics:\n";
+    // Add the total weight of the MST
+    ss << "Total Weight: " << MSTMetrics::getTotalWeight(mstEdges) << "\n";
+    // Add the longest distance between any two vertices in the MST
+    ss << "Longest Distance: " << MSTMetrics::getLongestDistance(graph, mstEdges) << "\n";
+    // Add the average distance between vertices in the MST
+    ss << "Average Distance: " << MSTMetrics::getAverageDistance(graph, mstEdges) << "\n";
+    // Add the shortest distance (weight) of any edge in the MST
+    ss << "Shortest Distance: " << MSTMetrics::getShortestDistance(mstEdges) << "\n";
+    return ss.str();
+}
+
 // Compute Minimum Spanning Tree
 void ServerClient::computeMST()
 {
@@ -216,82 +847,241 @@ void ServerClient::computeMST()
     sendResponse("Choose MST algorithm (Prim/Kruskal): ");
     std::string algorithm = receiveChoice();
 
-    // Create an MST object based on the user's choice using the factory pattern
-    auto mst = MSTFactory::createMST(algorithm);
+    // Compute the Minimum Spanning Tree on the current snapshot; writers are not blocked.
+    // The graph's MST cache returns the previous result if the snapshot is unchanged.
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    std::shared_ptr<GraphStore> store = graph_;
+    std::shared_ptr<const std::vector<Edge>> mstEdges;
+    runScheduled("mst", *graph, [store, graph, algorithm, &mstEdges]()
+                 {
+        mstEdges = store->findMST(graph, algorithm);
+        return std::string(); });
 
-    // Compute the Minimum Spanning Tree using the chosen algorithm
-    std::vector<Edge> mstEdges = mst->findMST(*graph_);
+    // Stream the formatted MST table back to the client
+    MSTSerializer report(algorithm, mstEdges);
+    streamResponse(report);
+}
 
-    // Prepare the response string with a formatted table of MST edges
-    std::stringstream ss;
-    ss << "\nMinimum Spanning Tree (" << algorithm << " algorithm):\n\n";
-    ss << "+--------+--------+--------+\n";
-    ss << "| Source | Dest   | Weight |\n";
-    ss << "+--------+--------+--------+\n";
+// Handle MST queries
+void ServerClient::handleMSTQueries()
+{
+    // Prompt the user to choose an MST algorithm (Prim or Kruskal)
+    sendResponse("Choose MST algorithm (Prim/Kruskal): ");
+    std::string algorithm = receiveChoice();
+
+    // Compute (or reuse from the cache) the MST edges using the chosen algorithm on the current snapshot
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    std::shared_ptr<GraphStore> store = graph_;
+    std::string report = runScheduled("metrics", *graph, [store, graph, algorithm]()
+                                      { return formatMetricsReport(*graph, *store->findMST(graph, algorithm)); });
 
-    // Iterate through the MST edges, format them into the table, and calculate total weight
-    int totalWeight = 0;
-    for (const auto &edge : mstEdges)
+    // Send the formatted response back to the client
+    sendResponse(std::move(report));
+}
+
+// Submit an MST or metrics job on the current snapshot; returns its ID
+uint64_t ServerClient::submitJob(const std::string &type, const std::string &algorithm, std::string &description)
+{
+    if (type != "mst" && type != "metrics")
     {
-        ss << "| " << std::setw(6) << edge.source
-           << " | " << std::setw(6) << edge.destination
-           << " | " << std::setw(6) << edge.weight << " |\n";
-        totalWeight += edge.weight;
+        throw std::invalid_argument("Unknown job type: " + type);
     }
+    MSTFactory::createMST(algorithm); // reject unknown algorithms now rather than in the job
 
-    // Add the table footer and total MST weight
-    ss << "+--------+--------+--------+\n";
-    ss << "\nTotal MST Weight: " << totalWeight << "\n";
-
-    // Send the formatted MST information back to the client
-    sendResponse(ss.str());
+    // The job keeps the snapshot alive, so later writes do not affect its result
+    std::shared_ptr<GraphStore> store = graph_;
+    std::shared_ptr<const Graph> graph = store->snapshot();
+    CostClass costClass = costOf(type, *graph);
+    description = type + " " + algorithm + " on '" + store->name() + "' version " + std::to_string(graph->getVersion()) +
+                  ", " + CommandCost::name(costClass);
+    return threadPool.getJobs().submit(description, costClass, [store, graph, type, algorithm]()
+                                       {
+        std::shared_ptr<const std::vector<Edge>> mstEdges = store->findMST(graph, algorithm);
+        return type == "mst" ? formatMSTReport(algorithm, mstEdges) : formatMetricsReport(*graph, *mstEdges); });
 }
 
-// Handle MST queries
-void ServerClient::handleMSTQueries()
+// Submit an MST or metrics job and return its ID at once
+void ServerClient::handleSubmitJob()
 {
-    // Prompt the user to choose an MST algorithm (Prim or Kruskal)
+    sendResponse("Job type (mst/metrics): ");
+    std::string type = receiveChoice();
+    if (type != "mst" && type != "metrics")
+    {
+        sendResponse("Unknown job type: " + type);
+        return;
+    }
     sendResponse("Choose MST algorithm (Prim/Kruskal): ");
     std::string algorithm = receiveChoice();
 
-    // Create an MST object based on the chosen algorithm
-    auto mst = MSTFactory::createMST(algorithm);
+    std::string description;
+    uint64_t id = submitJob(type, algorithm, description);
+    sendResponse("Job " + std::to_string(id) + " submitted (" + description + ").");
+}
 
-    // Compute the Minimum Spanning Tree edges using the chosen algorithm
-    std::vector<Edge> mstEdges = mst->findMST(*graph_);
+// Report the state of a job
+void ServerClient::handlePollJob()
+{
+    sendResponse("Enter job ID: ");
+    uint64_t id = std::stoull(receiveChoice());
+    std::string description;
+    JobManager::State state = threadPool.getJobs().poll(id, description);
+    if (state == JobManager::State::Unknown)
+    {
+        sendResponse("Job " + std::to_string(id) + " not found.");
+        return;
+    }
+    sendResponse("Job " + std::to_string(id) + " (" + description + "): " + JobManager::stateName(state));
+}
 
-    // Create an MSTMetrics object to calculate various metrics
-    MSTMetrics metrics;
-    // Calculate metrics based on the graph and MST edges
-    metrics.calculateMetrics(*graph_, mstEdges);
+// Send the result of a finished job; it is forgotten afterwards
+void ServerClient::handleFetchJob()
+{
+    sendResponse("Enter job ID: ");
+    uint64_t id = std::stoull(receiveChoice());
+    std::string result;
+    JobManager::State state = threadPool.getJobs().fetch(id, result);
+    if (state == JobManager::State::Done)
+    {
+        sendResponse(std::move(result));
+    }
+    else if (state == JobManager::State::Failed)
+    {
+        sendResponse("Job " + std::to_string(id) + " failed: " + result);
+    }
+    else if (state == JobManager::State::Unknown)
+    {
+        sendResponse("Job " + std::to_string(id) + " not found.");
+    }
+    else
+    {
+        sendResponse("Job " + std::to_string(id) + " is " + JobManager::stateName(state) + ", try again later.");
+    }
+}
 
-    // Prepare the response string with MST metrics
-    std::stringstream ss;
-    ss << "MST Metrics:\n";
-    // Add the total weight of the MST
-    ss << "Total Weight: " << MSTMetrics::getTotalWeight(mstEdges) << "\n";
-    // Add the longest distance between any two vertices in the MST
-    ss << "Longest Distance: " << MSTMetrics::getLongestDistance(*graph_, mstEdges) << "\n";
-    // Add the average distance between vertices in the MST
-    ss << "Average Distance: " << MSTMetrics::getAverageDistance(*graph_, mstEdges) << "\n";
-    // Add the shortest distance (weight) of any edge in the MST
-    ss << "Shortest Distance: " << MSTMetrics::getShortestDistance(mstEdges) << "\n";
+// Print the graph
+// Streamed from the current snapshot, so no lock is held and memory stays
+// bounded by the chunk size however large the graph is
+void ServerClient::printGraph()
+{
+    GraphSerializer dump(graph_->snapshot(), DumpFormat::Text);
+    streamResponse(dump);
+}
 
-    // Send the formatted response back to the client
+// Export the graph in the compact format (see DumpFormat::Compact)
+void ServerClient::handleExportGraph()
+{
+    GraphSerializer dump(graph_->snapshot(), DumpFormat::Compact);
+    streamResponse(dump);
+}
+
+// Create a new named graph and select it
+void ServerClient::handleCreateGraph()
+{
+    sendResponse("Enter graph name: ");
+    std::string name = receiveChoice();
+    auto store = threadPool.getGraphs().create(name);
+    if (!store)
+    {
+        sendResponse("Graph '" + name + "' already exists.");
+        return;
+    }
+    graph_ = store;
+    sendResponse("Graph '" + name + "' created and selected.");
+}
+
+// Select the graph this session works on
+void ServerClient::handleSelectGraph()
+{
+    sendResponse("Enter graph name: ");
+    std::string name = receiveChoice();
+    auto store = threadPool.getGraphs().find(name);
+    if (!store)
+    {
+        sendResponse("Graph '" + name + "' does not exist.");
+        return;
+    }
+    graph_ = store;
+    sendResponse("Graph '" + name + "' selected.");
+}
+
+// Drop a named graph; if it was selected, fall back to the default graph
+void ServerClient::handleDropGraph()
+{
+    sendResponse("Enter graph name: ");
+    std::string name = receiveChoice();
+    if (!threadPool.getGraphs().drop(name))
+    {
+        sendResponse("Failed to drop graph '" + name + "'.");
+        return;
+    }
+    if (graph_->name() == name)
+    {
+        graph_ = threadPool.getGraphs().find(GraphRegistry::DEFAULT_GRAPH);
+    }
+    sendResponse("Graph '" + name + "' dropped.");
+}
+
+// List all graphs, marking the selected one
+void ServerClient::handleListGraphs()
+{
+    std::stringstream ss;
+    ss << "Graphs:\n";
+    for (const std::string &name : threadPool.getGraphs().list())
+    {
+        ss << (name == graph_->name() ? "* " : "  ") << name << "\n";
+    }
     sendResponse(ss.str());
 }
 
-// Print the graph
-void ServerClient::printGraph()
+// Report whether this server is standalone, a primary or a replica, and how far behind
+void ServerClient::handleReplicationStatus()
+{
+    sendResponse(threadPool.replicationStatus() + "\n");
+}
+
+// Split the selected graph across the shard servers
+void ServerClient::handlePartitionGraph()
 {
-    sendResponse(graph_->toString());
+    ClusterCoordinator &coordinator = clusterCoordinator();
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    ClusterCoordinator::PartitionStats stats = coordinator.partition(graph_->name(), graph, commandDeadline());
+    std::ostringstream oss;
+    oss << "Graph '" << graph_->name() << "' partitioned across " << stats.shards << " shards: "
+        << stats.shardEdges << " edges on the shards, " << stats.cutEdges << " cut edges (" << stats.millis << " ms)\n";
+    sendResponse(oss.str());
+}
+
+// MST of the selected graph from the shards' spanning forests
+void ServerClient::handleClusterMST()
+{
+    ClusterCoordinator &coordinator = clusterCoordinator();
+    std::shared_ptr<const Graph> graph = graph_->snapshot();
+    ClusterCoordinator::MSTResult result = coordinator.computeMST(graph_->name(), graph, commandDeadline());
+    std::ostringstream oss;
+    oss << "Cluster MST of '" << graph_->name() << "': " << result.edges.size() << " edges, total weight "
+        << MSTMetrics::getTotalWeight(result.edges) << "\n"
+        << "Shard forests: " << result.forestEdges << " edges in " << result.shardMillis << " ms; merged with "
+        << result.cutEdges << " cut edges in " << result.mergeMillis << " ms\n";
+    sendResponse(oss.str());
 }
 
 // Main function
-int main()
+int main(int argc, char *argv[])
 {
-    // Create a ThreadPool with 4 worker threads
-    ThreadPool pool(4);
+    // Read pool size, port and timeouts from the config file and flags
+    ServerConfig config;
+    try
+    {
+        config = ServerConfig::fromArgs(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << "\n" << ServerConfig::usage() << std::endl;
+        return 1;
+    }
+
+    // Create a ThreadPool that starts with config.threads workers and grows up to config.maxThreads
+    ThreadPool pool(config);
     // Start the thread pool, which initializes the worker threads and starts the leader thread
     pool.start();
 
@@ -326,6 +1116,20 @@ int main()
     // Stop the thread pool, which will clean up resources and join worker threads
     pool.stop();
 
+    // Every pool thread has finished its spans, so the trace is complete
+    if (tracing::enabled())
+    {
+        try
+        {
+            size_t events = tracing::exportFile(config.traceFile);
+            safePrint("Wrote " + std::to_string(events) + " trace events to " + config.traceFile);
+        }
+        catch (const std::exception &e)
+        {
+            safePrint(e.what());
+        }
+    }
+
     // If the input thread is still running, wait for it to finish
     if (inputThread.joinable())
     {
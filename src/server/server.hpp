@@ -2,20 +2,88 @@
 #define SERVER_HPP
 
 #include "../utils/threadpool.hpp"
+#include "../utils/outputbuffer.hpp"
+#include "../utils/sharedregion.hpp"
+#include "../common/CommandCost.hpp"
+#include "../common/GraphMutation.hpp"
+#include "../common/Protocol.hpp"
+#include "../common/GraphSerializer.hpp"
+#include "../common/GraphGenerators.hpp"
+#include <functional>
+#include <vector>
+
+// Outcome of one group of mutations applied by ServerClient::applyMutationRun
+struct MutationResult
+{
+    int value = 0;     // result of the group's last mutation (see GraphMutation::applyTo)
+    std::string error; // empty on success
+};
+
+// Metric series of one command (see Metrics)
+struct CommandSeries
+{
+    size_t duration; // histogram of the time to answer it, in microseconds
+    size_t errors;   // counter of the times it failed
+    const char *name; // command name, also the name of its trace spans
+};
+
+// Register (or look up) the series of a command on a protocol ("text" or "binary")
+CommandSeries commandSeries(const std::string &protocolName, const char *command);
 
 class ServerClient : public Client
 {
 public:
-    ServerClient(int socket, std::shared_ptr<Graph> graph, ThreadPool &pool);
+    ServerClient(int socket, std::shared_ptr<GraphStore> graph, ThreadPool &pool,
+                 protocol::WireProtocol wireProtocol = protocol::WireProtocol::Text);
+    ~ServerClient();
     void handle() override;
 
 private:
+    // bytes produced per step of a streamed response
+    static const size_t STREAM_CHUNK_SIZE = 64 * 1024;
+    // most mutations of a batch applied as one write transaction
+    static const size_t MAX_BATCH_RUN = 1024;
+
     std::mutex clientMutex;
     ThreadPool &threadPool;
+    protocol::WireProtocol wireProtocol;
+    // bytes read from the socket but not consumed yet (partial lines or frames)
+    std::string inputBuffer;
+    size_t inputPos = 0; // start of the unread part of inputBuffer (text protocol)
+    // responses waiting to be sent; flushed before the session blocks on a read
+    OutputBuffer output;
+    // binary responses of the frames being processed
+    std::string frameOutput;
+    // descriptors received over a Unix domain socket, not yet claimed by ATTACH_REGION
+    std::vector<int> receivedFds;
+    // shared-memory regions attached by the client, indexed by region ID
+    std::vector<SharedRegion> regions;
+    bool fillInput();
+    bool flushOutput();
     void sendMenu();
     std::string receiveChoice();
+    bool hasBufferedLine() const;
     void sendResponse(const std::string &response);
+    void sendResponse(std::string &&response);
+    void streamResponse(ChunkSource &source);
     void handleChoice(const std::string &choice);
+    void dispatchChoice(const std::string &choice);
+    std::chrono::milliseconds commandDeadline() const;
+    void checkVertexCount(long long vertices) const;
+    void checkWritable(const std::string &command) const;
+    void recordLockWait(const GraphStore::Writer &writer);
+    int applyMutation(const GraphMutation &mutation);
+    bool applyMutationRun(const std::vector<std::vector<GraphMutation>> &groups, std::vector<MutationResult> &results);
+    void placeGraph(Graph &graph);
+    void runParallel(size_t tasks, const std::function<void(size_t)> &body);
+    long long generateGraph(const GeneratorSpec &spec);
+    std::string memoryReport();
+    std::pair<size_t, size_t> compactGraph(AdjacencyStorage storage);
+    std::pair<double, double> reorderGraph(VertexOrder order);
+    ClusterCoordinator &clusterCoordinator();
+    uint64_t submitJob(const std::string &type, const std::string &algorithm, std::string &description);
+    CostClass costOf(const std::string &command, const Graph &graph) const;
+    std::string runScheduled(const std::string &command, const Graph &graph, std::function<std::string()> work);
     void buildGraphFromClientInput();
     void handleAddVertex();
     void handleAddEdge();
@@ -24,6 +92,39 @@ private:
     void computeMST();
     void handleMSTQueries();
     void printGraph();
+    void handleExportGraph();
+    void handleGenerateGraph();
+    void handleStats();
+    void handleLockReport();
+    void handleExportTrace();
+    void handleMemoryReport();
+    void handleCompactGraph();
+    void handleReorderGraph();
+    void handleCreateGraph();
+    void handleSelectGraph();
+    void handleDropGraph();
+    void handleListGraphs();
+    void handleReplicationStatus();
+    void handlePartitionGraph();
+    void handleClusterMST();
+    void handleSubmitJob();
+    void handlePollJob();
+    void handleFetchJob();
+
+    // Batch mode (batchmode.cpp)
+    void handleBatch();
+    std::string runBatchCommand(const std::vector<std::string> &args);
+
+    // Binary protocol (binaryprotocol.cpp)
+    void serveBinary();
+    void processFrames(std::vector<protocol::Frame> &frames, std::string &out);
+    void applyMutationFrames(std::vector<protocol::Frame>::iterator begin,
+                             std::vector<protocol::Frame>::iterator end, std::string &out);
+    void handleFrame(const protocol::Frame &frame, std::string &out);
+    std::vector<GraphMutation> decodeMutations(const protocol::Frame &frame) const;
+    uint32_t attachRegion(uint64_t size);
+    void streamGraph(const protocol::Frame &frame, std::string &out);
+    void exportRegion(const protocol::Frame &frame, std::string &out);
 };
 
 #endif // SERVER_HPP
@@ -0,0 +1,193 @@
+// This file implements CPU pinning and NUMA topology discovery for the server.
+
+#include "affinity.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+
+namespace affinity
+{
+    namespace
+    {
+        // CPUs in this process's affinity mask
+        std::vector<int> allowedCpus()
+        {
+            std::vector<int> cpus;
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if (CPU_ISSET(cpu, &set))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+            if (cpus.empty())
+            {
+                for (unsigned cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+    }
+
+    std::vector<int> parseCpuList(const std::string &list)
+    {
+        std::vector<int> cpus;
+        std::istringstream iss(list);
+        std::string range;
+        while (std::getline(iss, range, ','))
+        {
+            if (range.empty() || range == "\n")
+            {
+                continue;
+            }
+            size_t dash = range.find('-');
+            try
+            {
+                int first = std::stoi(range.substr(0, dash));
+                int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                if (first < 0 || last < first)
+                {
+                    throw std::invalid_argument(range);
+                }
+                for (int cpu = first; cpu <= last; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            catch (const std::exception &)
+            {
+                throw std::invalid_argument("Invalid CPU list: " + list);
+            }
+        }
+        return cpus;
+    }
+
+    std::vector<std::vector<int>> numaNodes()
+    {
+        std::vector<int> allowed = allowedCpus();
+        std::vector<std::vector<int>> nodes;
+
+        // Node directories may be sparse, so probe a generous range
+        for (int node = 0; node < 1024; ++node)
+        {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            if (!file)
+            {
+                continue;
+            }
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list))
+            {
+                if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            if (!cpus.empty())
+            {
+                nodes.push_back(cpus);
+            }
+        }
+
+        if (nodes.empty())
+        {
+            nodes.push_back(allowed);
+        }
+        return nodes;
+    }
+
+    std::vector<int> cpuOrder(const std::string &mode)
+    {
+        if (mode.empty() || mode == "none")
+        {
+            return {};
+        }
+
+        std::vector<std::vector<int>> nodes = numaNodes();
+        std::vector<int> order;
+        if (mode == "compact")
+        {
+            for (const auto &node : nodes)
+            {
+                order.insert(order.end(), node.begin(), node.end());
+            }
+        }
+        else if (mode == "scatter")
+        {
+            for (size_t i = 0;; ++i)
+            {
+                bool added = false;
+                for (const auto &node : nodes)
+                {
+                    if (i < node.size())
+                    {
+                        order.push_back(node[i]);
+                        added = true;
+                    }
+                }
+                if (!added)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            order = parseCpuList(mode);
+        }
+
+        if (order.empty())
+        {
+            throw std::invalid_argument("Pinning mode '" + mode + "' selects no CPUs");
+        }
+        return order;
+    }
+
+    bool pinCurrentThread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    void parallelStripes(size_t count, const std::vector<int> &cpus,
+                         const std::function<void(size_t, size_t)> &body)
+    {
+        if (cpus.size() <= 1 || count < cpus.size())
+        {
+            body(0, count);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        size_t stripe = (count + cpus.size() - 1) / cpus.size();
+        for (size_t i = 0; i < cpus.size(); ++i)
+        {
+            size_t begin = std::min(count, i * stripe);
+            size_t end = std::min(count, begin + stripe);
+            int cpu = cpus[i];
+            threads.emplace_back([&body, begin, end, cpu]()
+                                 {
+                pinCurrentThread(cpu);
+                body(begin, end); });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
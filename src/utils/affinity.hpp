@@ -0,0 +1,37 @@
+#ifndef AFFINITY_HPP
+#define AFFINITY_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstddef>
+
+// CPU pinning and NUMA helpers for the worker threads and graph memory.
+// The topology comes from /sys/devices/system/node; machines without NUMA
+// information are treated as a single node holding every usable CPU.
+namespace affinity
+{
+    // CPUs of each NUMA node, restricted to the CPUs this process may run on
+    std::vector<std::vector<int>> numaNodes();
+
+    // Parse a CPU list such as "0-3,8,10-11"
+    std::vector<int> parseCpuList(const std::string &list);
+
+    // Resolve a pinning mode to the order in which workers take CPUs:
+    //   "none"    -> empty (threads are not pinned)
+    //   "compact" -> fill one NUMA node before moving to the next
+    //   "scatter" -> round-robin across NUMA nodes
+    //   otherwise -> an explicit CPU list
+    std::vector<int> cpuOrder(const std::string &mode);
+
+    // Pin the calling thread to one CPU, returns false on failure
+    bool pinCurrentThread(int cpu);
+
+    // Run body(begin, end) over [0, count) split into one contiguous stripe per
+    // CPU, each stripe on a thread pinned to its CPU. Memory allocated or first
+    // written inside body is therefore placed on that CPU's NUMA node.
+    void parallelStripes(size_t count, const std::vector<int> &cpus,
+                         const std::function<void(size_t, size_t)> &body);
+}
+
+#endif // AFFINITY_HPP
@@ -0,0 +1,132 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+Arena::Arena(size_t blockSize, size_t maxRetained) : blockSize_(blockSize), maxRetained_(maxRetained)
+{
+}
+
+Arena::~Arena() = default;
+
+// Bump-allocate from the current block, moving on to the next kept block (or
+// a new one) when it does not fit
+void *Arena::allocate(size_t bytes, size_t alignment)
+{
+    while (true)
+    {
+        if (current_ < blocks_.size())
+        {
+            Block &block = blocks_[current_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t start = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+            if (start + bytes <= block.size)
+            {
+                offset_ = start + bytes;
+                peak_ = std::max(peak_, before_ + offset_);
+                return block.data.get() + start;
+            }
+            if (current_ + 1 < blocks_.size() && blocks_[current_ + 1].size >= bytes + alignment)
+            {
+                moveTo(current_ + 1, 0);
+                continue;
+            }
+        }
+        addBlock(bytes + alignment);
+    }
+}
+
+// Insert a block after the current one and make it current. Sizes double so
+// that a large request needs few blocks.
+void Arena::addBlock(size_t minimum)
+{
+    size_t size = blockSize_;
+    if (!blocks_.empty())
+    {
+        size = std::max(size, blocks_[std::min(current_, blocks_.size() - 1)].size * 2);
+    }
+    size = std::max(size, minimum);
+    Block block{std::unique_ptr<char[]>(new char[size]), size};
+    size_t position = blocks_.empty() ? 0 : std::min(current_ + 1, blocks_.size());
+    blocks_.insert(blocks_.begin() + position, std::move(block));
+    moveTo(position, 0);
+}
+
+void Arena::moveTo(size_t block, size_t offset)
+{
+    current_ = block;
+    offset_ = offset;
+    before_ = 0;
+    for (size_t i = 0; i < block && i < blocks_.size(); ++i)
+    {
+        before_ += blocks_[i].size;
+    }
+}
+
+void Arena::rewind(Marker marker)
+{
+    moveTo(marker.block, marker.offset);
+}
+
+void Arena::reset()
+{
+    size_t used = peak_;
+    peak_ = 0;
+    moveTo(0, 0);
+    if (blocks_.size() <= 1 && capacity() <= maxRetained_)
+    {
+        return;
+    }
+    // One block that would have held the whole request, if that is not too big
+    blocks_.clear();
+    if (used > 0 && used <= maxRetained_)
+    {
+        addBlock(std::max(used, blockSize_));
+    }
+}
+
+size_t Arena::capacity() const
+{
+    size_t total = 0;
+    for (const Block &block : blocks_)
+    {
+        total += block.size;
+    }
+    return total;
+}
+
+Arena &scratchArena()
+{
+    static thread_local Arena arena;
+    return arena;
+}
+
+namespace
+{
+    thread_local int scopeDepth = 0;
+    std::atomic<size_t> scratchRetained{4 * 1024 * 1024};
+}
+
+void setScratchRetained(size_t bytes)
+{
+    scratchRetained.store(bytes, std::memory_order_relaxed);
+}
+
+ScratchScope::ScratchScope() : arena_(scratchArena()), marker_(arena_.mark()), outermost_(scopeDepth == 0)
+{
+    ++scopeDepth;
+}
+
+ScratchScope::~ScratchScope()
+{
+    --scopeDepth;
+    if (outermost_)
+    {
+        arena_.setMaxRetained(scratchRetained.load(std::memory_order_relaxed));
+        arena_.reset();
+    }
+    else
+    {
+        arena_.rewind(marker_);
+    }
+}
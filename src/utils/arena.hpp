@@ -0,0 +1,117 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Monotonic arena for request-scoped scratch memory. Allocation bumps a
+// pointer through the current block and deallocation does nothing; memory
+// comes back all at once when the arena is rewound or reset. Blocks are kept
+// for the next request, and reset() merges them into one block sized for
+// everything the request used, so a worker running the same kind of command
+// again allocates nothing from the heap.
+class Arena
+{
+public:
+    // first block size; blocks beyond maxRetained bytes are freed on reset
+    explicit Arena(size_t blockSize = 64 * 1024, size_t maxRetained = 4 * 1024 * 1024);
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void *allocate(size_t bytes, size_t alignment);
+
+    // position to rewind to, for nested scopes
+    struct Marker
+    {
+        size_t block;
+        size_t offset;
+    };
+    Marker mark() const { return {current_, offset_}; }
+    void rewind(Marker marker);
+    // drop everything; keeps (at most maxRetained bytes of) the blocks as one
+    void reset();
+
+    size_t capacity() const;
+    // takes effect at the next reset
+    void setMaxRetained(size_t bytes) { maxRetained_ = bytes; }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+    void addBlock(size_t minimum);
+    void moveTo(size_t block, size_t offset);
+
+    std::vector<Block> blocks_;
+    size_t current_ = 0; // block being carved
+    size_t offset_ = 0;  // used bytes of that block
+    size_t blockSize_;
+    size_t maxRetained_;
+    size_t before_ = 0; // bytes of the blocks before the current one
+    size_t peak_ = 0;   // most bytes in use since the last reset, across blocks
+};
+
+// The calling thread's scratch arena
+Arena &scratchArena();
+// Bytes of scratch every thread's arena keeps between requests (4 MiB unless
+// set, from config scratch_retained_bytes); applied when a thread's outermost
+// ScratchScope ends
+void setScratchRetained(size_t bytes);
+
+// Scratch memory of one request or computation on this thread. Allocations
+// made through scratchArena() while the scope lives are released when it ends:
+// nested scopes rewind to where they started, the outermost resets the arena.
+// Nothing allocated in scope may be used after it.
+class ScratchScope
+{
+public:
+    ScratchScope();
+    ~ScratchScope();
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+
+    Arena &arena() { return arena_; }
+
+private:
+    Arena &arena_;
+    Arena::Marker marker_;
+    bool outermost_;
+};
+
+// Standard allocator over an Arena, for containers of scratch data
+template <typename T>
+class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &arena) : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena_) {}
+
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(arena_->allocate(count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const { return arena_ == other.arena_; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const { return arena_ != other.arena_; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    Arena *arena_;
+};
+
+// A vector in the calling thread's scratch arena
+template <typename T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // ARENA_HPP
@@ -0,0 +1,440 @@
+#include "cluster.hpp"
+#include "tracing.hpp"
+#include "../common/KruskalMST.hpp"
+#include "../common/Protocol.hpp"
+#include <cerrno>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+// This file implements the cluster coordinator: partitioning a graph across
+// shard servers and merging their spanning forests.
+
+using namespace protocol;
+
+namespace
+{
+    // edges per BUILD_GRAPH or ADD_EDGE frame sent to a shard
+    const size_t EDGES_PER_FRAME = 1 << 20;
+
+    // A blocking binary protocol connection to one shard. Connecting, and
+    // every send or receive, fails once the shard has made no progress for
+    // the timeout, so a hung shard cannot hold the session forever.
+    class ShardConnection
+    {
+    public:
+        ShardConnection(const std::string &endpoint, std::chrono::milliseconds timeout)
+            : endpoint_(endpoint), timeout_(timeout)
+        {
+            struct timeval limit;
+            limit.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+            limit.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+            size_t colon = endpoint.rfind(':');
+            std::string host = endpoint.substr(0, colon);
+            std::string port = endpoint.substr(colon + 1);
+            addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo *result = nullptr;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+            {
+                throw std::runtime_error("Cannot resolve shard " + endpoint);
+            }
+            socket_ = -1;
+            for (addrinfo *entry = result; entry != nullptr && socket_ == -1; entry = entry->ai_next)
+            {
+                socket_ = ::socket(entry->ai_family, entry->ai_socktype, entry->ai_protocol);
+                if (socket_ == -1)
+                {
+                    continue;
+                }
+                // SO_SNDTIMEO also bounds connect()
+                setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+                setsockopt(socket_, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+                if (::connect(socket_, entry->ai_addr, entry->ai_addrlen) != 0)
+                {
+                    ::close(socket_);
+                    socket_ = -1;
+                }
+            }
+            freeaddrinfo(result);
+            if (socket_ == -1)
+            {
+                throw std::runtime_error("Cannot connect to shard " + endpoint);
+            }
+        }
+
+        ~ShardConnection()
+        {
+            ::close(socket_);
+        }
+
+        ShardConnection(const ShardConnection &) = delete;
+        ShardConnection &operator=(const ShardConnection &) = delete;
+
+        // Queue a request; it is sent with the next call to responses()
+        void request(uint8_t opcode, const std::string &payload = "")
+        {
+            appendFrame(requests_, opcode, OK, ++sent_, payload);
+        }
+
+        // Send the queued requests (pipelined) and wait for all their responses
+        std::vector<Frame> responses()
+        {
+            size_t sent = 0;
+            while (sent < requests_.size())
+            {
+                ssize_t count = ::send(socket_, requests_.data() + sent, requests_.size() - sent, MSG_NOSIGNAL);
+                if (count <= 0)
+                {
+                    throwIfTimedOut();
+                    throw std::runtime_error("Lost the connection to shard " + endpoint_);
+                }
+                sent += static_cast<size_t>(count);
+            }
+            requests_.clear();
+
+            std::vector<Frame> frames;
+            while (received_ < sent_)
+            {
+                Frame frame;
+                size_t offset = 0;
+                if (parseFrame(buffer_, offset, frame))
+                {
+                    buffer_.erase(0, offset);
+                    frames.push_back(std::move(frame));
+                    ++received_;
+                    continue;
+                }
+                char chunk[65536];
+                ssize_t count = ::recv(socket_, chunk, sizeof(chunk), 0);
+                if (count <= 0)
+                {
+                    throwIfTimedOut();
+                    throw std::runtime_error("Shard " + endpoint_ + " closed the connection");
+                }
+                buffer_.append(chunk, static_cast<size_t>(count));
+            }
+            return frames;
+        }
+
+        // Throw unless the response is OK
+        void check(const Frame &frame) const
+        {
+            if (frame.status == OK)
+            {
+                return;
+            }
+            std::string message = frame.status == BUSY ? "busy" : PayloadReader(frame.payload).str();
+            throw std::runtime_error("Shard " + endpoint_ + ": " + opcodeName(frame.opcode) + " failed: " + message);
+        }
+
+    private:
+        // After a failed send or recv: report a timeout as the shard failing
+        void throwIfTimedOut() const
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                throw std::runtime_error("Shard " + endpoint_ + " did not answer within " +
+                                         std::to_string(timeout_.count()) + " ms");
+            }
+        }
+
+        std::string endpoint_;
+        std::chrono::milliseconds timeout_;
+        int socket_;
+        std::string requests_;
+        std::string buffer_;
+        uint32_t sent_ = 0;
+        uint32_t received_ = 0;
+    };
+
+    // A payload holding one string
+    std::string stringPayload(const std::string &value)
+    {
+        std::string payload;
+        PayloadWriter(payload).str(value);
+        return payload;
+    }
+
+    // A BUILD_GRAPH payload (vertices >= 0) or a multi-edge ADD_EDGE payload
+    std::string edgesPayload(int vertices, const std::vector<Edge> &edges)
+    {
+        std::string payload;
+        payload.reserve(8 + 12 * edges.size());
+        PayloadWriter writer(payload);
+        if (vertices >= 0)
+        {
+            writer.i32(vertices);
+            writer.i32(static_cast<int32_t>(edges.size()));
+        }
+        for (const Edge &edge : edges)
+        {
+            writer.i32(edge.source);
+            writer.i32(edge.destination);
+            writer.i32(edge.weight);
+        }
+        return payload;
+    }
+
+    // Contiguous vertex ranges of about the same size, counting a vertex as
+    // one plus its degree; range i is [firsts[i], firsts[i + 1])
+    std::vector<int> splitRanges(const Graph &graph, size_t parts)
+    {
+        int vertices = graph.getVertices();
+        long long total = vertices + 2LL * graph.getEdges();
+        std::vector<int> firsts(parts + 1, vertices);
+        firsts[0] = 0;
+        long long seen = 0;
+        size_t part = 1;
+        for (int vertex = 0; vertex < vertices && part < parts; ++vertex)
+        {
+            seen += 1 + static_cast<long long>(graph.degree(vertex));
+            while (part < parts && seen * static_cast<long long>(parts) >= total * static_cast<long long>(part))
+            {
+                firsts[part++] = vertex + 1;
+            }
+        }
+        return firsts;
+    }
+
+    // Run body(i) for every shard on its own thread; rethrow the first failure
+    void forEachShard(size_t shards, const std::function<void(size_t)> &body)
+    {
+        std::vector<std::exception_ptr> errors(shards);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < shards; ++i)
+        {
+            threads.emplace_back([&body, &errors, i]()
+                                 {
+                try
+                {
+                    body(i);
+                }
+                catch (...)
+                {
+                    errors[i] = std::current_exception();
+                } });
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+        for (const std::exception_ptr &error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // Milliseconds elapsed since start
+    double millisSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+// Endpoints of a comma-separated shard list
+std::vector<std::string> cluster::parseShards(const std::string &list)
+{
+    std::vector<std::string> shards;
+    std::istringstream input(list);
+    std::string endpoint;
+    while (std::getline(input, endpoint, ','))
+    {
+        size_t colon = endpoint.rfind(':');
+        if (colon == std::string::npos || colon == 0 || colon + 1 == endpoint.size())
+        {
+            throw std::invalid_argument("Bad shard endpoint '" + endpoint + "' (expected host:port)");
+        }
+        shards.push_back(endpoint);
+    }
+    if (shards.empty())
+    {
+        throw std::invalid_argument("cluster_shards names no shard");
+    }
+    return shards;
+}
+
+// Coordinate the shard servers at these endpoints
+ClusterCoordinator::ClusterCoordinator(const std::vector<std::string> &shards) : shards_(shards)
+{
+}
+
+// Split the graph into vertex ranges, one per shard, and ship every shard the
+// edges inside its range; each shard's thread also collects the cut edges
+// leaving its range upwards, so every edge is looked at once
+ClusterCoordinator::PartitionStats ClusterCoordinator::partition(const std::string &name, const std::shared_ptr<const Graph> &snapshot,
+                                                                 std::chrono::milliseconds timeout)
+{
+    TraceSpan span("cluster_partition");
+    auto start = std::chrono::steady_clock::now();
+    {
+        // The shards' graphs are replaced below; if that fails halfway the old partition is gone too
+        std::lock_guard<std::mutex> lock(mutex_);
+        partitions_.erase(name);
+    }
+    const Graph &graph = *snapshot;
+    auto partition = std::make_shared<Partition>();
+    partition->vertices = graph.getVertices();
+    partition->snapshot = snapshot;
+    partition->firsts = splitRanges(graph, shards_.size());
+
+    std::vector<std::vector<Edge>> cuts(shards_.size());
+    std::vector<long long> shipped(shards_.size(), 0);
+    forEachShard(shards_.size(), [&](size_t i)
+                 {
+        int first = partition->firsts[i];
+        int last = partition->firsts[i + 1];
+        if (first == last)
+        {
+            return;
+        }
+        ShardConnection shard(shards_[i], timeout);
+        shard.request(CREATE_GRAPH, stringPayload(name));
+        shard.request(SELECT_GRAPH, stringPayload(name));
+        std::vector<Frame> opened = shard.responses(); // CREATE_GRAPH fails if the graph is there already
+        shard.check(opened[1]);
+
+        std::vector<Edge> edges;
+        edges.reserve(EDGES_PER_FRAME);
+        bool built = false;
+        auto flush = [&]()
+        {
+            // The first frame replaces the shard's graph, the others add to it
+            shard.request(built ? ADD_EDGE : BUILD_GRAPH, edgesPayload(built ? -1 : last - first, edges));
+            shard.check(shard.responses()[0]);
+            shipped[i] += static_cast<long long>(edges.size());
+            built = true;
+            edges.clear();
+        };
+        for (int vertex = first; vertex < last; ++vertex)
+        {
+            graph.forEachNeighbor(vertex, [&](int destination, int weight)
+                                  {
+                if (destination <= vertex)
+                {
+                    return; // taken from the other end, or a self-loop
+                }
+                if (destination < last)
+                {
+                    edges.push_back(Edge(vertex - first, destination - first, weight));
+                }
+                else
+                {
+                    cuts[i].push_back(Edge(vertex, destination, weight));
+                } });
+            if (edges.size() >= EDGES_PER_FRAME)
+            {
+                flush();
+            }
+        }
+        if (!built || !edges.empty())
+        {
+            flush();
+        } });
+
+    auto cutEdges = std::make_shared<std::vector<Edge>>();
+    PartitionStats stats;
+    for (size_t i = 0; i < shards_.size(); ++i)
+    {
+        cutEdges->insert(cutEdges->end(), cuts[i].begin(), cuts[i].end());
+        stats.shards += partition->firsts[i] < partition->firsts[i + 1];
+        stats.shardEdges += shipped[i];
+    }
+    stats.cutEdges = static_cast<long long>(cutEdges->size());
+    partition->cutEdges = cutEdges;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        partitions_[name] = partition;
+    }
+    stats.millis = millisSince(start);
+    return stats;
+}
+
+// Gather every shard's spanning forest in parallel, then merge them with the
+// cut edges in one Kruskal pass
+ClusterCoordinator::MSTResult ClusterCoordinator::computeMST(const std::string &name, const std::shared_ptr<const Graph> &snapshot,
+                                                             std::chrono::milliseconds timeout)
+{
+    TraceSpan span("cluster_mst");
+    std::shared_ptr<const Partition> partition;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = partitions_.find(name);
+        if (it != partitions_.end())
+        {
+            partition = it->second;
+        }
+    }
+    if (!partition)
+    {
+        throw std::runtime_error("Graph '" + name + "' is not partitioned; run partition_graph first");
+    }
+    if (partition->snapshot.lock() != snapshot)
+    {
+        throw std::runtime_error("Graph '" + name + "' changed since it was partitioned; run partition_graph again");
+    }
+    if (partition->vertices < 2)
+    {
+        throw std::runtime_error("Graph must have at least 2 vertices for MST");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<Edge>> forests(shards_.size());
+    forEachShard(shards_.size(), [&](size_t i)
+                 {
+        int first = partition->firsts[i];
+        int last = partition->firsts[i + 1];
+        if (last - first < 2)
+        {
+            return; // no edge inside a range of one vertex
+        }
+        ShardConnection shard(shards_[i], timeout);
+        shard.request(SELECT_GRAPH, stringPayload(name));
+        shard.request(COMPUTE_MST, stringPayload("kruskal"));
+        std::vector<Frame> frames = shard.responses();
+        shard.check(frames[0]);
+        shard.check(frames[1]);
+        PayloadReader reader(frames[1].payload);
+        int32_t count = reader.i32();
+        if (count < 0 || count >= last - first)
+        {
+            throw std::runtime_error("Shard " + shards_[i] + " holds a different graph '" + name + "'; run partition_graph again");
+        }
+        forests[i].reserve(count);
+        for (int32_t k = 0; k < count; ++k)
+        {
+            int32_t source = reader.i32();
+            int32_t destination = reader.i32();
+            forests[i].push_back(Edge(source + first, destination + first, reader.i32()));
+        } });
+
+    MSTResult result;
+    result.shardMillis = millisSince(start);
+    auto mergeStart = std::chrono::steady_clock::now();
+    std::vector<Edge> candidates;
+    for (const std::vector<Edge> &forest : forests)
+    {
+        result.forestEdges += forest.size();
+    }
+    result.cutEdges = partition->cutEdges->size();
+    candidates.reserve(result.forestEdges + result.cutEdges);
+    for (const std::vector<Edge> &forest : forests)
+    {
+        candidates.insert(candidates.end(), forest.begin(), forest.end());
+    }
+    candidates.insert(candidates.end(), partition->cutEdges->begin(), partition->cutEdges->end());
+    result.edges = KruskalMST::fromEdges(partition->vertices, std::move(candidates));
+    result.mergeMillis = millisSince(mergeStart);
+    return result;
+}
@@ -0,0 +1,83 @@
+#ifndef CLUSTER_HPP
+#define CLUSTER_HPP
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../common/Graph.hpp"
+
+// Minimum spanning trees of graphs partitioned across server processes.
+//
+// A coordinator splits a graph into contiguous vertex ranges holding about
+// the same number of edges, one per shard. Every shard is an ordinary server:
+// it receives the edges with both ends in its range, through the binary
+// protocol, as a graph of the same name whose vertex v - first is the
+// coordinator's vertex v. Edges between ranges (cut edges) stay with the
+// coordinator.
+//
+// For the MST each shard computes the Kruskal forest of its part, all shards
+// at once, and the coordinator runs a last Kruskal over the forests and the
+// cut edges (KruskalMST::fromEdges). An edge a shard's forest leaves out is
+// the last, in KruskalMST::before order, on a cycle of that shard's edges, so
+// no minimum spanning forest of the whole graph has it either: the merge
+// returns exactly what KruskalMST::findMST returns on the whole graph.
+namespace cluster
+{
+    // split "host:port,host:port,..." into endpoints; throws std::invalid_argument
+    std::vector<std::string> parseShards(const std::string &list);
+}
+
+class ClusterCoordinator
+{
+public:
+    struct PartitionStats
+    {
+        size_t shards = 0;         // shards holding at least one vertex
+        long long shardEdges = 0;  // edges shipped to the shards
+        long long cutEdges = 0;    // edges kept by the coordinator
+        double millis = 0;
+    };
+
+    struct MSTResult
+    {
+        std::vector<Edge> edges; // as KruskalMST::findMST returns them
+        size_t forestEdges = 0;  // edges of the shard forests
+        size_t cutEdges = 0;
+        double shardMillis = 0;  // until the last shard answered
+        double mergeMillis = 0;
+    };
+
+    // shards are the binary protocol endpoints ("host:port") of the shard servers
+    explicit ClusterCoordinator(const std::vector<std::string> &shards);
+
+    // Ship a snapshot of the graph to the shards under this name, replacing
+    // the shards' graphs of that name and any earlier partition of it.
+    // Throws std::runtime_error naming the shard that failed; a shard fails
+    // when connecting to it or any send or receive takes longer than timeout.
+    PartitionStats partition(const std::string &name, const std::shared_ptr<const Graph> &graph,
+                             std::chrono::milliseconds timeout);
+    // MST of a partitioned graph whose current snapshot is the one that was
+    // partitioned. Throws std::runtime_error if it was not partitioned, has
+    // changed (or was dropped and created again) since or a shard fails.
+    MSTResult computeMST(const std::string &name, const std::shared_ptr<const Graph> &graph,
+                         std::chrono::milliseconds timeout);
+    const std::vector<std::string> &shards() const { return shards_; }
+
+private:
+    struct Partition
+    {
+        int vertices = 0;
+        std::weak_ptr<const Graph> snapshot; // a new version or a new graph of the name is another snapshot
+        std::vector<int> firsts; // shard i holds vertices [firsts[i], firsts[i + 1])
+        std::shared_ptr<const std::vector<Edge>> cutEdges;
+    };
+
+    std::vector<std::string> shards_;
+    std::mutex mutex_; // guards partitions_
+    std::unordered_map<std::string, std::shared_ptr<const Partition>> partitions_;
+};
+
+#endif // CLUSTER_HPP
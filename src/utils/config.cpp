@@ -0,0 +1,341 @@
+// This file implements ServerConfig: parsing of the server's config file and command-line flags.
+
+#include "config.hpp"
+#include "affinity.hpp"
+#include "cluster.hpp"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+
+namespace
+{
+    std::string trim(const std::string &text)
+    {
+        size_t begin = text.find_first_not_of(" \t\r");
+        if (begin == std::string::npos)
+        {
+            return "";
+        }
+        size_t end = text.find_last_not_of(" \t\r");
+        return text.substr(begin, end - begin + 1);
+    }
+
+    int toInt(const std::string &key, const std::string &value)
+    {
+        try
+        {
+            size_t used = 0;
+            int result = std::stoi(value, &used);
+            if (used == value.size() && result >= 0)
+            {
+                return result;
+            }
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::invalid_argument("Invalid value '" + value + "' for " + key);
+    }
+
+    double toDouble(const std::string &key, const std::string &value)
+    {
+        try
+        {
+            size_t used = 0;
+            double result = std::stod(value, &used);
+            if (used == value.size() && result >= 0)
+            {
+                return result;
+            }
+        }
+        catch (const std::exception &)
+        {
+        }
+        throw std::invalid_argument("Invalid value '" + value + "' for " + key);
+    }
+}
+
+// Set a single option by its config-file key
+void ServerConfig::set(const std::string &key, const std::string &value)
+{
+    if (key == "port")
+    {
+        port = toInt(key, value);
+    }
+    else if (key == "binary_port")
+    {
+        binaryPort = toInt(key, value);
+    }
+    else if (key == "metrics_port")
+    {
+        metricsPort = toInt(key, value);
+    }
+    else if (key == "lock_profile")
+    {
+        lockProfile = toInt(key, value) != 0;
+    }
+    else if (key == "trace_events")
+    {
+        traceEvents = toInt(key, value);
+    }
+    else if (key == "trace_file")
+    {
+        traceFile = value;
+    }
+    else if (key == "unix_socket")
+    {
+        unixSocket = value;
+    }
+    else if (key == "threads")
+    {
+        threads = toInt(key, value);
+    }
+    else if (key == "max_threads")
+    {
+        maxThreads = toInt(key, value);
+    }
+    else if (key == "idle_timeout_ms")
+    {
+        idleTimeoutMs = toInt(key, value);
+    }
+    else if (key == "grow_after_ms")
+    {
+        growAfterMs = toInt(key, value);
+    }
+    else if (key == "queue_capacity")
+    {
+        queueCapacity = toInt(key, value);
+    }
+    else if (key == "queue_deadline_ms")
+    {
+        queueDeadlineMs = toInt(key, value);
+    }
+    else if (key == "command_deadline_ms")
+    {
+        commandDeadlineMs = toInt(key, value);
+    }
+    else if (key == "retry_after_ms")
+    {
+        retryAfterMs = toInt(key, value);
+    }
+    else if (key == "compute_threads")
+    {
+        computeThreads = toInt(key, value);
+    }
+    else if (key == "max_finished_jobs")
+    {
+        maxFinishedJobs = toInt(key, value);
+    }
+    else if (key == "max_active_jobs")
+    {
+        maxActiveJobs = toInt(key, value);
+    }
+    else if (key == "max_vertices")
+    {
+        maxVertices = toInt(key, value);
+    }
+    else if (key == "interactive_cost")
+    {
+        interactiveCost = toDouble(key, value);
+    }
+    else if (key == "heavy_cost")
+    {
+        heavyCost = toDouble(key, value);
+    }
+    else if (key == "fairness_interval")
+    {
+        fairnessInterval = toInt(key, value);
+    }
+    else if (key == "pin")
+    {
+        pin = value;
+    }
+    else if (key == "numa_min_edges")
+    {
+        numaMinEdges = toInt(key, value);
+    }
+    else if (key == "wal_dir")
+    {
+        walDir = value;
+    }
+    else if (key == "wal_sync")
+    {
+        if (value != "commit" && value != "async")
+        {
+            throw std::invalid_argument("Invalid value '" + value + "' for " + key + " (commit or async)");
+        }
+        walSync = value;
+    }
+    else if (key == "wal_group_delay_us")
+    {
+        walGroupDelayUs = toInt(key, value);
+    }
+    else if (key == "scratch_retained_bytes")
+    {
+        scratchRetainedBytes = static_cast<size_t>(toDouble(key, value));
+    }
+    else if (key == "wal_checkpoint_bytes")
+    {
+        walCheckpointBytes = static_cast<size_t>(toDouble(key, value));
+    }
+    else if (key == "replication_port")
+    {
+        replicationPort = toInt(key, value);
+    }
+    else if (key == "replicate_from")
+    {
+        replicateFrom = value;
+    }
+    else if (key == "cluster_shards")
+    {
+        clusterShards = value;
+    }
+    else
+    {
+        throw std::invalid_argument("Unknown option: " + key);
+    }
+}
+
+// Load "key = value" lines from a config file
+void ServerConfig::loadFile(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::invalid_argument("Cannot open config file: " + path);
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+        {
+            throw std::invalid_argument("Malformed config line: " + line);
+        }
+        set(trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+    }
+}
+
+// Fill in values that depend on the machine and keep the limits consistent
+void ServerConfig::applyDefaults()
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (maxThreads == 0)
+    {
+        maxThreads = threads * 4;
+    }
+    maxThreads = std::max(maxThreads, threads);
+    if (computeThreads == 0)
+    {
+        computeThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    // Heavy work may use all compute threads but one (see TaskPool)
+    computeThreads = std::max<size_t>(2, computeThreads);
+    // Validate the pinning mode early (throws on a bad CPU list)
+    affinity::cpuOrder(pin);
+    // A primary ships its log; a follower applies its primary's and keeps none of its own
+    if (replicationPort != 0 && walDir.empty())
+    {
+        throw std::invalid_argument("replication_port needs wal_dir");
+    }
+    if (!replicateFrom.empty() && (!walDir.empty() || replicationPort != 0))
+    {
+        throw std::invalid_argument("replicate_from cannot be combined with wal_dir or replication_port");
+    }
+    // Validate the shard list early (throws on a bad endpoint)
+    if (!clusterShards.empty())
+    {
+        cluster::parseShards(clusterShards);
+    }
+}
+
+// Build the configuration from "--config FILE" and "--key value" flags
+ServerConfig ServerConfig::fromArgs(int argc, char *argv[])
+{
+    ServerConfig config;
+
+    // The config file is applied first so that flags can override it
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--config")
+        {
+            config.loadFile(argv[i + 1]);
+        }
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string flag = argv[i];
+        if (flag.compare(0, 2, "--") != 0 || i + 1 >= argc)
+        {
+            throw std::invalid_argument("Unexpected argument: " + flag);
+        }
+        std::string value = argv[++i];
+        if (flag == "--config")
+        {
+            continue;
+        }
+        std::string key = flag.substr(2);
+        std::replace(key.begin(), key.end(), '-', '_');
+        config.set(key, value);
+    }
+
+    config.applyDefaults();
+    return config;
+}
+
+std::string ServerConfig::usage()
+{
+    return "Usage: server [--config FILE] [--port N] [--binary-port N] [--unix-socket PATH]\n"
+           "              [--metrics-port N] [--lock-profile 0|1]\n"
+           "              [--trace-events N] [--trace-file PATH]\n"
+           "              [--threads N] [--max-threads N]\n"
+           "              [--idle-timeout-ms N] [--grow-after-ms N]\n"
+           "              [--queue-capacity N] [--queue-deadline-ms N]\n"
+           "              [--command-deadline-ms N] [--retry-after-ms N]\n"
+           "              [--compute-threads N] [--max-finished-jobs N] [--max-active-jobs N]\n"
+           "              [--max-vertices N]\n"
+           "              [--interactive-cost X] [--heavy-cost X] [--fairness-interval N]\n"
+           "              [--pin none|compact|scatter|CPU-LIST] [--numa-min-edges N]\n"
+           "              [--scratch-retained-bytes N]\n"
+           "              [--wal-dir DIR] [--wal-sync commit|async]\n"
+           "              [--wal-group-delay-us N] [--wal-checkpoint-bytes N]\n"
+           "              [--replication-port N] [--replicate-from HOST:PORT]\n"
+           "              [--cluster-shards HOST:PORT,HOST:PORT,...]";
+}
+
+std::string ServerConfig::toString() const
+{
+    std::ostringstream oss;
+    oss << "port=" << port << " binary_port=" << binaryPort << " unix_socket=" << (unixSocket.empty() ? "none" : unixSocket)
+        << " metrics_port=" << metricsPort << " lock_profile=" << lockProfile
+        << " trace_events=" << traceEvents
+        << " threads=" << threads << " max_threads=" << maxThreads
+        << " idle_timeout_ms=" << idleTimeoutMs << " grow_after_ms=" << growAfterMs
+        << " queue_capacity=" << queueCapacity << " queue_deadline_ms=" << queueDeadlineMs
+        << " command_deadline_ms=" << commandDeadlineMs << " compute_threads=" << computeThreads
+        << " pin=" << pin << " wal_dir=" << (walDir.empty() ? "none" : walDir);
+    if (replicationPort != 0)
+    {
+        oss << " replication_port=" << replicationPort;
+    }
+    if (!replicateFrom.empty())
+    {
+        oss << " replicate_from=" << replicateFrom;
+    }
+    if (!clusterShards.empty())
+    {
+        oss << " cluster_shards=" << clusterShards;
+    }
+    return oss.str();
+}
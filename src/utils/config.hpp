@@ -0,0 +1,91 @@
+#ifndef CONFIG_HPP
+#define CONFIG_HPP
+
+#include <string>
+#include <cstddef>
+
+// Server settings, read from an optional config file and command-line flags.
+// Config file lines have the form "key = value" ('#' starts a comment);
+// every key can also be given as a flag, e.g. max_threads -> --max-threads.
+// Flags override values from the file.
+struct ServerConfig
+{
+    int port = 9039;
+    // port of the length-prefixed binary protocol (0, the default, disables it)
+    int binaryPort = 0;
+    // path of a Unix domain socket speaking the binary protocol, for clients
+    // on the same host; it also accepts shared-memory bulk transfers (empty disables it)
+    std::string unixSocket;
+    // loopback port serving Prometheus text metrics over HTTP (0, the default, disables it)
+    int metricsPort = 0;
+    // record per-call-site wait and hold times of the queue and graph locks (lock_report)
+    bool lockProfile = false;
+    // spans kept per thread for Chrome trace export (0 disables tracing)
+    size_t traceEvents = 0;
+    // file written by export_trace and, when tracing is on, at shutdown
+    std::string traceFile = "trace.json";
+    // worker threads kept alive when idle (default: hardware_concurrency())
+    size_t threads = 0;
+    // upper bound the pool may grow to under load (default: 4 x threads)
+    size_t maxThreads = 0;
+    // a worker above the minimum exits after being idle this long
+    int idleTimeoutMs = 30000;
+    // work must wait in the queue this long with no idle worker before the pool grows
+    int growAfterMs = 200;
+    // connections that may wait for a free worker; more are refused with BUSY
+    size_t queueCapacity = 64;
+    // a queued connection not picked up within this time is refused with BUSY
+    int queueDeadlineMs = 5000;
+    // a command that cannot get its graph's write lock within this time gets BUSY
+    int commandDeadlineMs = 2000;
+    // retry hint sent with every BUSY reply
+    int retryAfterMs = 1000;
+    // threads of the compute pool that runs submitted MST/metrics jobs
+    // (default: hardware_concurrency(); at least 2, one being kept from Heavy work)
+    size_t computeThreads = 0;
+    // finished job results kept until fetched; the oldest are dropped beyond this
+    size_t maxFinishedJobs = 1024;
+    // jobs pending or running at once; further submissions are answered BUSY
+    size_t maxActiveJobs = 256;
+    // largest vertex count a client may ask a graph to be built with
+    int maxVertices = 1 << 24;
+    // estimated cost (see CommandCost) below which a command runs inline in its session
+    double interactiveCost = 2e5;
+    // estimated cost from which a command or job goes to the Heavy lane
+    double heavyCost = 5e7;
+    // a waiting lower-priority lane is served after being passed over this many times
+    size_t fairnessInterval = 4;
+    // worker pinning: none, compact, scatter or a CPU list such as "0-7,16-23" (see affinity.hpp)
+    std::string pin = "none";
+    // when pinning, graphs built with at least this many edges get their
+    // adjacency lists re-allocated across the pinned CPUs' NUMA nodes
+    int numaMinEdges = 1000000;
+    // directory of the write-ahead mutation log and its checkpoint (empty disables logging)
+    std::string walDir;
+    // commit: a mutation is acknowledged once its log record is on disk;
+    // async: acknowledged at once, synced in the background
+    std::string walSync = "commit";
+    // the log syncer waits this long to gather more commits into each fdatasync
+    int walGroupDelayUs = 0;
+    // scratch arena bytes each worker and compute thread keeps between requests
+    size_t scratchRetainedBytes = 4 * 1024 * 1024;
+    // log bytes since the last checkpoint that trigger a background checkpoint
+    size_t walCheckpointBytes = 64 * 1024 * 1024;
+    // port on which a primary ships its write-ahead log to followers (0 disables; needs wal_dir)
+    int replicationPort = 0;
+    // run as a read-only follower of the primary at host:port (its replication port)
+    std::string replicateFrom;
+    // binary protocol endpoints "host:port,host:port,..." of shard servers;
+    // makes this server the coordinator of partitioned MSTs (see cluster.hpp)
+    std::string clusterShards;
+
+    static ServerConfig fromArgs(int argc, char *argv[]);
+    static std::string usage();
+
+    void set(const std::string &key, const std::string &value);
+    void loadFile(const std::string &path);
+    void applyDefaults();
+    std::string toString() const;
+};
+
+#endif // CONFIG_HPP
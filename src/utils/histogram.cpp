@@ -0,0 +1,146 @@
+// This file implements Histogram, a high dynamic range (HDR) histogram.
+//
+// Layout: bucket 0 covers [0, subBucketCount) with unit width; bucket b > 0
+// covers [subBucketCount << (b - 1), subBucketCount << b) with width 1 << b,
+// of which only the upper half of the sub-buckets is stored (the lower half
+// overlaps the previous bucket).
+
+#include "histogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Number of bits needed to represent value (0 for 0)
+static int bitLength(uint64_t value)
+{
+    int bits = 0;
+    while (value != 0)
+    {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+
+Histogram::Histogram(uint64_t highestValue, int significantDigits)
+    : highestValue_(std::max<uint64_t>(highestValue, 2)), count_(0), min_(std::numeric_limits<uint64_t>::max()), max_(0), sum_(0)
+{
+    // Enough sub-buckets to tell apart values differing in the last kept digit
+    uint64_t largestSingleUnitValue = 2 * static_cast<uint64_t>(std::pow(10.0, significantDigits));
+    int subBucketCountMagnitude = bitLength(largestSingleUnitValue - 1);
+    subBucketHalfCountMagnitude_ = std::max(subBucketCountMagnitude, 1) - 1;
+    uint64_t subBucketCount = 1ULL << (subBucketHalfCountMagnitude_ + 1);
+    subBucketHalfCount_ = subBucketCount / 2;
+    subBucketMask_ = subBucketCount - 1;
+
+    // Buckets until the top one reaches highestValue
+    int bucketCount = 1;
+    uint64_t smallestUntrackable = subBucketCount;
+    while (smallestUntrackable <= highestValue_)
+    {
+        if (smallestUntrackable > std::numeric_limits<uint64_t>::max() / 2)
+        {
+            ++bucketCount;
+            break;
+        }
+        smallestUntrackable <<= 1;
+        ++bucketCount;
+    }
+    counts_.assign((bucketCount + 1) * subBucketHalfCount_, 0);
+}
+
+size_t Histogram::indexOf(uint64_t value) const
+{
+    int bucket = bitLength(value | subBucketMask_) - (subBucketHalfCountMagnitude_ + 1);
+    uint64_t subBucket = value >> bucket;
+    return (static_cast<size_t>(bucket + 1) << subBucketHalfCountMagnitude_) + (subBucket - subBucketHalfCount_);
+}
+
+// Largest value that falls into the counts_ slot at index
+uint64_t Histogram::highestEquivalentValue(size_t index) const
+{
+    int bucket = static_cast<int>(index >> subBucketHalfCountMagnitude_) - 1;
+    uint64_t subBucket = (index & (subBucketHalfCount_ - 1)) + subBucketHalfCount_;
+    if (bucket < 0)
+    {
+        subBucket -= subBucketHalfCount_;
+        bucket = 0;
+    }
+    return (subBucket << bucket) + ((1ULL << bucket) - 1);
+}
+
+void Histogram::record(uint64_t value)
+{
+    value = std::min(value, highestValue_);
+    ++counts_[indexOf(value)];
+    ++count_;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value);
+}
+
+size_t Histogram::slotOf(uint64_t value) const
+{
+    return indexOf(std::min(value, highestValue_));
+}
+
+void Histogram::recordSlot(size_t slot, uint64_t count)
+{
+    if (count == 0 || slot >= counts_.size())
+    {
+        return;
+    }
+    uint64_t value = highestEquivalentValue(slot);
+    counts_[slot] += count;
+    count_ += count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    sum_ += static_cast<double>(value) * count;
+}
+
+// Add another histogram's samples; both must have the same range and precision
+void Histogram::merge(const Histogram &other)
+{
+    for (size_t i = 0; i < counts_.size() && i < other.counts_.size(); ++i)
+    {
+        counts_[i] += other.counts_[i];
+    }
+    count_ += other.count_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    sum_ += other.sum_;
+}
+
+void Histogram::reset()
+{
+    std::fill(counts_.begin(), counts_.end(), 0);
+    count_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+    sum_ = 0;
+}
+
+double Histogram::mean() const
+{
+    return count_ ? sum_ / count_ : 0.0;
+}
+
+uint64_t Histogram::valueAtPercentile(double percentile) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i)
+    {
+        seen += counts_[i];
+        if (seen >= target)
+        {
+            return std::min(highestEquivalentValue(i), max_);
+        }
+    }
+    return max_;
+}
@@ -0,0 +1,53 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <cstdint>
+#include <vector>
+#include <cstddef>
+
+// High dynamic range histogram of non-negative integer values (latencies).
+// Values are grouped in buckets whose width doubles with each power of two,
+// with enough sub-buckets per power that every recorded value is kept to a
+// fixed number of significant decimal digits. Memory is fixed at construction
+// and recording is O(1), so a histogram can take millions of samples.
+// Not thread-safe: record into one histogram per thread and merge() them.
+class Histogram
+{
+public:
+    // values above highestValue are recorded as highestValue
+    explicit Histogram(uint64_t highestValue = 3600ULL * 1000 * 1000, int significantDigits = 3);
+
+    void record(uint64_t value);
+    void merge(const Histogram &other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const;
+    // smallest recorded value (to the histogram's precision) that percentile % of values do not exceed
+    uint64_t valueAtPercentile(double percentile) const;
+
+    // Bucket layout, for recorders that keep their own (e.g. atomic) counts
+    // and fold them into a Histogram when read
+    size_t slots() const { return counts_.size(); }
+    size_t slotOf(uint64_t value) const;
+    // add count samples valued at the top of slot's range
+    void recordSlot(size_t slot, uint64_t count);
+
+private:
+    size_t indexOf(uint64_t value) const;
+    uint64_t highestEquivalentValue(size_t index) const;
+
+    uint64_t highestValue_;
+    int subBucketHalfCountMagnitude_;
+    uint64_t subBucketHalfCount_;
+    uint64_t subBucketMask_;
+    std::vector<uint64_t> counts_;
+    uint64_t count_;
+    uint64_t min_;
+    uint64_t max_;
+    double sum_;
+};
+
+#endif // HISTOGRAM_HPP
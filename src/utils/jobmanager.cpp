@@ -0,0 +1,116 @@
+// This file implements JobManager, which tracks asynchronous jobs running on the compute pool.
+
+#include "jobmanager.hpp"
+
+JobManager::JobManager(TaskPool &pool, size_t maxFinished, size_t maxActive)
+    : nextId(1), rejectedCount(0), active(0), maxFinished(maxFinished), maxActive(maxActive), pool(pool) {}
+
+uint64_t JobManager::submit(const std::string &description, CostClass costClass, std::function<std::string()> work)
+{
+    auto job = std::make_shared<Job>();
+    job->description = description;
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (active >= maxActive)
+        {
+            rejectedCount.fetch_add(1, std::memory_order_relaxed);
+            throw JobsFullError(maxActive);
+        }
+        ++active;
+        id = nextId++;
+        jobs[id] = job;
+    }
+
+    pool.submit([this, id, job, work]()
+                {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job->state = State::Running;
+        }
+        try
+        {
+            finish(id, State::Done, work());
+        }
+        catch (const std::exception &e)
+        {
+            finish(id, State::Failed, e.what());
+        } }, costClass);
+    return id;
+}
+
+// Store a job's outcome and drop the oldest unfetched results beyond the limit
+void JobManager::finish(uint64_t id, State state, std::string result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    --active;
+    auto it = jobs.find(id);
+    if (it == jobs.end())
+    {
+        return;
+    }
+    it->second->state = state;
+    it->second->result = std::move(result);
+    finishedOrder.push_back(id);
+
+    while (finishedOrder.size() > maxFinished)
+    {
+        jobs.erase(finishedOrder.front());
+        finishedOrder.pop_front();
+    }
+}
+
+JobManager::State JobManager::poll(uint64_t id, std::string &description)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    if (it == jobs.end())
+    {
+        return State::Unknown;
+    }
+    description = it->second->description;
+    return it->second->state;
+}
+
+// A finished job is removed once fetched
+JobManager::State JobManager::fetch(uint64_t id, std::string &result)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = jobs.find(id);
+    if (it == jobs.end())
+    {
+        return State::Unknown;
+    }
+    State state = it->second->state;
+    if (state == State::Done || state == State::Failed)
+    {
+        result = std::move(it->second->result);
+        jobs.erase(it);
+        for (auto order = finishedOrder.begin(); order != finishedOrder.end(); ++order)
+        {
+            if (*order == id)
+            {
+                finishedOrder.erase(order);
+                break;
+            }
+        }
+    }
+    return state;
+}
+
+std::string JobManager::stateName(State state)
+{
+    switch (state)
+    {
+    case State::Pending:
+        return "pending";
+    case State::Running:
+        return "running";
+    case State::Done:
+        return "done";
+    case State::Failed:
+        return "failed";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef JOBMANAGER_HPP
+#define JOBMANAGER_HPP
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+#include "taskpool.hpp"
+
+// Thrown when a job is submitted while the most jobs allowed are pending or running
+class JobsFullError : public std::runtime_error
+{
+public:
+    explicit JobsFullError(size_t maxActive)
+        : std::runtime_error("Too many jobs pending or running (max_active_jobs " + std::to_string(maxActive) + ")") {}
+};
+
+// Runs submitted jobs on the compute TaskPool and keeps their results until
+// a client fetches them. Jobs are identified by a numeric ID handed out at
+// submission, so the submitting session never waits for the work itself.
+class JobManager
+{
+public:
+    enum class State
+    {
+        Pending,
+        Running,
+        Done,
+        Failed,
+        Unknown
+    };
+
+    // maxFinished bounds how many unfetched results are kept; the oldest are dropped first.
+    // maxActive bounds how many jobs may be pending or running at once.
+    JobManager(TaskPool &pool, size_t maxFinished, size_t maxActive);
+
+    // queue a job in the lane of its cost class, returns its ID; throws
+    // JobsFullError when maxActive jobs are already pending or running
+    uint64_t submit(const std::string &description, CostClass costClass, std::function<std::string()> work);
+    // get the state and description of a job (Unknown for IDs never issued or already fetched)
+    State poll(uint64_t id, std::string &description);
+    // take the result (or error message) of a finished job; returns the job's state
+    State fetch(uint64_t id, std::string &result);
+
+    static std::string stateName(State state);
+    // submissions refused with JobsFullError
+    uint64_t rejected() const { return rejectedCount.load(std::memory_order_relaxed); }
+
+private:
+    struct Job
+    {
+        std::string description;
+        State state = State::Pending;
+        std::string result;
+    };
+
+    void finish(uint64_t id, State state, std::string result);
+
+    std::mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Job>> jobs;
+    std::deque<uint64_t> finishedOrder;
+    std::atomic<uint64_t> nextId;
+    std::atomic<uint64_t> rejectedCount;
+    size_t active; // pending or running jobs, guarded by mutex
+    size_t maxFinished;
+    size_t maxActive;
+    TaskPool &pool;
+};
+
+#endif // JOBMANAGER_HPP
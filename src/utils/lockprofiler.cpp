@@ -0,0 +1,129 @@
+// This file implements the lock contention profiler's sites and report.
+
+#include "lockprofiler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    std::atomic<bool> profiling(false);
+    // every site ever created; sites are static objects, so the list is append-only
+    std::atomic<LockSite *> sites(nullptr);
+
+    void updateMax(std::atomic<uint64_t> &maximum, uint64_t value)
+    {
+        uint64_t current = maximum.load(std::memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+LockSite::LockSite(const char *file, int line)
+    : file(file), line(line), mutexName(nullptr), acquisitions(0), contended(0),
+      waitNs(0), maxWaitNs(0), holdNs(0), maxHoldNs(0), next(nullptr)
+{
+    // Only the file name, not the build's path to it
+    const char *slash = std::strrchr(file, '/');
+    this->file = slash ? slash + 1 : file;
+
+    LockSite *head = sites.load(std::memory_order_relaxed);
+    do
+    {
+        next = head;
+    } while (!sites.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void LockSite::recordAcquire(const char *name, bool wasContended, uint64_t waited)
+{
+    mutexName.store(name, std::memory_order_relaxed);
+    acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (wasContended)
+    {
+        contended.fetch_add(1, std::memory_order_relaxed);
+        waitNs.fetch_add(waited, std::memory_order_relaxed);
+        updateMax(maxWaitNs, waited);
+    }
+}
+
+void LockSite::recordHold(uint64_t held)
+{
+    holdNs.fetch_add(held, std::memory_order_relaxed);
+    updateMax(maxHoldNs, held);
+}
+
+namespace lockprofiler
+{
+    void setEnabled(bool enabled)
+    {
+        profiling.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool enabled()
+    {
+        return profiling.load(std::memory_order_relaxed);
+    }
+
+    uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    void reset()
+    {
+        for (LockSite *site = sites.load(std::memory_order_acquire); site; site = site->next)
+        {
+            site->acquisitions = 0;
+            site->contended = 0;
+            site->waitNs = 0;
+            site->maxWaitNs = 0;
+            site->holdNs = 0;
+            site->maxHoldNs = 0;
+        }
+    }
+
+    std::string report()
+    {
+        std::vector<LockSite *> used;
+        for (LockSite *site = sites.load(std::memory_order_acquire); site; site = site->next)
+        {
+            if (site->acquisitions.load(std::memory_order_relaxed) > 0)
+            {
+                used.push_back(site);
+            }
+        }
+        // Ties (typically uncontended sites) are ranked by total hold time
+        std::sort(used.begin(), used.end(), [](const LockSite *a, const LockSite *b)
+                  {
+                      uint64_t waitA = a->waitNs.load(), waitB = b->waitNs.load();
+                      return waitA != waitB ? waitA > waitB : a->holdNs.load() > b->holdNs.load(); });
+
+        std::string out = enabled() ? "Lock profile (recording), ranked by total wait:\n"
+                                    : "Lock profile (not recording; enable with --lock-profile 1), ranked by total wait:\n";
+        char line[512];
+        std::snprintf(line, sizeof(line), "%-28s %-30s %12s %10s %7s %12s %11s %11s %11s\n",
+                      "site", "mutex", "acquired", "contended", "cont%", "wait_ms", "max_wait_us", "avg_hold_us", "max_hold_us");
+        out += line;
+        for (const LockSite *site : used)
+        {
+            uint64_t acquisitions = site->acquisitions.load(std::memory_order_relaxed);
+            uint64_t contended = site->contended.load(std::memory_order_relaxed);
+            const char *mutexName = site->mutexName.load(std::memory_order_relaxed);
+            std::string where = std::string(site->file) + ":" + std::to_string(site->line);
+            std::snprintf(line, sizeof(line), "%-28s %-30s %12llu %10llu %6.1f%% %12.3f %11.1f %11.2f %11.1f\n",
+                          where.c_str(), mutexName ? mutexName : "?",
+                          static_cast<unsigned long long>(acquisitions), static_cast<unsigned long long>(contended),
+                          100.0 * contended / acquisitions,
+                          site->waitNs.load(std::memory_order_relaxed) / 1e6,
+                          site->maxWaitNs.load(std::memory_order_relaxed) / 1e3,
+                          site->holdNs.load(std::memory_order_relaxed) / 1e3 / acquisitions,
+                          site->maxHoldNs.load(std::memory_order_relaxed) / 1e3);
+            out += line;
+        }
+        return out;
+    }
+}
@@ -0,0 +1,179 @@
+#ifndef LOCKPROFILER_HPP
+#define LOCKPROFILER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Lock contention profiling.
+//
+// A ProfiledMutex is locked through a ProfiledLock naming its call site
+// (LOCK_SITE()). While profiling is enabled, each acquisition records at its
+// site whether it had to wait, how long it waited and how long the lock was
+// then held. While disabled, locking costs one relaxed atomic load more than
+// the plain mutex, so the wrappers stay compiled into production builds.
+//
+//   ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+
+// Statistics of one place in the code that takes a lock
+class LockSite
+{
+public:
+    LockSite(const char *file, int line);
+
+    void recordAcquire(const char *mutexName, bool contended, uint64_t waitNs);
+    void recordHold(uint64_t holdNs);
+
+    const char *file;
+    int line;
+    std::atomic<const char *> mutexName;
+    std::atomic<uint64_t> acquisitions;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> waitNs;
+    std::atomic<uint64_t> maxWaitNs;
+    std::atomic<uint64_t> holdNs;
+    std::atomic<uint64_t> maxHoldNs;
+    LockSite *next; // registry list, newest first
+};
+
+// The site of the code where the macro is written, created on first use
+#define LOCK_SITE() ([]() -> LockSite & { static LockSite site(__FILE__, __LINE__); return site; }())
+
+namespace lockprofiler
+{
+    // start or stop recording (off by default)
+    void setEnabled(bool enabled);
+    bool enabled();
+    // sites ranked by total wait time, one line each
+    std::string report();
+    // zero every site's statistics
+    void reset();
+    uint64_t nowNs();
+}
+
+// A mutex that reports to LockSites while profiling is enabled.
+// Mutex is std::mutex or std::timed_mutex.
+template <typename Mutex>
+class BasicProfiledMutex
+{
+public:
+    explicit BasicProfiledMutex(const char *name) : name_(name), lockedAt_(0), holder_(nullptr) {}
+    BasicProfiledMutex(const BasicProfiledMutex &) = delete;
+    BasicProfiledMutex &operator=(const BasicProfiledMutex &) = delete;
+
+    void lock(LockSite &site)
+    {
+        if (!lockprofiler::enabled())
+        {
+            mutex_.lock();
+            return;
+        }
+        bool contended = !mutex_.try_lock();
+        uint64_t start = lockprofiler::nowNs();
+        if (contended)
+        {
+            mutex_.lock();
+        }
+        acquired(site, contended, start);
+    }
+
+    template <typename Rep, typename Period>
+    bool tryLockFor(LockSite &site, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!lockprofiler::enabled())
+        {
+            return mutex_.try_lock_for(timeout);
+        }
+        bool contended = !mutex_.try_lock();
+        uint64_t start = lockprofiler::nowNs();
+        if (contended && !mutex_.try_lock_for(timeout))
+        {
+            // a timed-out wait still counts as contention
+            site.recordAcquire(name_, true, lockprofiler::nowNs() - start);
+            return false;
+        }
+        acquired(site, contended, start);
+        return true;
+    }
+
+    void unlock()
+    {
+        // lockedAt_ is only set by an acquisition made while profiling
+        if (lockedAt_ != 0)
+        {
+            holder_->recordHold(lockprofiler::nowNs() - lockedAt_);
+            lockedAt_ = 0;
+        }
+        mutex_.unlock();
+    }
+
+private:
+    void acquired(LockSite &site, bool contended, uint64_t start)
+    {
+        uint64_t now = lockprofiler::nowNs();
+        site.recordAcquire(name_, contended, contended ? now - start : 0);
+        lockedAt_ = now;
+        holder_ = &site;
+    }
+
+    Mutex mutex_;
+    const char *name_;
+    // owner's acquisition time and site, written only while the mutex is held
+    uint64_t lockedAt_;
+    LockSite *holder_;
+};
+
+using ProfiledMutex = BasicProfiledMutex<std::mutex>;
+using ProfiledTimedMutex = BasicProfiledMutex<std::timed_mutex>;
+
+// unique_lock counterpart for profiled mutexes. It also works with
+// std::condition_variable_any, whose waits unlock and relock it.
+template <typename ProfiledMutexType>
+class ProfiledLock
+{
+public:
+    ProfiledLock(ProfiledMutexType &mutex, LockSite &site) : mutex_(mutex), site_(site), owns_(false)
+    {
+        lock();
+    }
+    ProfiledLock(ProfiledMutexType &mutex, LockSite &site, std::defer_lock_t) : mutex_(mutex), site_(site), owns_(false) {}
+    ~ProfiledLock()
+    {
+        if (owns_)
+        {
+            unlock();
+        }
+    }
+    ProfiledLock(const ProfiledLock &) = delete;
+    ProfiledLock &operator=(const ProfiledLock &) = delete;
+
+    void lock()
+    {
+        mutex_.lock(site_);
+        owns_ = true;
+    }
+
+    template <typename Rep, typename Period>
+    bool tryLockFor(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        owns_ = mutex_.tryLockFor(site_, timeout);
+        return owns_;
+    }
+
+    void unlock()
+    {
+        mutex_.unlock();
+        owns_ = false;
+    }
+
+    bool owns_lock() const { return owns_; }
+
+private:
+    ProfiledMutexType &mutex_;
+    LockSite &site_;
+    bool owns_;
+};
+
+#endif // LOCKPROFILER_HPP
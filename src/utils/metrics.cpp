@@ -0,0 +1,280 @@
+// This file implements Metrics, the per-thread sharded counters and histograms.
+
+#include "metrics.hpp"
+#include <iomanip>
+#include <sstream>
+
+const size_t Metrics::MAX_SERIES;
+const size_t Metrics::NO_SERIES;
+
+// Gives each thread a shard and hands it back when the thread exits, so a
+// pool that keeps replacing threads does not keep growing the shard list.
+// Values recorded into a returned shard stay in the totals.
+struct ShardHandle
+{
+    Metrics::Shard *shard = nullptr;
+
+    ~ShardHandle()
+    {
+        if (shard)
+        {
+            Metrics::global().releaseShard(shard);
+        }
+    }
+};
+
+namespace
+{
+    thread_local ShardHandle localHandle;
+
+    const double PERCENTILES[] = {50, 90, 99, 99.9};
+    const char *const PERCENTILE_NAMES[] = {"p50", "p90", "p99", "p999"};
+    const char *const QUANTILE_LABELS[] = {"quantile=\"0.5\"", "quantile=\"0.9\"", "quantile=\"0.99\"", "quantile=\"0.999\""};
+
+    // "name{labels}" or "name" without labels
+    std::string seriesKey(const std::string &name, const std::string &labels)
+    {
+        return labels.empty() ? name : name + "{" + labels + "}";
+    }
+
+    // labels with one more label appended
+    std::string withLabel(const std::string &labels, const std::string &label)
+    {
+        return labels.empty() ? label : labels + "," + label;
+    }
+}
+
+Metrics::Shard::Shard()
+{
+    for (size_t i = 0; i < MAX_SERIES; ++i)
+    {
+        buckets[i].store(nullptr, std::memory_order_relaxed);
+        sums[i].store(0, std::memory_order_relaxed);
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+Metrics &Metrics::global()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Metrics() : layout_(3600ULL * 1000 * 1000, 2) {}
+
+Metrics::Timer::~Timer()
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_);
+    Metrics::global().record(id_, static_cast<uint64_t>(elapsed.count()));
+}
+
+size_t Metrics::histogram(const std::string &name, const std::string &labels, const std::string &help)
+{
+    return registerSeries(Kind::Histogram, name, labels, help);
+}
+
+size_t Metrics::counter(const std::string &name, const std::string &labels, const std::string &help)
+{
+    return registerSeries(Kind::Counter, name, labels, help);
+}
+
+size_t Metrics::registerSeries(Kind kind, const std::string &name, const std::string &labels, const std::string &help)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string key = seriesKey(name, labels);
+    auto it = ids_.find(key);
+    if (it != ids_.end())
+    {
+        return it->second;
+    }
+    if (series_.size() >= MAX_SERIES)
+    {
+        return NO_SERIES;
+    }
+    series_.push_back({kind, name, labels, help});
+    ids_[key] = series_.size() - 1;
+    return series_.size() - 1;
+}
+
+Metrics::Shard &Metrics::localShard()
+{
+    if (!localHandle.shard)
+    {
+        localHandle.shard = acquireShard();
+    }
+    return *localHandle.shard;
+}
+
+Metrics::Shard *Metrics::acquireShard()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!freeShards_.empty())
+    {
+        Shard *shard = freeShards_.back();
+        freeShards_.pop_back();
+        return shard;
+    }
+    shards_.emplace_back(new Shard());
+    return shards_.back().get();
+}
+
+void Metrics::releaseShard(Shard *shard)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    freeShards_.push_back(shard);
+}
+
+void Metrics::record(size_t id, uint64_t value)
+{
+    if (id >= MAX_SERIES)
+    {
+        return;
+    }
+    Shard &shard = localShard();
+    std::atomic<uint64_t> *buckets = shard.buckets[id].load(std::memory_order_acquire);
+    if (!buckets)
+    {
+        // First sample of this series on this thread
+        buckets = new std::atomic<uint64_t>[layout_.slots()];
+        for (size_t i = 0; i < layout_.slots(); ++i)
+        {
+            buckets[i].store(0, std::memory_order_relaxed);
+        }
+        shard.buckets[id].store(buckets, std::memory_order_release);
+    }
+    buckets[layout_.slotOf(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sums[id].fetch_add(value, std::memory_order_relaxed);
+}
+
+void Metrics::add(size_t id, uint64_t delta)
+{
+    if (id < MAX_SERIES)
+    {
+        localShard().counters[id].fetch_add(delta, std::memory_order_relaxed);
+    }
+}
+
+Histogram Metrics::collectHistogram(size_t id, uint64_t &sum) const
+{
+    Histogram total(3600ULL * 1000 * 1000, 2);
+    sum = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<Shard> &shard : shards_)
+    {
+        const std::atomic<uint64_t> *buckets = shard->buckets[id].load(std::memory_order_acquire);
+        if (!buckets)
+        {
+            continue;
+        }
+        for (size_t slot = 0; slot < layout_.slots(); ++slot)
+        {
+            total.recordSlot(slot, buckets[slot].load(std::memory_order_relaxed));
+        }
+        sum += shard->sums[id].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+uint64_t Metrics::collectCounter(size_t id) const
+{
+    uint64_t total = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const std::unique_ptr<Shard> &shard : shards_)
+    {
+        total += shard->counters[id].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::vector<Metrics::Series> Metrics::seriesList() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return series_;
+}
+
+std::string Metrics::renderText(const std::vector<Gauge> &gauges) const
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    for (const Gauge &gauge : gauges)
+    {
+        out << gauge.name << " " << gauge.value << "\n";
+    }
+    std::vector<Series> series = seriesList();
+    for (size_t id = 0; id < series.size(); ++id)
+    {
+        std::string key = seriesKey(series[id].name, series[id].labels);
+        if (series[id].kind == Kind::Counter)
+        {
+            out << key << " " << collectCounter(id) << "\n";
+            continue;
+        }
+        uint64_t sum = 0;
+        Histogram histogram = collectHistogram(id, sum);
+        if (histogram.count() == 0)
+        {
+            continue;
+        }
+        out << key << " count=" << histogram.count()
+            << " mean=" << static_cast<double>(sum) / histogram.count();
+        for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); ++i)
+        {
+            out << " " << PERCENTILE_NAMES[i] << "=" << histogram.valueAtPercentile(PERCENTILES[i]);
+        }
+        out << " max=" << histogram.max() << "\n";
+    }
+    return out.str();
+}
+
+std::string Metrics::renderPrometheus(const std::vector<Gauge> &gauges) const
+{
+    std::ostringstream out;
+    for (const Gauge &gauge : gauges)
+    {
+        out << "# HELP " << gauge.name << " " << gauge.help << "\n"
+            << "# TYPE " << gauge.name << (gauge.monotonic ? " counter\n" : " gauge\n")
+            << gauge.name << " " << gauge.value << "\n";
+    }
+
+    // Series of one name are written together under a single HELP/TYPE header
+    std::vector<Series> series = seriesList();
+    std::vector<bool> written(series.size(), false);
+    for (size_t first = 0; first < series.size(); ++first)
+    {
+        if (written[first])
+        {
+            continue;
+        }
+        bool counter = series[first].kind == Kind::Counter;
+        out << "# HELP " << series[first].name << " " << series[first].help << "\n"
+            << "# TYPE " << series[first].name << (counter ? " counter" : " summary") << "\n";
+        for (size_t id = first; id < series.size(); ++id)
+        {
+            if (written[id] || series[id].name != series[first].name)
+            {
+                continue;
+            }
+            written[id] = true;
+            const std::string &name = series[id].name;
+            const std::string &labels = series[id].labels;
+            if (counter)
+            {
+                out << seriesKey(name, labels) << " " << collectCounter(id) << "\n";
+                continue;
+            }
+            uint64_t sum = 0;
+            Histogram histogram = collectHistogram(id, sum);
+            if (histogram.count() == 0)
+            {
+                continue;
+            }
+            for (size_t i = 0; i < sizeof(PERCENTILES) / sizeof(PERCENTILES[0]); ++i)
+            {
+                out << seriesKey(name, withLabel(labels, QUANTILE_LABELS[i])) << " " << histogram.valueAtPercentile(PERCENTILES[i]) << "\n";
+            }
+            out << seriesKey(name + "_sum", labels) << " " << sum << "\n"
+                << seriesKey(name + "_count", labels) << " " << histogram.count() << "\n";
+        }
+    }
+    return out.str();
+}
@@ -0,0 +1,117 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "histogram.hpp"
+
+// Process-wide server instrumentation: counters and latency histograms.
+//
+// Every thread records into its own shard, so the hot path is a relaxed
+// atomic add on a cache line no other thread writes: no locks and no shared
+// counters. Shards are only summed when a report is requested (the `stats`
+// command or a Prometheus scrape). A series is registered once by name and
+// labels and then addressed by its ID, which call sites keep in a static.
+class Metrics
+{
+public:
+    // series beyond this are not registered (their records are dropped)
+    static const size_t MAX_SERIES = 256;
+    static const size_t NO_SERIES = MAX_SERIES;
+
+    // process-wide instance
+    static Metrics &global();
+
+    // ID of a histogram (of microseconds) or counter series, registering it on
+    // first use. labels is in Prometheus form without braces, e.g. command="add_edge".
+    size_t histogram(const std::string &name, const std::string &labels = "", const std::string &help = "");
+    size_t counter(const std::string &name, const std::string &labels = "", const std::string &help = "");
+
+    void record(size_t id, uint64_t value);
+    void add(size_t id, uint64_t delta = 1);
+
+    // A value read at report time (queue depth, active sessions, ...)
+    struct Gauge
+    {
+        std::string name;
+        std::string help;
+        double value;
+        bool monotonic; // a running total kept elsewhere, exported as a counter
+    };
+
+    // human-readable report: gauges, counters and per-series percentiles
+    std::string renderText(const std::vector<Gauge> &gauges) const;
+    // Prometheus text exposition format (version 0.0.4)
+    std::string renderPrometheus(const std::vector<Gauge> &gauges) const;
+
+    // Records the time from construction to destruction into a histogram
+    class Timer
+    {
+    public:
+        explicit Timer(size_t id) : id_(id), start_(std::chrono::steady_clock::now()) {}
+        ~Timer();
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+    private:
+        size_t id_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+private:
+    enum class Kind
+    {
+        Histogram,
+        Counter
+    };
+
+    struct Series
+    {
+        Kind kind;
+        std::string name;
+        std::string labels;
+        std::string help;
+    };
+
+    // One thread's values. Only the owning thread writes; readers sum all shards.
+    struct Shard
+    {
+        Shard();
+        // per histogram series: bucket counts in the layout of Metrics::layout_,
+        // allocated by the owner on first use
+        std::atomic<std::atomic<uint64_t> *> buckets[MAX_SERIES];
+        std::atomic<uint64_t> sums[MAX_SERIES];
+        // per counter series
+        std::atomic<uint64_t> counters[MAX_SERIES];
+    };
+
+    Metrics();
+    size_t registerSeries(Kind kind, const std::string &name, const std::string &labels, const std::string &help);
+    Shard &localShard();
+    // take a shard for a new thread, reusing those of exited threads
+    Shard *acquireShard();
+    void releaseShard(Shard *shard);
+    // sum of one histogram series over all shards
+    Histogram collectHistogram(size_t id, uint64_t &sum) const;
+    uint64_t collectCounter(size_t id) const;
+    std::vector<Series> seriesList() const;
+
+    // bucket layout shared by every histogram (1 hour range, 2 significant digits)
+    const Histogram layout_;
+    mutable std::mutex mutex_;
+    std::vector<Series> series_;
+    std::unordered_map<std::string, size_t> ids_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::vector<Shard *> freeShards_;
+
+    friend struct ShardHandle;
+};
+
+#endif // METRICS_HPP
@@ -0,0 +1,131 @@
+// This file implements OutputBuffer, the per-session write buffer.
+
+#include "outputbuffer.hpp"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <climits>
+#include <cerrno>
+
+OutputBuffer::OutputBuffer() : used_(0), tailOpen_(false) {}
+
+// Get the segment small writes go to, opening a spare one if needed
+std::string &OutputBuffer::tail()
+{
+    if (!tailOpen_)
+    {
+        if (used_ == segments_.size())
+        {
+            segments_.emplace_back();
+        }
+        ++used_;
+        tailOpen_ = true;
+    }
+    return segments_[used_ - 1];
+}
+
+void OutputBuffer::append(const char *data, size_t size)
+{
+    tail().append(data, size);
+}
+
+void OutputBuffer::append(const std::string &data)
+{
+    tail().append(data);
+}
+
+// Move a large string in as its own segment; small ones are copied as usual
+void OutputBuffer::append(std::string &&data)
+{
+    if (data.size() < OWN_SEGMENT_SIZE)
+    {
+        tail().append(data);
+        return;
+    }
+    if (used_ == segments_.size())
+    {
+        segments_.emplace_back();
+    }
+    segments_[used_++].swap(data);
+    tailOpen_ = false;
+}
+
+size_t OutputBuffer::size() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < used_; ++i)
+    {
+        total += segments_[i].size();
+    }
+    return total;
+}
+
+// Send all segments, resuming after short writes, then reset for reuse
+bool OutputBuffer::flush(int socket, bool more)
+{
+    size_t first = 0;  // first segment not fully sent
+    size_t offset = 0; // bytes of it already sent
+    bool ok = true;
+    while (ok)
+    {
+        while (first < used_ && offset == segments_[first].size())
+        {
+            ++first;
+            offset = 0;
+        }
+        if (first == used_)
+        {
+            break;
+        }
+
+        iovec iov[IOV_MAX < 64 ? IOV_MAX : 64];
+        size_t count = 0;
+        for (size_t i = first; i < used_ && count < sizeof(iov) / sizeof(iov[0]); ++i)
+        {
+            size_t skip = i == first ? offset : 0;
+            iov[count].iov_base = const_cast<char *>(segments_[i].data()) + skip;
+            iov[count].iov_len = segments_[i].size() - skip;
+            ++count;
+        }
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(socket, &message, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            ok = false;
+            break;
+        }
+
+        // Advance past what the kernel took
+        size_t remaining = static_cast<size_t>(sent);
+        while (remaining > 0)
+        {
+            size_t left = segments_[first].size() - offset;
+            if (remaining < left)
+            {
+                offset += remaining;
+                break;
+            }
+            remaining -= left;
+            ++first;
+            offset = 0;
+        }
+    }
+
+    // Keep the segments' memory for the next command, except unusually large blocks
+    for (size_t i = 0; i < used_; ++i)
+    {
+        if (segments_[i].capacity() > MAX_KEPT_CAPACITY)
+        {
+            std::string().swap(segments_[i]);
+        }
+        segments_[i].clear();
+    }
+    used_ = 0;
+    tailOpen_ = false;
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef OUTPUTBUFFER_HPP
+#define OUTPUTBUFFER_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Collects everything a session writes between two reads and sends it with as
+// few syscalls as possible. Small writes are copied into reusable segments;
+// large ones are moved in as segments of their own, so they are never copied.
+// flush() hands all segments to the kernel with one scatter-gather sendmsg(),
+// looping on short writes. Segment memory is kept across flushes.
+class OutputBuffer
+{
+public:
+    // strings at least this long are moved into their own segment rather than copied
+    static const size_t OWN_SEGMENT_SIZE = 64 * 1024;
+
+    OutputBuffer();
+
+    void append(const char *data, size_t size);
+    void append(const std::string &data);
+    void append(std::string &&data);
+    // the segment small writes go to, for encoders that append in place
+    std::string &tail();
+
+    size_t size() const;
+    bool empty() const { return size() == 0; }
+
+    // send everything buffered; returns false if the peer is gone.
+    // more = true tells the kernel more data follows at once (MSG_MORE), so a
+    // partly filled segment may be held back instead of sent on its own
+    bool flush(int socket, bool more = false);
+
+private:
+    static const size_t MAX_KEPT_CAPACITY = 1024 * 1024;
+
+    std::vector<std::string> segments_;
+    size_t used_;     // segments holding data, the rest are spare
+    bool tailOpen_;   // whether the last used segment takes small writes
+};
+
+#endif // OUTPUTBUFFER_HPP
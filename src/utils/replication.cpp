@@ -0,0 +1,536 @@
+#include "replication.hpp"
+#include "threadpool.hpp"
+#include "tracing.hpp"
+#include "../common/Protocol.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <netdb.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// This file implements log shipping: the primary's ReplicationSource and the
+// follower's ReplicaClient.
+
+using protocol::PayloadReader;
+using protocol::PayloadWriter;
+
+namespace
+{
+    // Send the whole buffer; false once the peer is gone
+    bool sendAll(int socket, const std::string &data)
+    {
+        size_t sent = 0;
+        while (sent < data.size())
+        {
+            ssize_t count = ::send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (count <= 0)
+            {
+                return false;
+            }
+            sent += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    // Send one message, split into frames of at most CHUNK_SIZE
+    bool sendMessage(int socket, uint8_t message, const std::string &payload)
+    {
+        size_t offset = 0;
+        do
+        {
+            size_t size = std::min(replication::CHUNK_SIZE, payload.size() - offset);
+            bool last = offset + size == payload.size();
+            std::string frame;
+            protocol::appendFrame(frame, message, last ? 0 : replication::MORE, 0, payload.substr(offset, size));
+            if (!sendAll(socket, frame))
+            {
+                return false;
+            }
+            offset += size;
+        } while (offset < payload.size());
+        return true;
+    }
+}
+
+// Wall-clock time in microseconds
+uint64_t replication::nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Commands a replica refuses, by the names of the text, batch and binary protocols
+bool replication::isWriteCommand(const std::string &command)
+{
+    static const std::unordered_set<std::string> writes = {
+        "build_graph", "add_vertex", "add_edge", "remove_vertex", "remove_edge", "change_weight",
+        "create_graph", "drop_graph", "generate_graph", "compact_graph", "reorder_graph", "load_edges"};
+    return writes.count(command) > 0;
+}
+
+// ReplicationSource implementation
+
+// Serve followers of a started log on an open listening socket
+ReplicationSource::ReplicationSource(MutationLog &log, GraphRegistry &registry, int listenSocket)
+    : log_(log), registry_(registry), listenSocket_(listenSocket), stopping_(false)
+{
+}
+
+// Stop serving if the owner has not already
+ReplicationSource::~ReplicationSource()
+{
+    stop();
+}
+
+// Receive the log's durable batches and start accepting followers
+void ReplicationSource::start()
+{
+    log_.setListener([this](const std::string &batch, uint64_t lastLsn)
+                     { ship(batch, lastLsn); });
+    acceptor_ = std::thread(&ReplicationSource::acceptThread, this);
+}
+
+// Disconnect every follower, join the threads and close the listening socket
+void ReplicationSource::stop()
+{
+    if (stopping_.exchange(true))
+    {
+        return;
+    }
+    log_.setListener(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &follower : followers_)
+        {
+            ::shutdown(follower->socket, SHUT_RDWR);
+        }
+    }
+    condition_.notify_all();
+    if (acceptor_.joinable())
+    {
+        acceptor_.join();
+    }
+    // Take the followers under the lock (ship() and followers() may still be
+    // reading the list) and join them once it is released
+    std::vector<std::shared_ptr<Follower>> followers;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        followers.swap(followers_);
+    }
+    for (const auto &follower : followers)
+    {
+        if (follower->thread.joinable())
+        {
+            follower->thread.join();
+        }
+    }
+    if (listenSocket_ != -1)
+    {
+        ::close(listenSocket_);
+        listenSocket_ = -1;
+    }
+}
+
+// Number of followers still connected
+size_t ReplicationSource::followers() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::count_if(followers_.begin(), followers_.end(), [](const std::shared_ptr<Follower> &follower)
+                         { return !follower->finished; });
+}
+
+// Register each follower before its snapshot is taken, so that every batch
+// made durable from then on is queued for it
+void ReplicationSource::acceptThread()
+{
+    tracing::setThreadName("replication accept");
+    while (!stopping_)
+    {
+        reapFinished();
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(listenSocket_, &readfds);
+        struct timeval timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        if (select(listenSocket_ + 1, &readfds, NULL, NULL, &timeout) <= 0)
+        {
+            continue;
+        }
+        int socket = ::accept(listenSocket_, NULL, NULL);
+        if (socket == -1)
+        {
+            continue;
+        }
+        auto follower = std::make_shared<Follower>();
+        follower->socket = socket;
+        std::lock_guard<std::mutex> lock(mutex_);
+        followers_.push_back(follower);
+        follower->thread = std::thread(&ReplicationSource::serveFollower, this, follower);
+    }
+}
+
+// Join the threads of followers that have disconnected
+void ReplicationSource::reapFinished()
+{
+    std::vector<std::shared_ptr<Follower>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto done = std::stable_partition(followers_.begin(), followers_.end(), [](const std::shared_ptr<Follower> &follower)
+                                          { return !follower->finished; });
+        finished.assign(done, followers_.end());
+        followers_.erase(done, followers_.end());
+    }
+    for (const auto &follower : finished)
+    {
+        follower->thread.join();
+    }
+}
+
+// Seed the follower with a snapshot, then forward queued batches as they
+// arrive and a heartbeat every 100 ms without one
+void ReplicationSource::serveFollower(std::shared_ptr<Follower> follower)
+{
+    tracing::setThreadName("replication");
+    bool connected = true;
+    try
+    {
+        TraceSpan span("replication_snapshot");
+        std::vector<std::string> snapshot = MutationLog::encodeSnapshot(registry_, log_.durableLsn());
+        for (size_t i = 0; i < snapshot.size() && connected; ++i)
+        {
+            connected = sendMessage(follower->socket, i == 0 ? replication::SNAPSHOT : replication::SNAPSHOT_GRAPH, snapshot[i]);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        safePrint(std::string("Replication: cannot snapshot for a follower: ") + e.what());
+        connected = false;
+    }
+
+    while (connected)
+    {
+        std::deque<std::shared_ptr<const std::string>> batches;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait_for(lock, std::chrono::milliseconds(100), [this, &follower]
+                                { return stopping_ || follower->dropped || !follower->queue.empty(); });
+            if (stopping_ || follower->dropped)
+            {
+                break;
+            }
+            batches.swap(follower->queue);
+            follower->queuedBytes = 0;
+        }
+        if (batches.empty())
+        {
+            std::string heartbeat;
+            PayloadWriter writer(heartbeat);
+            writer.u64(log_.durableLsn());
+            writer.u64(replication::nowMicros());
+            connected = sendMessage(follower->socket, replication::HEARTBEAT, heartbeat);
+        }
+        for (const auto &batch : batches)
+        {
+            if (connected)
+            {
+                connected = sendMessage(follower->socket, replication::RECORDS, *batch);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ::close(follower->socket);
+    follower->finished = true;
+}
+
+// Called by the log's syncer with each durable batch
+void ReplicationSource::ship(const std::string &batch, uint64_t lastLsn)
+{
+    auto payload = std::make_shared<std::string>();
+    payload->reserve(2 * sizeof(uint64_t) + batch.size());
+    PayloadWriter writer(*payload);
+    writer.u64(lastLsn);
+    writer.u64(replication::nowMicros());
+    *payload += batch;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &follower : followers_)
+        {
+            if (follower->finished || follower->dropped)
+            {
+                continue;
+            }
+            if (follower->queuedBytes + payload->size() > MAX_QUEUED_BYTES)
+            {
+                follower->dropped = true;
+                ::shutdown(follower->socket, SHUT_RDWR);
+                continue;
+            }
+            follower->queue.push_back(payload);
+            follower->queuedBytes += payload->size();
+        }
+    }
+    condition_.notify_all();
+}
+
+// ReplicaClient implementation
+
+// Follow the primary at "host:port" into the given registry
+ReplicaClient::ReplicaClient(const std::string &primary, GraphRegistry &registry)
+    : primary_(primary), registry_(registry), stopping_(false)
+{
+}
+
+// Stop following if the owner has not already
+ReplicaClient::~ReplicaClient()
+{
+    stop();
+}
+
+// Start the replica thread; it connects in the background
+void ReplicaClient::start()
+{
+    thread_ = std::thread(&ReplicaClient::run, this);
+}
+
+// Break the connection and join the replica thread
+void ReplicaClient::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        if (socket_ != -1)
+        {
+            ::shutdown(socket_, SHUT_RDWR);
+        }
+    }
+    condition_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+// Copy of the current replication status
+ReplicaClient::Status ReplicaClient::status() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return status_;
+}
+
+// Status as one line of key=value pairs
+std::string ReplicaClient::describe() const
+{
+    Status current = status();
+    std::ostringstream oss;
+    oss << "role=replica primary=" << primary_ << " connected=" << current.connected
+        << " applied_lsn=" << current.appliedLsn << " primary_lsn=" << current.primaryLsn
+        << " lag_records=" << (current.primaryLsn > current.appliedLsn ? current.primaryLsn - current.appliedLsn : 0)
+        << " lag_ms=" << current.lagMicros / 1000.0;
+    if (current.lastContactMicros != 0)
+    {
+        uint64_t now = replication::nowMicros();
+        oss << " last_contact_ms=" << (now > current.lastContactMicros ? now - current.lastContactMicros : 0) / 1000;
+    }
+    return oss.str();
+}
+
+// Connect, follow until the stream breaks, retry every second
+void ReplicaClient::run()
+{
+    tracing::setThreadName("replica");
+    bool reported = false; // print each outage once, not every retry
+    while (!stopping_)
+    {
+        int socket = connectToPrimary();
+        if (socket != -1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                socket_ = socket;
+                status_.connected = true;
+            }
+            safePrint("Replicating from " + primary_);
+            try
+            {
+                follow(socket);
+            }
+            catch (const std::exception &e)
+            {
+                safePrint(std::string("Replication: ") + e.what());
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                socket_ = -1;
+                status_.connected = false;
+            }
+            ::close(socket);
+            reported = false;
+        }
+        if (!reported && !stopping_)
+        {
+            safePrint("Replication: primary " + primary_ + " unreachable, retrying");
+            reported = true;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait_for(lock, std::chrono::seconds(1), [this]
+                            { return stopping_.load(); });
+    }
+}
+
+// Open a connection to the primary's replication port, -1 if it can not be reached
+int ReplicaClient::connectToPrimary() const
+{
+    size_t colon = primary_.rfind(':');
+    if (colon == std::string::npos)
+    {
+        return -1;
+    }
+    std::string host = primary_.substr(0, colon);
+    std::string port = primary_.substr(colon + 1);
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+    int socket = -1;
+    for (addrinfo *address = addresses; address != nullptr && socket == -1; address = address->ai_next)
+    {
+        socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+        if (socket != -1 && ::connect(socket, address->ai_addr, address->ai_addrlen) != 0)
+        {
+            ::close(socket);
+            socket = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    if (socket != -1)
+    {
+        // The primary sends a heartbeat every 100 ms; silence this long means it is gone
+        struct timeval timeout;
+        timeout.tv_sec = 5;
+        timeout.tv_usec = 0;
+        setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    return socket;
+}
+
+// Read frames, reassemble messages and apply them until the connection ends
+void ReplicaClient::follow(int socket)
+{
+    std::string buffer, message;
+    size_t offset = 0;
+    char chunk[64 * 1024];
+    while (!stopping_)
+    {
+        ssize_t count = ::recv(socket, chunk, sizeof(chunk), 0);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return;
+        }
+        buffer.append(chunk, static_cast<size_t>(count));
+        protocol::Frame frame;
+        while (protocol::parseFrame(buffer, offset, frame))
+        {
+            message += frame.payload;
+            if ((frame.status & replication::MORE) == 0)
+            {
+                apply(frame.opcode, message);
+                message.clear();
+            }
+        }
+        buffer.erase(0, offset);
+        offset = 0;
+    }
+}
+
+// Apply one whole message from the primary
+void ReplicaClient::apply(uint8_t type, const std::string &payload)
+{
+    uint64_t now = replication::nowMicros();
+    switch (type)
+    {
+    case replication::SNAPSHOT:
+        snapshotPosition_ = MutationLog::decodeSnapshotHeader(payload.data(), payload.size(), snapshotGraphs_);
+        snapshotNames_.clear();
+        break;
+    case replication::SNAPSHOT_GRAPH:
+        snapshotNames_.insert(MutationLog::restoreSnapshotGraph(registry_, payload.data(), payload.size()));
+        break;
+    case replication::RECORDS:
+    {
+        TraceSpan span("replica_apply");
+        PayloadReader header(payload.data(), 2 * sizeof(uint64_t));
+        uint64_t lastLsn = header.u64();
+        uint64_t sentAt = header.u64();
+        std::string records = payload.substr(2 * sizeof(uint64_t));
+        size_t offset = 0;
+        size_t applied = 0;
+        LogRecord record;
+        while (offset < records.size())
+        {
+            if (!MutationLog::nextRecord(records, offset, record))
+            {
+                throw protocol::ProtocolError("Malformed log record from the primary");
+            }
+            MutationLog::replay(registry_, record);
+            ++applied;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.appliedLsn = lastLsn;
+        status_.primaryLsn = std::max(status_.primaryLsn, lastLsn);
+        status_.lagMicros = now > sentAt ? now - sentAt : 0;
+        status_.lastContactMicros = now;
+        status_.recordsApplied += applied;
+        return;
+    }
+    case replication::HEARTBEAT:
+    {
+        PayloadReader reader(payload);
+        uint64_t durable = reader.u64();
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.primaryLsn = durable;
+        if (status_.appliedLsn >= durable)
+        {
+            status_.lagMicros = 0;
+        }
+        status_.lastContactMicros = now;
+        return;
+    }
+    default:
+        throw protocol::ProtocolError("Unknown replication message " + std::to_string(type));
+    }
+
+    // The snapshot is complete: graphs it does not have were dropped on the primary
+    if (snapshotNames_.size() == snapshotGraphs_)
+    {
+        for (const std::string &name : registry_.list())
+        {
+            if (!snapshotNames_.count(name))
+            {
+                registry_.drop(name);
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        status_.appliedLsn = snapshotPosition_;
+        status_.primaryLsn = snapshotPosition_;
+        status_.lastContactMicros = now;
+        status_.snapshotsLoaded++;
+    }
+}
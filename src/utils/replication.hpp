@@ -0,0 +1,143 @@
+#ifndef REPLICATION_HPP
+#define REPLICATION_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "../common/GraphRegistry.hpp"
+#include "../common/MutationLog.hpp"
+
+// Log shipping from a primary server to read-only follower servers.
+//
+// A follower connects to the primary's replication port. The primary first
+// sends a snapshot of every graph (MutationLog::encodeSnapshot), then every
+// batch of write-ahead log records as soon as it is durable, and a heartbeat
+// with its durable LSN whenever it has nothing else to send. The follower
+// loads the snapshot and replays the records in LSN order through
+// MutationLog::replay, so a graph skips records its snapshot already holds.
+// Followers serve reads from their copy; writes are refused.
+//
+// Messages are binary protocol frames whose opcode is the message type. A
+// payload larger than CHUNK_SIZE is split over frames; every frame but the
+// last has status MORE.
+namespace replication
+{
+    enum Message : uint8_t
+    {
+        SNAPSHOT = 1,       // snapshot header body
+        SNAPSHOT_GRAPH = 2, // one graph body of the snapshot
+        RECORDS = 3,        // u64 last LSN, u64 primary time, then framed log records
+        HEARTBEAT = 4       // u64 durable LSN, u64 primary time
+    };
+    const uint16_t MORE = 1;
+    const size_t CHUNK_SIZE = 16 << 20;
+    // times are microseconds since the Unix epoch, so lag is only meaningful
+    // between hosts with synchronized clocks
+    uint64_t nowMicros();
+
+    // whether a command (text or binary name, e.g. "add_edge") changes a graph
+    bool isWriteCommand(const std::string &command);
+}
+
+// Primary side: serves followers on a listening socket
+class ReplicationSource
+{
+public:
+    // the log must have been started; the socket is closed by stop()
+    ReplicationSource(MutationLog &log, GraphRegistry &registry, int listenSocket);
+    ~ReplicationSource();
+    ReplicationSource(const ReplicationSource &) = delete;
+    ReplicationSource &operator=(const ReplicationSource &) = delete;
+
+    void start();
+    void stop();
+    size_t followers() const;
+
+private:
+    struct Follower
+    {
+        int socket;
+        // RECORDS payloads not sent yet
+        std::deque<std::shared_ptr<const std::string>> queue;
+        size_t queuedBytes = 0;
+        bool dropped = false;  // fell too far behind; disconnected so it re-seeds
+        bool finished = false; // its thread is done and may be joined
+        std::thread thread;
+    };
+
+    void acceptThread();
+    void serveFollower(std::shared_ptr<Follower> follower);
+    void ship(const std::string &batch, uint64_t lastLsn);
+    void reapFinished();
+
+    // a follower further behind than this is disconnected
+    static const size_t MAX_QUEUED_BYTES = 256u << 20;
+
+    MutationLog &log_;
+    GraphRegistry &registry_;
+    int listenSocket_;
+    std::atomic<bool> stopping_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<std::shared_ptr<Follower>> followers_;
+    std::thread acceptor_;
+};
+
+// Follower side: keeps a registry in step with a primary, reconnecting (and
+// re-seeding from a new snapshot) whenever the stream breaks
+class ReplicaClient
+{
+public:
+    struct Status
+    {
+        bool connected = false;
+        uint64_t appliedLsn = 0; // last LSN whose effect the local graphs show
+        uint64_t primaryLsn = 0; // primary's durable LSN as last reported
+        uint64_t lagMicros = 0;  // age of the last applied batch when it was applied
+        uint64_t lastContactMicros = 0; // time of the last message (nowMicros clock)
+        uint64_t recordsApplied = 0;
+        uint64_t snapshotsLoaded = 0;
+    };
+
+    // primary is "host:port" of its replication port
+    ReplicaClient(const std::string &primary, GraphRegistry &registry);
+    ~ReplicaClient();
+    ReplicaClient(const ReplicaClient &) = delete;
+    ReplicaClient &operator=(const ReplicaClient &) = delete;
+
+    void start();
+    void stop();
+    const std::string &primary() const { return primary_; }
+    Status status() const;
+    // one line: role, primary, LSNs and lag
+    std::string describe() const;
+
+private:
+    void run();
+    int connectToPrimary() const;
+    void follow(int socket);
+    void apply(uint8_t message, const std::string &payload);
+
+    std::string primary_;
+    GraphRegistry &registry_;
+    std::atomic<bool> stopping_;
+    mutable std::mutex mutex_; // guards status_ and socket_
+    std::condition_variable condition_;
+    Status status_;
+    int socket_ = -1;
+    std::thread thread_;
+
+    // snapshot being loaded (replica thread only)
+    uint64_t snapshotPosition_ = 0;
+    uint32_t snapshotGraphs_ = 0;
+    std::unordered_set<std::string> snapshotNames_;
+};
+
+#endif // REPLICATION_HPP
@@ -0,0 +1,191 @@
+// This file implements SharedRegion and descriptor passing over Unix domain sockets.
+
+#include "sharedregion.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+// Most descriptors accepted with one read
+static const size_t MAX_FDS_PER_READ = 16;
+
+SharedRegion::SharedRegion() : fd_(-1), data_(nullptr), size_(0) {}
+
+SharedRegion::~SharedRegion()
+{
+    reset();
+}
+
+SharedRegion::SharedRegion(SharedRegion &&other) : fd_(other.fd_), data_(other.data_), size_(other.size_)
+{
+    other.fd_ = -1;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+SharedRegion &SharedRegion::operator=(SharedRegion &&other)
+{
+    if (this != &other)
+    {
+        reset();
+        std::swap(fd_, other.fd_);
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+    }
+    return *this;
+}
+
+// Unmap and close
+void SharedRegion::reset()
+{
+    if (data_ != nullptr && size_ > 0)
+    {
+        munmap(data_, size_);
+    }
+    if (fd_ != -1)
+    {
+        close(fd_);
+    }
+    fd_ = -1;
+    data_ = nullptr;
+    size_ = 0;
+}
+
+SharedRegion SharedRegion::create(const std::string &name, size_t size)
+{
+    SharedRegion region;
+    region.fd_ = memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (region.fd_ == -1)
+    {
+        throw std::runtime_error(std::string("memfd_create failed: ") + std::strerror(errno));
+    }
+    if (size > 0)
+    {
+        if (ftruncate(region.fd_, size) != 0)
+        {
+            throw std::runtime_error(std::string("Cannot size shared region: ") + std::strerror(errno));
+        }
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, region.fd_, 0);
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("Cannot map shared region: ") + std::strerror(errno));
+        }
+        region.data_ = data;
+        region.size_ = size;
+    }
+    // Fix the size so that a peer mapping the region can trust it
+    if (fcntl(region.fd_, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+    {
+        throw std::runtime_error(std::string("Cannot seal shared region: ") + std::strerror(errno));
+    }
+    return region;
+}
+
+SharedRegion SharedRegion::map(int fd, size_t size)
+{
+    SharedRegion region;
+    region.fd_ = fd;
+    // Without a shrink seal the peer could truncate the file under the
+    // mapping, and reading the lost pages would kill this process with SIGBUS
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals == -1 || (seals & F_SEAL_SHRINK) == 0)
+    {
+        throw std::runtime_error("Shared region is not sealed against shrinking (F_SEAL_SHRINK)");
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < 0 || static_cast<size_t>(info.st_size) < size)
+    {
+        throw std::runtime_error("Shared region is smaller than announced");
+    }
+    if (size > 0)
+    {
+        void *data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error(std::string("Cannot map shared region: ") + std::strerror(errno));
+        }
+        region.data_ = data;
+        region.size_ = size;
+    }
+    return region;
+}
+
+bool sendWithFds(int socket, const char *data, size_t size, const std::vector<int> &fds)
+{
+    size_t sent = 0;
+    bool attach = !fds.empty();
+    while (sent < size)
+    {
+        iovec iov;
+        iov.iov_base = const_cast<char *>(data) + sent;
+        iov.iov_len = size - sent;
+        msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+
+        // The descriptors travel with the first byte only
+        std::vector<char> control;
+        if (attach)
+        {
+            control.assign(CMSG_SPACE(fds.size() * sizeof(int)), 0);
+            message.msg_control = control.data();
+            message.msg_controllen = control.size();
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(fds.size() * sizeof(int));
+            std::memcpy(CMSG_DATA(header), fds.data(), fds.size() * sizeof(int));
+        }
+
+        ssize_t n = sendmsg(socket, &message, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        attach = false;
+        sent += n;
+    }
+    return true;
+}
+
+ssize_t receiveWithFds(int socket, char *buffer, size_t size, std::vector<int> &fds)
+{
+    iovec iov;
+    iov.iov_base = buffer;
+    iov.iov_len = size;
+    char control[CMSG_SPACE(MAX_FDS_PER_READ * sizeof(int))];
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+    if (n <= 0)
+    {
+        return n;
+    }
+    for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+    {
+        if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+        {
+            size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const unsigned char *fdData = CMSG_DATA(header);
+            for (size_t i = 0; i < count; ++i)
+            {
+                int fd;
+                std::memcpy(&fd, fdData + i * sizeof(int), sizeof(int));
+                fds.push_back(fd);
+            }
+        }
+    }
+    return n;
+}
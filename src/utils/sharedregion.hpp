@@ -0,0 +1,51 @@
+#ifndef SHAREDREGION_HPP
+#define SHAREDREGION_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <sys/types.h>
+
+// A memory region shared with another process on the same host through a file
+// descriptor (memfd), mapped into this process. Bulk data is written into the
+// region by one side and read in place by the other; only the descriptor and
+// small offsets travel over the socket. Move-only; unmaps and closes on destruction.
+class SharedRegion
+{
+public:
+    SharedRegion();
+    ~SharedRegion();
+    SharedRegion(SharedRegion &&other);
+    SharedRegion &operator=(SharedRegion &&other);
+    SharedRegion(const SharedRegion &) = delete;
+    SharedRegion &operator=(const SharedRegion &) = delete;
+
+    // create a new anonymous region of the given size, mapped read-write and
+    // sealed against resizing (F_SEAL_SHRINK | F_SEAL_GROW) so it can be sent
+    static SharedRegion create(const std::string &name, size_t size);
+    // map a region received from a peer read-only; takes ownership of fd.
+    // Throws std::runtime_error if the descriptor has no F_SEAL_SHRINK seal, is
+    // smaller than size or cannot be mapped.
+    static SharedRegion map(int fd, size_t size);
+
+    char *data() { return static_cast<char *>(data_); }
+    const char *data() const { return static_cast<const char *>(data_); }
+    size_t size() const { return size_; }
+    int fd() const { return fd_; }
+
+private:
+    void reset();
+
+    int fd_;
+    void *data_;
+    size_t size_;
+};
+
+// Send data with file descriptors attached (SCM_RIGHTS, Unix domain sockets
+// only); loops on short writes. Returns false if the peer is gone.
+bool sendWithFds(int socket, const char *data, size_t size, const std::vector<int> &fds);
+
+// Read like read(), appending any descriptors that arrived with the data to fds
+ssize_t receiveWithFds(int socket, char *buffer, size_t size, std::vector<int> &fds);
+
+#endif // SHAREDREGION_HPP
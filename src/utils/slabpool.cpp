@@ -0,0 +1,243 @@
+#include "slabpool.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    // Room for the slab header. Blocks follow it at multiples of their class
+    // size, so they are only 8-byte aligned (the 24, 48, ... byte classes)
+    const size_t SLAB_HEADER = 64;
+
+    // Set once the thread's cache is destroyed; blocks freed later in the
+    // thread's exit go straight back to their slabs
+    thread_local bool localCacheGone = false;
+}
+
+struct SlabPool::LocalCache
+{
+    FreeBlock *free[CLASSES] = {};
+    size_t count[CLASSES] = {};
+
+    ~LocalCache()
+    {
+        localCacheGone = true;
+        for (size_t index = 0; index < CLASSES; ++index)
+        {
+            if (free[index])
+            {
+                SlabPool::global().give(index, free[index], count[index]);
+            }
+        }
+    }
+};
+
+SlabPool &SlabPool::global()
+{
+    // Never destroyed: graphs in static storage may free into it during exit
+    static SlabPool *pool = new SlabPool();
+    return *pool;
+}
+
+// Class 0 is 16 bytes; then 24, 32, 48, 64, 96, ... up to 4096 (class 16).
+// Vectors of 12-byte edges grow to 12 * 2^k bytes, which are exactly the
+// midpoint classes.
+size_t SlabPool::classOf(size_t bytes)
+{
+    if (bytes <= 16)
+    {
+        return 0;
+    }
+    size_t power = 16, index = 0;
+    while (power * 2 < bytes)
+    {
+        power *= 2;
+        index += 2;
+    }
+    return bytes <= power + power / 2 ? index + 1 : index + 2;
+}
+
+size_t SlabPool::classSize(size_t index)
+{
+    size_t power = size_t(16) << (index / 2);
+    return index % 2 == 0 ? power : power + power / 2;
+}
+
+// Blocks a thread moves to or from the slabs at a time: about a quarter of a
+// slab, between 4 and 64 blocks. A cache holds at most two batches per class.
+size_t SlabPool::batchOf(size_t index)
+{
+    size_t blocks = SLAB_SIZE / 4 / classSize(index);
+    return blocks < 4 ? 4 : blocks > 64 ? 64 : blocks;
+}
+
+// The calling thread's cache, or nullptr while the thread is exiting
+SlabPool::LocalCache *SlabPool::localCache()
+{
+    if (localCacheGone)
+    {
+        return nullptr;
+    }
+    static thread_local LocalCache cache;
+    return &cache;
+}
+
+// Take a slab for the class from the heap and list it as spare
+SlabPool::Slab *SlabPool::newSlab(size_t index)
+{
+    static_assert(sizeof(Slab) <= SLAB_HEADER, "slab header does not fit");
+    void *memory = nullptr;
+    if (posix_memalign(&memory, SLAB_SIZE, SLAB_SIZE) != 0)
+    {
+        throw std::bad_alloc();
+    }
+    size_t size = classSize(index);
+    Slab *slab = new (memory) Slab();
+    slab->cursor = static_cast<char *>(memory) + SLAB_HEADER;
+    slab->end = slab->cursor + (SLAB_SIZE - SLAB_HEADER) / size * size;
+    SizeClass &sizeClass = classes_[index];
+    slab->next = sizeClass.spare;
+    if (sizeClass.spare)
+    {
+        sizeClass.spare->prev = slab;
+    }
+    sizeClass.spare = slab;
+    slab->listed = true;
+    reserved_.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+    return slab;
+}
+
+void SlabPool::take(size_t index, FreeBlock *&list, size_t count)
+{
+    size_t size = classSize(index);
+    SizeClass &sizeClass = classes_[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    for (size_t i = 0; i < count; ++i)
+    {
+        Slab *slab = sizeClass.spare ? sizeClass.spare : newSlab(index);
+        FreeBlock *block = slab->free;
+        if (block)
+        {
+            slab->free = block->next;
+        }
+        else
+        {
+            block = reinterpret_cast<FreeBlock *>(slab->cursor);
+            slab->cursor += size;
+        }
+        ++slab->live;
+        block->next = list;
+        list = block;
+        if (slab->free == nullptr && slab->cursor == slab->end)
+        {
+            // Full: off the spare list until a block comes back
+            sizeClass.spare = slab->next;
+            if (slab->next)
+            {
+                slab->next->prev = nullptr;
+            }
+            slab->listed = false;
+        }
+    }
+    used_.fetch_add(count * size, std::memory_order_relaxed);
+}
+
+void SlabPool::give(size_t index, FreeBlock *list, size_t count)
+{
+    SizeClass &sizeClass = classes_[index];
+    std::lock_guard<std::mutex> lock(sizeClass.mutex);
+    while (list)
+    {
+        FreeBlock *block = list;
+        list = list->next;
+        Slab *slab = reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(block) & ~(uintptr_t(SLAB_SIZE) - 1));
+        block->next = slab->free;
+        slab->free = block;
+        if (!slab->listed)
+        {
+            slab->prev = nullptr;
+            slab->next = sizeClass.spare;
+            if (sizeClass.spare)
+            {
+                sizeClass.spare->prev = slab;
+            }
+            sizeClass.spare = slab;
+            slab->listed = true;
+        }
+        if (--slab->live == 0 && (slab->prev || slab->next))
+        {
+            // Empty and not the class's last spare slab: back to the heap
+            (slab->prev ? slab->prev->next : sizeClass.spare) = slab->next;
+            if (slab->next)
+            {
+                slab->next->prev = slab->prev;
+            }
+            free(slab);
+            reserved_.fetch_sub(SLAB_SIZE, std::memory_order_relaxed);
+        }
+    }
+    used_.fetch_sub(count * classSize(index), std::memory_order_relaxed);
+}
+
+void *SlabPool::allocate(size_t bytes)
+{
+    if (bytes > MAX_SIZE)
+    {
+        return ::operator new(bytes);
+    }
+    size_t index = classOf(bytes);
+    LocalCache *cache = localCache();
+    if (cache == nullptr)
+    {
+        FreeBlock *block = nullptr;
+        take(index, block, 1);
+        return block;
+    }
+    if (cache->free[index] == nullptr)
+    {
+        size_t batch = batchOf(index);
+        take(index, cache->free[index], batch);
+        cache->count[index] = batch;
+    }
+    FreeBlock *block = cache->free[index];
+    cache->free[index] = block->next;
+    --cache->count[index];
+    return block;
+}
+
+void SlabPool::deallocate(void *block, size_t bytes)
+{
+    if (block == nullptr)
+    {
+        return;
+    }
+    if (bytes > MAX_SIZE)
+    {
+        ::operator delete(block);
+        return;
+    }
+    size_t index = classOf(bytes);
+    FreeBlock *freed = static_cast<FreeBlock *>(block);
+    LocalCache *cache = localCache();
+    if (cache == nullptr)
+    {
+        freed->next = nullptr;
+        give(index, freed, 1);
+        return;
+    }
+    freed->next = cache->free[index];
+    cache->free[index] = freed;
+    size_t batch = batchOf(index);
+    if (++cache->count[index] > 2 * batch)
+    {
+        // Keep one batch, hand the rest back
+        FreeBlock *last = cache->free[index];
+        for (size_t i = 1; i < batch; ++i)
+        {
+            last = last->next;
+        }
+        give(index, last->next, cache->count[index] - batch);
+        last->next = nullptr;
+        cache->count[index] = batch;
+    }
+}
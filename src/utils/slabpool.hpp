@@ -0,0 +1,108 @@
+#ifndef SLABPOOL_HPP
+#define SLABPOOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+// Process-wide pool for the many small, long-lived blocks of graph storage
+// (per-vertex edge arrays and their shared_ptr control blocks). Requests are
+// rounded up to a size class (powers of two and the midpoints between them,
+// 16 bytes to 4 KiB) and carved from 64 KiB slabs, each slab serving one
+// class. Every thread keeps a small cache of free blocks per class and moves
+// them to and from the shared slabs in batches, so building a graph from
+// several threads takes a class's lock once per batch, not once per block.
+// Freed blocks go back to their own slab, so a graph that is rebuilt or
+// edited in steady state reuses memory instead of calling the heap, and a
+// slab none of whose blocks are in use is returned to the heap (one empty
+// slab per class is kept). Larger requests go straight to operator new.
+class SlabPool
+{
+public:
+    static const size_t MAX_SIZE = 4096;
+    static const size_t SLAB_SIZE = 64 * 1024;
+    // alignment every block is guaranteed to have
+    static const size_t ALIGNMENT = 8;
+
+    static SlabPool &global();
+
+    void *allocate(size_t bytes);
+    void deallocate(void *block, size_t bytes);
+
+    // bytes of slabs held from the heap, and of blocks handed out of them
+    // (including those in the threads' caches)
+    size_t reservedBytes() const { return reserved_.load(std::memory_order_relaxed); }
+    size_t usedBytes() const { return used_.load(std::memory_order_relaxed); }
+
+private:
+    static const size_t CLASSES = 17;
+
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+    // Header at the start of every slab; slabs are SLAB_SIZE-aligned, so a
+    // block's slab is its address rounded down
+    struct Slab
+    {
+        Slab *prev; // in the class's list of slabs with a block to spare
+        Slab *next;
+        bool listed;
+        FreeBlock *free; // freed blocks of this slab
+        char *cursor;    // uncarved part of the slab
+        char *end;
+        size_t live; // blocks handed out
+    };
+    struct SizeClass
+    {
+        std::mutex mutex;
+        Slab *spare = nullptr; // slabs with a free or uncarved block
+    };
+    struct LocalCache; // a thread's free blocks per class
+
+    SlabPool() = default;
+    static size_t classOf(size_t bytes);
+    static size_t classSize(size_t index);
+    static size_t batchOf(size_t index);
+    static LocalCache *localCache();
+
+    // move up to count blocks of the class onto list / blocks from the list
+    // back to their slabs; both take the class's lock once
+    void take(size_t index, FreeBlock *&list, size_t count);
+    void give(size_t index, FreeBlock *list, size_t count);
+    Slab *newSlab(size_t index);
+
+    SizeClass classes_[CLASSES];
+    std::atomic<size_t> reserved_{0};
+    std::atomic<size_t> used_{0};
+};
+
+// Standard allocator over SlabPool::global()
+template <typename T>
+class SlabAllocator
+{
+    static_assert(alignof(T) <= SlabPool::ALIGNMENT, "SlabPool blocks are only 8-byte aligned");
+
+public:
+    using value_type = T;
+
+    SlabAllocator() = default;
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U> &) {}
+
+    T *allocate(size_t count)
+    {
+        return static_cast<T *>(SlabPool::global().allocate(count * sizeof(T)));
+    }
+    void deallocate(T *block, size_t count)
+    {
+        SlabPool::global().deallocate(block, count * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U> &) const { return false; }
+};
+
+#endif // SLABPOOL_HPP
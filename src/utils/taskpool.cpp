@@ -0,0 +1,160 @@
+// This file implements TaskPool, the compute thread pool used for background and expensive work.
+
+#include "taskpool.hpp"
+#include "threadpool.hpp"
+#include "tracing.hpp"
+#include "arena.hpp"
+#include <algorithm>
+
+namespace
+{
+    const size_t HEAVY_LANE = static_cast<size_t>(CostClass::Heavy);
+}
+
+// At least two threads, so a Heavy task never takes the only one
+TaskPool::TaskPool(size_t numThreads, size_t fairnessInterval)
+    : fairnessInterval(std::max<size_t>(1, fairnessInterval)),
+      heavyLimit(std::max<size_t>(2, numThreads) - 1)
+{
+    for (size_t i = 0; i < heavyLimit + 1; ++i)
+    {
+        threads.emplace_back(&TaskPool::run, this);
+    }
+}
+
+TaskPool::~TaskPool()
+{
+    stop();
+}
+
+// Queue a task in the lane of its cost class
+void TaskPool::submit(std::function<void()> task, CostClass costClass)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lanes[static_cast<size_t>(costClass)].push(std::move(task));
+    condition.notify_one();
+}
+
+// Number of tasks waiting for a thread
+size_t TaskPool::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto &lane : lanes)
+    {
+        total += lane.size();
+    }
+    return total;
+}
+
+// Stop accepting work, let queued tasks finish and join the threads
+void TaskPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        condition.notify_all();
+    }
+    for (std::thread &thread : threads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+}
+
+// True when no lane has waiting tasks (mutex held)
+bool TaskPool::drained() const
+{
+    for (const auto &lane : lanes)
+    {
+        if (!lane.empty())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TaskPool::runnable(size_t lane) const
+{
+    return !lanes[lane].empty() && (lane != HEAVY_LANE || runningHeavy < heavyLimit);
+}
+
+// Serve the most expensive lane that has been passed over too often,
+// otherwise the cheapest lane with runnable work
+size_t TaskPool::nextLane() const
+{
+    for (size_t lane = LANES; lane-- > 1;)
+    {
+        if (runnable(lane) && passedOver[lane] >= fairnessInterval)
+        {
+            return lane;
+        }
+    }
+    for (size_t lane = 0; lane < LANES; ++lane)
+    {
+        if (runnable(lane))
+        {
+            return lane;
+        }
+    }
+    return LANES;
+}
+
+// Compute thread function
+void TaskPool::run()
+{
+    tracing::setThreadName("compute");
+    while (true)
+    {
+        std::function<void()> task;
+        size_t lane;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]
+                           { return nextLane() < LANES || (stopping && drained()); });
+            lane = nextLane();
+            if (lane == LANES)
+            {
+                return;
+            }
+            task = std::move(lanes[lane].front());
+            lanes[lane].pop();
+
+            // Count the pass-over for every more expensive lane that still waits
+            passedOver[lane] = 0;
+            for (size_t other = lane + 1; other < LANES; ++other)
+            {
+                if (!lanes[other].empty())
+                {
+                    ++passedOver[other];
+                }
+            }
+            if (lane == HEAVY_LANE)
+            {
+                ++runningHeavy;
+            }
+        }
+
+        try
+        {
+            TraceSpan span("task", CommandCost::name(static_cast<CostClass>(lane)));
+            ScratchScope scratch; // the task's scratch memory is released when it ends
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            safePrint(std::string("Compute task failed: ") + e.what());
+        }
+
+        if (lane == HEAVY_LANE)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --runningHeavy;
+            // A heavy slot is free again, another thread may be waiting for it
+            condition.notify_all();
+        }
+    }
+}
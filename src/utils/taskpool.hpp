@@ -0,0 +1,51 @@
+#ifndef TASKPOOL_HPP
+#define TASKPOOL_HPP
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "../common/CommandCost.hpp"
+
+// Fixed-size pool of compute threads running queued tasks.
+// Kept apart from the ThreadPool's connection workers so that long
+// computations never occupy the threads that serve sessions.
+//
+// Tasks wait in one FIFO lane per CostClass. Cheaper lanes are served first,
+// with two protections for the expensive ones: a waiting lower lane is served
+// after it has been passed over `fairnessInterval` times, and Heavy tasks may
+// occupy at most numThreads - 1 threads so one thread is always left for
+// cheaper work. The pool therefore runs at least two threads.
+class TaskPool
+{
+public:
+    TaskPool(size_t numThreads, size_t fairnessInterval = 4);
+    ~TaskPool();
+
+    void submit(std::function<void()> task, CostClass costClass = CostClass::Normal);
+    void stop();
+    size_t pending();
+
+private:
+    static const size_t LANES = 3;
+
+    void run();
+    // index of the lane to serve next, or LANES if nothing may run now (mutex held)
+    size_t nextLane() const;
+    bool runnable(size_t lane) const;
+    bool drained() const;
+
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> lanes[LANES];
+    size_t passedOver[LANES] = {0, 0, 0};
+    size_t fairnessInterval;
+    size_t runningHeavy = 0;
+    size_t heavyLimit;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+};
+
+#endif // TASKPOOL_HPP
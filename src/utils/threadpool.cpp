@@ -3,16 +3,23 @@
 // Include necessary headers
 #include "threadpool.hpp"
 #include "../server/server.hpp"
+#include "affinity.hpp"
+#include "arena.hpp"
+#include "slabpool.hpp"
 #include <iostream>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include <cstring>
 #include <string>
 #include <sstream>
+#include <algorithm>
 
 // Global mutex for thread-safe console output
 std::mutex coutMutex;
 
 // Client class implementation
-Client::Client(int socket, std::shared_ptr<Graph> graph) : socket_(socket), connected_(true), graph_(graph) {}
+Client::Client(int socket, std::shared_ptr<GraphStore> graph) : socket_(socket), connected_(true), graph_(graph) {}
 
 bool Client::isConnected() { return connected_; }
 
@@ -25,18 +32,168 @@ Client::~Client()
     }
 }
 
+// Reply with a retry hint and drop the connection
+void Client::rejectBusy(int retryAfterMs)
+{
+    std::string reply = "BUSY retry_after_ms=" + std::to_string(retryAfterMs) + "\n";
+    send(socket_, reply.c_str(), reply.length(), MSG_NOSIGNAL);
+    connected_ = false;
+}
+
+// AdmissionStats implementation
+namespace
+{
+    void updateMax(std::atomic<uint64_t> &maximum, uint64_t value)
+    {
+        uint64_t current = maximum.load(std::memory_order_relaxed);
+        while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+void AdmissionStats::recordQueueWait(uint64_t micros)
+{
+    static const size_t histogram = Metrics::global().histogram("mst_queue_wait_us", "", "Time accepted connections waited for a worker, in microseconds");
+    Metrics::global().record(histogram, micros);
+    admitted.fetch_add(1, std::memory_order_relaxed);
+    queueWaitMicros.fetch_add(micros, std::memory_order_relaxed);
+    updateMax(maxQueueWaitMicros, micros);
+}
+
+void AdmissionStats::recordLockWait(uint64_t micros)
+{
+    static const size_t histogram = Metrics::global().histogram("mst_lock_wait_us", "", "Time commands waited for a graph's write lock, in microseconds");
+    Metrics::global().record(histogram, micros);
+    commandsWaited.fetch_add(1, std::memory_order_relaxed);
+    lockWaitMicros.fetch_add(micros, std::memory_order_relaxed);
+    updateMax(maxLockWaitMicros, micros);
+}
+
 // LeaderTask class implementation
-LeaderTask::LeaderTask(int serverSocket) : Client(-1, nullptr), serverSocket(serverSocket) {}
+LeaderTask::LeaderTask() : Client(-1, nullptr) {}
 void LeaderTask::handle() {}
 bool LeaderTask::isConnected() { return false; }
 
 // ThreadPool class implementation
-ThreadPool::ThreadPool(size_t numThreads) : stop_flag(false), sharedGraph(std::make_shared<Graph>())
+ThreadPool::ThreadPool(const ServerConfig &config)
+    : config(config), pinnedCpus(affinity::cpuOrder(config.pin)), nextCpuSlot(0),
+      queueMutex("ThreadPool::queueMutex"), stop_flag(false),
+      computePool(config.computeThreads, config.fairnessInterval),
+      jobs(computePool, config.maxFinishedJobs, config.maxActiveJobs)
 {
-    // Create worker threads
-    for (size_t i = 0; i < numThreads; ++i)
+    lockprofiler::setEnabled(config.lockProfile);
+    tracing::configure(config.traceEvents);
+    setScratchRetained(config.scratchRetainedBytes);
+
+    // Create the minimum number of worker threads
     {
-        workers.emplace_back(&ThreadPool::workerThread, this);
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+        for (size_t i = 0; i < config.threads; ++i)
+        {
+            spawnWorker();
+        }
+    }
+    scaler = std::thread(&ThreadPool::scalerThread, this);
+}
+
+// Start one more worker thread (queueMutex must be held)
+void ThreadPool::spawnWorker()
+{
+    std::thread worker(&ThreadPool::workerThread, this);
+    std::thread::id id = worker.get_id();
+    workers[id] = std::move(worker);
+}
+
+// Pin the calling pool thread to the next CPU of the configured topology
+void ThreadPool::pinCurrentThread()
+{
+    if (pinnedCpus.empty())
+    {
+        return;
+    }
+    int cpu = pinnedCpus[nextCpuSlot++ % pinnedCpus.size()];
+    if (!affinity::pinCurrentThread(cpu))
+    {
+        safePrint("Failed to pin thread to CPU " + std::to_string(cpu));
+    }
+}
+
+const ServerConfig &ThreadPool::getConfig() const
+{
+    return config;
+}
+
+const std::vector<int> &ThreadPool::getPinnedCpus() const
+{
+    return pinnedCpus;
+}
+
+// Join workers that exited after their idle timeout
+void ThreadPool::reapRetiredWorkers()
+{
+    std::vector<std::thread> finished;
+    {
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+        for (std::thread::id id : retiredWorkers)
+        {
+            auto it = workers.find(id);
+            if (it != workers.end())
+            {
+                finished.push_back(std::move(it->second));
+                workers.erase(it);
+            }
+        }
+        retiredWorkers.clear();
+    }
+    for (std::thread &worker : finished)
+    {
+        worker.join();
+    }
+}
+
+// Get the number of live worker threads
+size_t ThreadPool::getWorkerCount()
+{
+    ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+    return workers.size();
+}
+
+// Scaler thread function: grows the pool when queued work finds no idle worker.
+// Growth needs the backlog to persist for growAfterMs, and shrinking needs a
+// worker to stay idle for idleTimeoutMs, so short bursts do not make the pool flap.
+void ThreadPool::scalerThread()
+{
+    const auto tick = std::chrono::milliseconds(std::max(10, std::min(config.growAfterMs, 100)));
+    bool backlogged = false;
+    std::chrono::steady_clock::time_point backlogSince;
+
+    while (!stop_flag)
+    {
+        std::this_thread::sleep_for(tick);
+        reapRetiredWorkers();
+
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+        if (clients.empty() || idleWorkers > 0)
+        {
+            backlogged = false;
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (!backlogged)
+        {
+            backlogged = true;
+            backlogSince = now;
+        }
+        else if (now - backlogSince >= std::chrono::milliseconds(config.growAfterMs) &&
+                 workers.size() < config.maxThreads)
+        {
+            spawnWorker();
+            backlogSince = now;
+            std::ostringstream oss;
+            oss << "Queue backlog: growing pool to " << workers.size() << " workers";
+            safePrint(oss.str());
+        }
     }
 }
 
@@ -45,75 +202,230 @@ ThreadPool::~ThreadPool()
     stop();
 }
 
-// Start the server and initialize the leader thread
-void ThreadPool::start()
+// Create a TCP socket listening on the given port (on all interfaces, or only
+// on the loopback interface); returns -1 on failure
+static int openTcpListener(int port, bool loopbackOnly = false)
 {
     // Create and configure server socket
-    serverSocket = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket == -1)
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket == -1)
     {
         std::cerr << "Failed to create socket" << std::endl;
-        return;
+        return -1;
     }
 
     // Set socket options
     int reuse = 1;
-    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
+    if (setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0)
     {
         std::cerr << "Failed to set SO_REUSEADDR" << std::endl;
-        close(serverSocket);
-        return;
+        close(listenSocket);
+        return -1;
     }
 
     // Bind socket to address and port
     sockaddr_in serverAddr;
     serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(9039);
+    serverAddr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    serverAddr.sin_port = htons(port);
 
-    if (bind(serverSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) < 0)
+    if (bind(listenSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) < 0)
     {
-        std::cerr << "Failed to bind to port 9039" << std::endl;
-        close(serverSocket);
-        return;
+        std::cerr << "Failed to bind to port " << port << std::endl;
+        close(listenSocket);
+        return -1;
     }
 
     // Start listening for connections
-    if (listen(serverSocket, 3) < 0)
+    if (listen(listenSocket, SOMAXCONN) < 0)
     {
         std::cerr << "Failed to listen on socket" << std::endl;
-        close(serverSocket);
+        close(listenSocket);
+        return -1;
+    }
+    return listenSocket;
+}
+
+// Create a Unix domain socket listening at path, replacing a stale socket file; returns -1 on failure
+static int openUnixListener(const std::string &path)
+{
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        std::cerr << "Unix socket path too long: " << path << std::endl;
+        return -1;
+    }
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    int listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenSocket == -1)
+    {
+        std::cerr << "Failed to create Unix socket" << std::endl;
+        return -1;
+    }
+    unlink(path.c_str());
+    if (bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(listenSocket, SOMAXCONN) < 0)
+    {
+        std::cerr << "Failed to listen on " << path << std::endl;
+        close(listenSocket);
+        return -1;
+    }
+    return listenSocket;
+}
+
+// Start the server and initialize the leader thread
+void ThreadPool::start()
+{
+    // Rebuild the graphs from the write-ahead log before serving anything
+    if (!config.walDir.empty())
+    {
+        MutationLogOptions options;
+        options.directory = config.walDir;
+        options.syncOnCommit = config.walSync == "commit";
+        options.groupDelayUs = config.walGroupDelayUs;
+        options.checkpointBytes = config.walCheckpointBytes;
+        wal.reset(new MutationLog(options));
+        try
+        {
+            size_t records = wal->recover(graphs);
+            std::cout << "Recovered " << graphs.list().size() << " graphs from " << config.walDir << " ("
+                      << records << " log records replayed)" << std::endl;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Write-ahead log recovery failed: " << e.what() << std::endl;
+            wal.reset();
+            return;
+        }
+        graphs.attachLog(wal.get());
+        wal->start(graphs);
+
+        if (config.replicationPort != 0)
+        {
+            int replicationSocket = openTcpListener(config.replicationPort);
+            if (replicationSocket != -1)
+            {
+                replicationSource.reset(new ReplicationSource(*wal, graphs, replicationSocket));
+                replicationSource->start();
+                std::cout << "Shipping the write-ahead log to followers on port " << config.replicationPort << std::endl;
+            }
+        }
+    }
+
+    // A follower keeps its graphs in step with the primary and refuses writes
+    if (!config.replicateFrom.empty())
+    {
+        replica.reset(new ReplicaClient(config.replicateFrom, graphs));
+        replica->start();
+        std::cout << "Read-only replica of " << config.replicateFrom << std::endl;
+    }
+
+    if (!config.clusterShards.empty())
+    {
+        coordinator.reset(new ClusterCoordinator(cluster::parseShards(config.clusterShards)));
+        std::cout << "Coordinating " << coordinator->shards().size() << " shards: " << config.clusterShards << std::endl;
+    }
+
+    // The interactive text protocol is required, the binary protocol port is optional
+    int textSocket = openTcpListener(config.port);
+    if (textSocket == -1)
+    {
         return;
     }
+    listeners.push_back({textSocket, protocol::WireProtocol::Text, ""});
+    std::cout << "Server is listening on port " << config.port << " (" << config.toString() << ")" << std::endl;
+
+    if (config.binaryPort != 0)
+    {
+        int binarySocket = openTcpListener(config.binaryPort);
+        if (binarySocket != -1)
+        {
+            listeners.push_back({binarySocket, protocol::WireProtocol::Binary, ""});
+            std::cout << "Binary protocol on port " << config.binaryPort << std::endl;
+        }
+    }
 
-    std::cout << "Server is listening on port 9039" << std::endl;
+    // Local clients can skip TCP and pass shared-memory regions over a Unix domain socket
+    if (!config.unixSocket.empty())
+    {
+        int unixSocket = openUnixListener(config.unixSocket);
+        if (unixSocket != -1)
+        {
+            listeners.push_back({unixSocket, protocol::WireProtocol::Binary, config.unixSocket});
+            std::cout << "Binary protocol on Unix socket " << config.unixSocket << std::endl;
+        }
+    }
+
+    if (config.metricsPort != 0)
+    {
+        metricsSocket = openTcpListener(config.metricsPort, true);
+        if (metricsSocket != -1)
+        {
+            metricsServer = std::thread(&ThreadPool::metricsThread, this);
+            std::cout << "Prometheus metrics on http://127.0.0.1:" << config.metricsPort << "/metrics" << std::endl;
+        }
+    }
 
     // Start the leader thread
-    leader = std::thread(&ThreadPool::leaderThread, this, serverSocket);
+    leader = std::thread([this]()
+                         {
+        pinCurrentThread();
+        tracing::setThreadName("leader");
+        leaderThread(); });
 }
 
 // Stop the thread pool and clean up resources
 void ThreadPool::stop()
 {
     {
-        std::unique_lock<std::mutex> lock(queueMutex);
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
         stop_flag = true;
         condition.notify_all();
     }
 
-    // Close the server socket
-    if (serverSocket != -1)
+    // Close the listening sockets
+    for (Listener &listener : listeners)
     {
-        close(serverSocket);
-        serverSocket = -1;
+        if (listener.socket != -1)
+        {
+            close(listener.socket);
+            listener.socket = -1;
+            if (!listener.path.empty())
+            {
+                unlink(listener.path.c_str());
+            }
+        }
+    }
+
+    if (metricsServer.joinable())
+    {
+        metricsServer.join();
+    }
+    if (metricsSocket != -1)
+    {
+        close(metricsSocket);
+        metricsSocket = -1;
+    }
+
+    // Join the scaler first so that no new workers are spawned
+    if (scaler.joinable())
+    {
+        scaler.join();
     }
 
     // Join all worker threads
-    for (std::thread &worker : workers)
+    std::unordered_map<std::thread::id, std::thread> remaining;
+    {
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+        remaining.swap(workers);
+        retiredWorkers.clear();
+    }
+    for (auto &pair : remaining)
     {
-        if (worker.joinable())
+        if (pair.second.joinable())
         {
-            worker.join();
+            pair.second.join();
         }
     }
 
@@ -122,37 +434,136 @@ void ThreadPool::stop()
     {
         leader.join();
     }
+
+    // Let running jobs finish and stop the compute pool
+    computePool.stop();
+
+    if (replica)
+    {
+        replica->stop();
+    }
+    if (replicationSource)
+    {
+        replicationSource->stop();
+    }
+    // Every writer has finished; flush the last log batch
+    if (wal)
+    {
+        wal->stop();
+    }
 }
 
 // Add a new client to the queue for handling
-void ThreadPool::handleNewClient(std::shared_ptr<Client> client)
+// Returns false without queuing when the queue is at capacity
+bool ThreadPool::handleNewClient(std::shared_ptr<Client> client)
 {
     {
         // Acquire a lock on the queue mutex to ensure thread-safe access
-        std::unique_lock<std::mutex> lock(queueMutex);
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+
+        if (queuedClients >= config.queueCapacity)
+        {
+            return false;
+        }
 
         // Add the new client to the queue of clients waiting to be handled
-        clients.push(client);
+        clients.push({client, std::chrono::steady_clock::now()});
+        ++queuedClients;
 
         // Notify one waiting worker thread that a new client is available
         condition.notify_one();
     }
+    return true;
+}
+
+AdmissionStats &ThreadPool::getAdmissionStats()
+{
+    return admission;
+}
+
+TaskPool &ThreadPool::getComputePool()
+{
+    return computePool;
+}
+
+JobManager &ThreadPool::getJobs()
+{
+    return jobs;
+}
+
+// Serve a client taken from the queue, unless it waited past the queue deadline
+void ThreadPool::serveClient(QueuedTask task)
+{
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - task.queuedAt)
+                      .count();
+    if (waited > static_cast<long long>(config.queueDeadlineMs) * 1000)
+    {
+        // The client has likely given up; fail fast instead of serving stale work
+        admission.rejectedExpired.fetch_add(1, std::memory_order_relaxed);
+        task.client->rejectBusy(config.retryAfterMs);
+        return;
+    }
+    admission.recordQueueWait(waited);
+    uint64_t now = tracing::nowNs();
+    tracing::complete("queue_wait", now - static_cast<uint64_t>(waited) * 1000, now);
+
+    std::ostringstream oss;
+    oss << "Worker thread " << std::this_thread::get_id() << " is handling a client (queued " << waited / 1000 << " ms)";
+    safePrint(oss.str());
+
+    serveSession(*task.client);
+
+    oss.str("");
+    oss << "Client disconnected, thread " << std::this_thread::get_id() << " is free again.";
+    safePrint(oss.str());
+}
+
+// Handle a client's requests until it disconnects, counting it as an active session
+void ThreadPool::serveSession(Client &client)
+{
+    TraceSpan span("session");
+    admission.activeSessions.fetch_add(1, std::memory_order_relaxed);
+    while (client.isConnected() && !stop_flag)
+    {
+        client.handle();
+    }
+    admission.activeSessions.fetch_sub(1, std::memory_order_relaxed);
 }
 
 // Worker thread function
 void ThreadPool::workerThread()
 {
+    pinCurrentThread();
+    tracing::setThreadName("worker");
+
     // Main loop for the worker thread
     while (!stop_flag)
     {
-        std::shared_ptr<Client> client;
+        QueuedTask task;
         {
             // Acquire lock on the queue mutex
-            std::unique_lock<std::mutex> lock(queueMutex);
+            ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
 
-            // Wait for a client or stop signal
-            condition.wait(lock, [this]
-                           { return stop_flag || !clients.empty(); });
+            // Wait for a client or stop signal; workers above the minimum
+            // retire after staying idle for the configured timeout
+            ++idleWorkers;
+            bool woken = condition.wait_for(lock, std::chrono::milliseconds(config.idleTimeoutMs), [this]
+                                            { return stop_flag || !clients.empty(); });
+            --idleWorkers;
+
+            if (!woken)
+            {
+                if (workers.size() - retiredWorkers.size() > config.threads)
+                {
+                    retiredWorkers.push_back(std::this_thread::get_id());
+                    std::ostringstream oss;
+                    oss << "Worker thread " << std::this_thread::get_id() << " idle, shrinking pool";
+                    safePrint(oss.str());
+                    return;
+                }
+                continue;
+            }
 
             // Exit if stopping and no clients left
             if (stop_flag && clients.empty())
@@ -161,50 +572,51 @@ void ThreadPool::workerThread()
             }
 
             // Get the next client from the queue
-            client = std::move(clients.front());
+            task = std::move(clients.front());
             clients.pop();
+            if (!std::dynamic_pointer_cast<LeaderTask>(task.client))
+            {
+                --queuedClients;
+            }
         }
 
         // Check if this is a special LeaderTask
-        if (auto leaderTask = std::dynamic_pointer_cast<LeaderTask>(client))
+        if (std::dynamic_pointer_cast<LeaderTask>(task.client))
         {
             // If so, become the leader thread
-            leaderThread(leaderTask->serverSocket);
+            leaderThread();
         }
         else
         {
             // Regular client handling
-            std::cout << "Worker thread " << std::this_thread::get_id() << " is handling a client" << std::endl;
-
-            // Handle client requests while connected
-            while (client->isConnected())
-            {
-                client->handle();
-            }
-
-            std::cout << "Client disconnected, thread " << std::this_thread::get_id() << " is free again." << std::endl;
+            serveClient(std::move(task));
         }
     }
 }
 
 // Leader thread function
-void ThreadPool::leaderThread(int serverSocket)
+void ThreadPool::leaderThread()
 {
     // Main loop for the leader thread
     while (!stop_flag)
     {
-        // Set up file descriptor set for select()
+        // Set up file descriptor set for select() over every listening socket
         fd_set readfds;
         FD_ZERO(&readfds);
-        FD_SET(serverSocket, &readfds);
+        int maxSocket = -1;
+        for (const Listener &listener : listeners)
+        {
+            FD_SET(listener.socket, &readfds);
+            maxSocket = std::max(maxSocket, listener.socket);
+        }
 
         // Set up timeout for select()
         struct timeval timeout;
         timeout.tv_sec = 1;
         timeout.tv_usec = 0;
 
-        // Wait for activity on the server socket with a timeout
-        int activity = select(serverSocket + 1, &readfds, NULL, NULL, &timeout);
+        // Wait for activity on the server sockets with a timeout
+        int activity = select(maxSocket + 1, &readfds, NULL, NULL, &timeout);
 
         // Check if the thread should stop
         if (stop_flag)
@@ -224,10 +636,21 @@ void ThreadPool::leaderThread(int serverSocket)
         if (activity == 0)
             continue;
 
-        // Accept new client connection
-        sockaddr_in clientAddr;
+        // Accept new client connection on the first ready listener
+        const Listener *ready = &listeners.front();
+        for (const Listener &listener : listeners)
+        {
+            if (FD_ISSET(listener.socket, &readfds))
+            {
+                ready = &listener;
+                break;
+            }
+        }
+        // Accepting and handing the connection over, up to serving it
+        TraceSpan acceptSpan("accept");
+        sockaddr_storage clientAddr;
         socklen_t clientAddrLen = sizeof(clientAddr);
-        int clientSocket = accept(serverSocket, (struct sockaddr *)&clientAddr, &clientAddrLen);
+        int clientSocket = accept(ready->socket, (struct sockaddr *)&clientAddr, &clientAddrLen);
 
         // Handle accept() errors
         if (clientSocket < 0)
@@ -239,20 +662,43 @@ void ThreadPool::leaderThread(int serverSocket)
             continue;
         }
 
+        // Responses are coalesced by the session's output buffer, so there is
+        // nothing for Nagle's algorithm to merge; it would only add latency
+        if (ready->path.empty())
+        {
+            int noDelay = 1;
+            setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        }
+
         // Log the new client connection
         std::ostringstream oss;
         oss << "Leader thread " << std::this_thread::get_id() << " accepted a new client connection";
         safePrint(oss.str());
 
-        // Create a new ServerClient object for the accepted connection
-        auto newClient = std::make_shared<ServerClient>(clientSocket, sharedGraph, *this);
+        // Create a new ServerClient object for the accepted connection, starting on the default graph
+        auto newClient = std::make_shared<ServerClient>(clientSocket, graphs.find(GraphRegistry::DEFAULT_GRAPH), *this, ready->protocol);
 
-        // Make one of the worker threads the new leader
+        // Make an idle worker the new leader. If every worker is busy, stay the
+        // leader and queue the client instead (bounded): a full queue means
+        // overload, so the client is told to retry rather than left waiting.
         {
-            std::unique_lock<std::mutex> lock(queueMutex);
-            clients.push(std::make_shared<LeaderTask>(serverSocket));
+            ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+            if (idleWorkers == 0)
+            {
+                lock.unlock();
+                if (!handleNewClient(newClient))
+                {
+                    admission.rejectedFull.fetch_add(1, std::memory_order_relaxed);
+                    newClient->rejectBusy(config.retryAfterMs);
+                    safePrint("Queue full, rejected a client connection");
+                }
+                continue;
+            }
+            clients.push({std::make_shared<LeaderTask>(), std::chrono::steady_clock::now()});
             condition.notify_one();
         }
+        admission.recordQueueWait(0);
+        acceptSpan.end();
 
         // This thread becomes a follower and handles the client
         oss.str("");
@@ -260,10 +706,7 @@ void ThreadPool::leaderThread(int serverSocket)
         safePrint(oss.str());
 
         // Handle client requests for the entire duration of the connection
-        while (newClient->isConnected() && !stop_flag)
-        {
-            newClient->handle();
-        }
+        serveSession(*newClient);
 
         // Client disconnected, this thread will return to being a worker
         oss.str("");
@@ -275,20 +718,149 @@ void ThreadPool::leaderThread(int serverSocket)
     }
 }
 
-// Lock the shared graph
-void ThreadPool::lockGraph()
+// Follower side of replication, null unless running as a replica
+ReplicaClient *ThreadPool::getReplica()
+{
+    return replica.get();
+}
+
+// Coordinator of shard servers, null unless cluster_shards is set
+ClusterCoordinator *ThreadPool::getCluster()
+{
+    return coordinator.get();
+}
+
+// Replication role and position, one line
+std::string ThreadPool::replicationStatus()
+{
+    if (replica)
+    {
+        return replica->describe();
+    }
+    std::ostringstream oss;
+    if (wal)
+    {
+        oss << "role=primary durable_lsn=" << wal->durableLsn()
+            << " followers=" << (replicationSource ? replicationSource->followers() : 0);
+    }
+    else
+    {
+        oss << "role=standalone";
+    }
+    return oss.str();
+}
+
+// Get the registry of named graphs
+GraphRegistry &ThreadPool::getGraphs()
 {
-    graphMutex.lock();
+    return graphs;
 }
 
-// Unlock the shared graph
-void ThreadPool::unlockGraph()
+// Current pool and admission state, read for a metrics report
+std::vector<Metrics::Gauge> ThreadPool::gauges()
 {
-    graphMutex.unlock();
+    size_t queued, workerCount, idle;
+    {
+        ProfiledLock<ProfiledMutex> lock(queueMutex, LOCK_SITE());
+        queued = queuedClients;
+        workerCount = workers.size();
+        idle = idleWorkers;
+    }
+    auto load = [](const std::atomic<uint64_t> &value)
+    { return static_cast<double>(value.load(std::memory_order_relaxed)); };
+    std::vector<Metrics::Gauge> result = {
+        {"mst_active_sessions", "Connections being served", static_cast<double>(admission.activeSessions.load()), false},
+        {"mst_queued_connections", "Connections waiting for a free worker", static_cast<double>(queued), false},
+        {"mst_workers", "Connection worker threads", static_cast<double>(workerCount), false},
+        {"mst_idle_workers", "Connection worker threads waiting for work", static_cast<double>(idle), false},
+        {"mst_compute_pending", "Tasks queued in the compute pool", static_cast<double>(computePool.pending()), false},
+        {"mst_graphs", "Named graphs", static_cast<double>(graphs.list().size()), false},
+        {"mst_slab_reserved_bytes", "Bytes of slabs the graph storage pool took from the heap", static_cast<double>(SlabPool::global().reservedBytes()), false},
+        {"mst_slab_used_bytes", "Bytes of graph storage blocks handed out by the slab pool", static_cast<double>(SlabPool::global().usedBytes()), false},
+        {"mst_connections_admitted_total", "Connections handed to a worker", load(admission.admitted), true},
+        {"mst_connections_rejected_full_total", "Connections refused because the queue was full", load(admission.rejectedFull), true},
+        {"mst_connections_rejected_expired_total", "Connections refused after waiting past the queue deadline", load(admission.rejectedExpired), true},
+        {"mst_commands_busy_total", "Commands answered BUSY because a write lock was not free in time", load(admission.commandsRejected), true},
+        {"mst_jobs_busy_total", "Job submissions answered BUSY because max_active_jobs were pending or running", static_cast<double>(jobs.rejected()), true},
+    };
+    if (replicationSource)
+    {
+        result.push_back({"mst_replication_followers", "Followers receiving the write-ahead log", static_cast<double>(replicationSource->followers()), false});
+    }
+    if (replica)
+    {
+        ReplicaClient::Status status = replica->status();
+        uint64_t behind = status.primaryLsn > status.appliedLsn ? status.primaryLsn - status.appliedLsn : 0;
+        result.push_back({"mst_replication_connected", "Whether the replica is connected to its primary", static_cast<double>(status.connected), false});
+        result.push_back({"mst_replication_lag_records", "Log records the primary has made durable and the replica not yet applied", static_cast<double>(behind), false});
+        result.push_back({"mst_replication_lag_ms", "Age of the last applied batch of log records when it was applied, in milliseconds", status.lagMicros / 1000.0, false});
+        result.push_back({"mst_replication_records_total", "Log records applied from the primary", static_cast<double>(status.recordsApplied), true});
+    }
+    return result;
 }
 
-// Get the graph mutex
-std::mutex &ThreadPool::getGraphMutex()
+// Serve GET /metrics in Prometheus text format to local scrapers, one request per connection
+void ThreadPool::metricsThread()
 {
-    return graphMutex;
+    tracing::setThreadName("metrics");
+    while (!stop_flag)
+    {
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(metricsSocket, &readfds);
+        struct timeval timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_usec = 0;
+        if (select(metricsSocket + 1, &readfds, NULL, NULL, &timeout) <= 0)
+        {
+            continue;
+        }
+        int scraper = accept(metricsSocket, NULL, NULL);
+        if (scraper < 0)
+        {
+            continue;
+        }
+
+        // A scraper that stalls must not hold the endpoint
+        struct timeval ioTimeout;
+        ioTimeout.tv_sec = 1;
+        ioTimeout.tv_usec = 0;
+        setsockopt(scraper, SOL_SOCKET, SO_RCVTIMEO, &ioTimeout, sizeof(ioTimeout));
+        setsockopt(scraper, SOL_SOCKET, SO_SNDTIMEO, &ioTimeout, sizeof(ioTimeout));
+
+        std::string request;
+        char buffer[4096];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 16384)
+        {
+            ssize_t received = recv(scraper, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            request.append(buffer, received);
+        }
+
+        std::string response;
+        if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0)
+        {
+            std::string body = Metrics::global().renderPrometheus(gauges());
+            response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\n\r\n" + body;
+        }
+        else
+        {
+            response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+        size_t sent = 0;
+        while (sent < response.size())
+        {
+            ssize_t written = send(scraper, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (written <= 0)
+            {
+                break;
+            }
+            sent += written;
+        }
+        close(scraper);
+    }
 }
@@ -13,7 +13,18 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <iostream>
-#include "../common/Graph.hpp"
+#include <unordered_map>
+#include <chrono>
+#include "../common/GraphRegistry.hpp"
+#include "../common/MutationLog.hpp"
+#include "replication.hpp"
+#include "cluster.hpp"
+#include "config.hpp"
+#include "jobmanager.hpp"
+#include "metrics.hpp"
+#include "lockprofiler.hpp"
+#include "tracing.hpp"
+#include "../common/Protocol.hpp"
 
 class MSTFactory;
 class MSTMetrics;
@@ -21,55 +32,134 @@ class MSTMetrics;
 class Client
 {
 public:
-    Client(int socket, std::shared_ptr<Graph> graph);
+    Client(int socket, std::shared_ptr<GraphStore> graph);
     virtual void handle() = 0;
     virtual bool isConnected();
+    // tell the peer the server is overloaded and disconnect it
+    void rejectBusy(int retryAfterMs);
     virtual ~Client();
 
 protected:
     int socket_;
     std::atomic<bool> connected_;
-    std::shared_ptr<Graph> graph_;
+    std::shared_ptr<GraphStore> graph_;
 };
 
 class LeaderTask : public Client
 {
 public:
-    LeaderTask(int serverSocket);
+    LeaderTask();
     void handle() override;
     bool isConnected() override;
-    int serverSocket;
 };
 
 class ServerClient;
 
+// Admission-control counters, updated lock-free by the pool and the sessions
+struct AdmissionStats
+{
+    std::atomic<uint64_t> admitted{0};        // connections handed to a thread
+    std::atomic<uint64_t> rejectedFull{0};    // refused because the queue was full
+    std::atomic<uint64_t> rejectedExpired{0}; // waited in the queue past the deadline
+    std::atomic<uint64_t> queueWaitMicros{0}; // total queue wait of admitted connections
+    std::atomic<uint64_t> maxQueueWaitMicros{0};
+    std::atomic<uint64_t> commandsWaited{0};  // commands that waited for a graph's write lock
+    std::atomic<uint64_t> commandsRejected{0};
+    std::atomic<uint64_t> lockWaitMicros{0};
+    std::atomic<uint64_t> maxLockWaitMicros{0};
+    std::atomic<int64_t> activeSessions{0};   // connections being served right now
+
+    void recordQueueWait(uint64_t micros);
+    void recordLockWait(uint64_t micros);
+};
+
+// Leader-follower pool whose size adapts to load: it grows (up to
+// config.maxThreads) when work has waited in the queue for growAfterMs with no
+// idle worker, and workers above config.threads exit after idleTimeoutMs idle.
 class ThreadPool
 {
 public:
-    ThreadPool(size_t numThreads);
+    ThreadPool(const ServerConfig &config);
     ~ThreadPool();
 
     void start();
     void stop();
-    void handleNewClient(std::shared_ptr<Client> client);
-
-    void lockGraph();
-    void unlockGraph();
-    std::mutex &getGraphMutex();
+    // queue a client for the next free worker; false if the queue is full
+    bool handleNewClient(std::shared_ptr<Client> client);
+    AdmissionStats &getAdmissionStats();
+    // compute pool for expensive commands and jobs, separate from the connection workers
+    TaskPool &getComputePool();
+    // asynchronous jobs, run on the compute pool
+    JobManager &getJobs();
+    GraphRegistry &getGraphs();
+    ReplicaClient *getReplica();
+    ClusterCoordinator *getCluster();
+    std::string replicationStatus();
+    size_t getWorkerCount();
+    const ServerConfig &getConfig() const;
+    // CPUs threads are pinned to, in assignment order (empty when not pinning)
+    const std::vector<int> &getPinnedCpus() const;
+    // pool and admission state for metric reports
+    std::vector<Metrics::Gauge> gauges();
 
 private:
     void workerThread();
-    void leaderThread(int serverSocket);
+    void leaderThread();
+    void scalerThread();
+    void metricsThread();
+    void serveSession(Client &client);
+    void spawnWorker();
+    void reapRetiredWorkers();
+    void pinCurrentThread();
+
+    ServerConfig config;
+    std::vector<int> pinnedCpus;
+    std::atomic<size_t> nextCpuSlot;
+    std::unordered_map<std::thread::id, std::thread> workers;
+    std::vector<std::thread::id> retiredWorkers;
+    size_t idleWorkers = 0;
+    std::thread scaler;
+    // Prometheus endpoint (config.metricsPort), served by its own thread so it
+    // answers even when every worker is busy
+    int metricsSocket = -1;
+    std::thread metricsServer;
+
+    // A queued task remembers when it was queued so its wait can be measured
+    struct QueuedTask
+    {
+        std::shared_ptr<Client> client;
+        std::chrono::steady_clock::time_point queuedAt;
+    };
+
+    void serveClient(QueuedTask task);
 
-    std::vector<std::thread> workers;
-    std::queue<std::shared_ptr<Client>> clients;
-    std::mutex queueMutex;
-    std::condition_variable condition;
+    // Bounded by config.queueCapacity (leadership hand-offs are not counted)
+    std::queue<QueuedTask> clients;
+    size_t queuedClients = 0;
+    AdmissionStats admission;
+    ProfiledMutex queueMutex;
+    // _any so waits go through ProfiledLock
+    std::condition_variable_any condition;
     std::atomic<bool> stop_flag;
     std::thread leader;
-    std::shared_ptr<Graph> sharedGraph;
-    int serverSocket = -1;
-    std::mutex graphMutex;
+    GraphRegistry graphs;
+    // write-ahead log of the graphs (config.walDir), null when disabled
+    std::unique_ptr<MutationLog> wal;
+    // log shipping: the primary's side (config.replicationPort) or the follower's (config.replicateFrom)
+    std::unique_ptr<ReplicationSource> replicationSource;
+    std::unique_ptr<ReplicaClient> replica;
+    // set when this server coordinates shard servers (config.clusterShards)
+    std::unique_ptr<ClusterCoordinator> coordinator;
+    TaskPool computePool;
+    JobManager jobs;
+    // Listening sockets and the protocol spoken by connections accepted on them
+    struct Listener
+    {
+        int socket;
+        protocol::WireProtocol protocol;
+        std::string path; // socket file of a Unix domain listener, empty for TCP
+    };
+    std::vector<Listener> listeners;
 };
 
 extern std::mutex coutMutex;
@@ -0,0 +1,225 @@
+// This file implements the per-thread trace rings and their Chrome trace-event export.
+
+#include "tracing.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    struct Event
+    {
+        const char *name;
+        char detail[40]; // copied, so the source string may be gone by export time
+        uint64_t startNs;
+        uint64_t durationNs;
+    };
+
+    // One thread's ring. Its owner locks the mutex to append, which is
+    // uncontended except while an export copies the ring.
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        std::vector<Event> events;
+        uint64_t written = 0;
+        int tid = 0;
+        const char *threadName = "thread";
+    };
+
+    std::atomic<size_t> capacity(0);
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer *> freeBuffers;
+
+    thread_local const char *localName = nullptr;
+
+    // Gives each thread a ring and hands it back when the thread exits; the
+    // events stay exportable and the next new thread continues the ring
+    struct BufferHandle
+    {
+        ThreadBuffer *buffer = nullptr;
+
+        ~BufferHandle()
+        {
+            if (buffer)
+            {
+                std::lock_guard<std::mutex> lock(registryMutex);
+                freeBuffers.push_back(buffer);
+            }
+        }
+    };
+
+    thread_local BufferHandle localHandle;
+
+    ThreadBuffer &localBuffer()
+    {
+        if (!localHandle.buffer)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            if (!freeBuffers.empty())
+            {
+                localHandle.buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+            }
+            else
+            {
+                buffers.emplace_back(new ThreadBuffer());
+                buffers.back()->tid = static_cast<int>(buffers.size());
+                buffers.back()->events.resize(capacity.load(std::memory_order_relaxed));
+                localHandle.buffer = buffers.back().get();
+            }
+        }
+        if (localName)
+        {
+            localHandle.buffer->threadName = localName;
+        }
+        return *localHandle.buffer;
+    }
+
+    // s as the contents of a JSON string
+    std::string escape(const char *s)
+    {
+        std::string out;
+        for (; *s; ++s)
+        {
+            unsigned char c = static_cast<unsigned char>(*s);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += *s;
+            }
+            else if (c < 0x20)
+            {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", c);
+                out += code;
+            }
+            else
+            {
+                out += *s;
+            }
+        }
+        return out;
+    }
+}
+
+namespace tracing
+{
+    void configure(size_t eventsPerThread)
+    {
+        capacity.store(eventsPerThread, std::memory_order_relaxed);
+    }
+
+    bool enabled()
+    {
+        return capacity.load(std::memory_order_relaxed) != 0;
+    }
+
+    void setThreadName(const char *name)
+    {
+        localName = name;
+        if (localHandle.buffer)
+        {
+            std::lock_guard<std::mutex> lock(localHandle.buffer->mutex);
+            localHandle.buffer->threadName = name;
+        }
+    }
+
+    uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    void complete(const char *name, uint64_t startNs, uint64_t endNs, const char *detail)
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        ThreadBuffer &buffer = localBuffer();
+        std::lock_guard<std::mutex> lock(buffer.mutex);
+        if (buffer.events.empty())
+        {
+            return;
+        }
+        Event &event = buffer.events[buffer.written % buffer.events.size()];
+        event.name = name;
+        event.detail[0] = '\0';
+        if (detail)
+        {
+            std::strncat(event.detail, detail, sizeof(event.detail) - 1);
+        }
+        event.startNs = startNs;
+        event.durationNs = endNs > startNs ? endNs - startNs : 0;
+        ++buffer.written;
+    }
+
+    size_t writeJson(std::ostream &out)
+    {
+        long pid = static_cast<long>(getpid());
+        size_t count = 0;
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"mst server\"}}";
+
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        char line[256];
+        for (const std::unique_ptr<ThreadBuffer> &buffer : buffers)
+        {
+            // Copy the ring so its owner is held up only for the copy
+            std::vector<Event> events;
+            const char *threadName;
+            {
+                std::lock_guard<std::mutex> lock(buffer->mutex);
+                size_t size = buffer->events.size();
+                size_t kept = static_cast<size_t>(std::min<uint64_t>(buffer->written, size));
+                for (uint64_t i = buffer->written - kept; i < buffer->written; ++i)
+                {
+                    events.push_back(buffer->events[i % size]);
+                }
+                threadName = buffer->threadName;
+            }
+
+            out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                << ",\"args\":{\"name\":\"" << escape(threadName) << " " << buffer->tid << "\"}}";
+            for (const Event &event : events)
+            {
+                std::snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                              event.name, pid, buffer->tid, event.startNs / 1e3, event.durationNs / 1e3);
+                out << line;
+                if (event.detail[0])
+                {
+                    out << ",\"args\":{\"detail\":\"" << escape(event.detail) << "\"}";
+                }
+                out << "}";
+                ++count;
+            }
+        }
+        out << "\n]}\n";
+        return count;
+    }
+
+    size_t exportFile(const std::string &path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Cannot write trace file: " + path);
+        }
+        size_t count = writeJson(file);
+        if (!file.flush())
+        {
+            throw std::runtime_error("Cannot write trace file: " + path);
+        }
+        return count;
+    }
+}
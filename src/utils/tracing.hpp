@@ -0,0 +1,63 @@
+#ifndef TRACING_HPP
+#define TRACING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Request lifecycle tracing in the Chrome trace-event format.
+//
+// A TraceSpan records one complete event ("ph":"X") into a ring buffer owned
+// by the calling thread, so recording never contends with other threads; the
+// oldest events are overwritten once a thread's ring is full. The rings are
+// merged only on export, into JSON that chrome://tracing and Perfetto
+// (ui.perfetto.dev) open as a per-thread timeline. While tracing is off a
+// span costs one relaxed atomic load.
+//
+//   TraceSpan span("kruskal");
+//   TraceSpan span("command", "add_edge"); // detail shown in the event's args
+namespace tracing
+{
+    // events kept per thread; 0 (the default) turns tracing off
+    void configure(size_t eventsPerThread);
+    bool enabled();
+    // name shown for the calling thread's track, a string literal
+    void setThreadName(const char *name);
+    uint64_t nowNs();
+    // record a span that started and ended at the given nowNs() times
+    void complete(const char *name, uint64_t startNs, uint64_t endNs, const char *detail = nullptr);
+    // write every thread's events as Chrome trace JSON, returns the number of events
+    size_t writeJson(std::ostream &out);
+    // writeJson into a file; throws std::runtime_error if it cannot be written
+    size_t exportFile(const std::string &path);
+}
+
+// Records the time from construction to end() or destruction as one span.
+// name and detail must outlive the span (literals or long-lived strings).
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const char *detail = nullptr)
+        : name_(name), detail_(detail), start_(tracing::enabled() ? tracing::nowNs() : 0) {}
+    ~TraceSpan() { end(); }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    // close the span before the end of its scope
+    void end()
+    {
+        if (start_ != 0)
+        {
+            tracing::complete(name_, start_, tracing::nowNs(), detail_);
+            start_ = 0;
+        }
+    }
+
+private:
+    const char *name_;
+    const char *detail_;
+    uint64_t start_; // 0 when not recording
+};
+
+#endif // TRACING_HPP
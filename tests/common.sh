@@ -0,0 +1,138 @@
+#!/bin/bash
+
+# Helpers shared by the feature tests. Every test starts servers on ports of
+# its own, talks to them over bash's /dev/tcp and counts the checks that fail.
+
+TEST_DIR=$(mktemp -d)
+FAILURES=0
+declare -A SERVER_PIDS
+
+# Wait until something accepts connections on a local port
+wait_for_port() {
+    for _ in $(seq 1 100); do
+        if (exec 9<>/dev/tcp/127.0.0.1/"$1") 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    echo "Nothing listening on port $1"
+    return 1
+}
+
+# start_server PORT ARGS...: run a server with text port PORT and wait for it
+start_server() {
+    local port=$1
+    shift
+    ./server --port "$port" "$@" < /dev/null >> "$TEST_DIR/server-$port.log" 2>&1 &
+    SERVER_PIDS[$port]=$!
+    wait_for_port "$port"
+}
+
+# crash_server PORT: kill the server without letting it shut down
+crash_server() {
+    kill -9 "${SERVER_PIDS[$1]}" 2>/dev/null
+    wait "${SERVER_PIDS[$1]}" 2>/dev/null
+    unset "SERVER_PIDS[$1]"
+}
+
+# text_session PORT: send stdin as one text session, then exit; print every reply
+text_session() {
+    exec 3<>/dev/tcp/127.0.0.1/"$1" || return 1
+    { cat; printf '9\n'; } >&3
+    timeout 10 cat <&3
+    exec 3<&-
+}
+
+# batch PORT COMMAND...: run the commands as one batch; print only its reply lines
+batch() {
+    local port=$1
+    shift
+    { echo batch; printf '%s\n' "$@"; echo end; } | text_session "$port" | grep -E '^(ok|error|busy|end)( |$)'
+}
+
+# check NAME EXPECTED ACTUAL
+check() {
+    if [ "$2" == "$3" ]; then
+        echo "  ok: $1"
+    else
+        echo "  FAILED: $1"
+        echo "    expected: $2"
+        echo "    actual:   $3"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+# check_contains NAME PATTERN TEXT
+check_contains() {
+    if grep -qE -- "$2" <<< "$3"; then
+        echo "  ok: $1"
+    else
+        echo "  FAILED: $1"
+        echo "    expected to match: $2"
+        echo "    actual: $(tail -c 300 <<< "$3")"
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+# Binary protocol frames are built and read as hex strings
+
+hex_i32() {
+    printf '%08x' $(($1 & 0xffffffff))
+}
+
+hex_str() {
+    hex_i32 ${#1}
+    printf '%s' "$1" | od -An -tx1 -v | tr -d ' \n'
+}
+
+# frame OPCODE ID PAYLOAD_HEX
+frame() {
+    printf 'b7%02x0000%08x%08x%s' "$1" "$2" $((${#3} / 2)) "$3"
+}
+
+# open_binary PORT / send_binary HEX / close_binary: one connection on fd 3
+open_binary() {
+    exec 3<>/dev/tcp/127.0.0.1/"$1"
+}
+
+send_binary() {
+    printf '%s' "$1" | xxd -r -p >&3
+}
+
+close_binary() {
+    exec 3<&-
+}
+
+# read_bytes N: exactly N bytes from the connection, as hex
+read_bytes() {
+    timeout 10 dd bs=1 count="$1" <&3 2>/dev/null | od -An -tx1 -v | tr -d ' \n'
+}
+
+# read_frame: the next response as "opcode status id payload_hex"
+read_frame() {
+    local header length payload=""
+    header=$(read_bytes 12)
+    if [ ${#header} -ne 24 ]; then
+        echo "none"
+        return
+    fi
+    length=$((16#${header:16:8}))
+    if [ "$length" -gt 0 ]; then
+        payload=$(read_bytes "$length")
+    fi
+    echo "$((16#${header:2:2})) $((16#${header:4:4})) $((16#${header:8:8})) $payload"
+}
+
+# Stop the servers, remove the scratch files and report
+finish() {
+    for pid in "${SERVER_PIDS[@]}"; do
+        kill "$pid" 2>/dev/null
+        wait "$pid" 2>/dev/null
+    done
+    rm -rf "$TEST_DIR"
+    if [ "$FAILURES" -gt 0 ]; then
+        echo "$FAILURES check(s) failed"
+        exit 1
+    fi
+    exit 0
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Batch mode: one reply line per command (comments get none), failed commands
+# are reported without stopping the block, and the block ends with its count.
+
+source "$(dirname "$0")/common.sh"
+
+echo "Batch mode"
+start_server 9321 --max-vertices 1000 --max-active-jobs 0 --retry-after-ms 250
+
+EXPECTED="ok
+ok
+ok
+error Edge 0 - 7 refers to a missing vertex
+error unknown batch command: frobnicate
+ok total=9 edges=0-1:4,1-2:5
+error build_graph: vertex count 5000 is above max_vertices (1000)
+ok name=default vertices=3 edges=2 version=1
+ok 3
+busy retry_after_ms=250
+end 10"
+check "one reply per command" "$EXPECTED" \
+    "$(batch 9321 'build_graph 3' 'add_edge 0 1 4' 'add_edge 1 2 5' 'add_edge 0 7 1' 'frobnicate' 'compute_mst kruskal' \
+        'build_graph 5000' 'graph_info' '# not a command' 'add_vertex' 'submit_job mst kruskal')"
+
+check "empty batch" "end 0" "$(batch 9321)"
+
+finish
@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Binary protocol: pipelined frames are answered in order with their request
+# IDs, a frame split across writes is decoded, and a build above max_vertices
+# is refused without closing the connection. A large print_graph comes back as
+# MORE frames and a final OK frame.
+
+source "$(dirname "$0")/common.sh"
+
+echo "Binary protocol"
+start_server 9311 --binary-port 9312 --max-vertices 1000
+wait_for_port 9312
+
+BUILD=$(hex_i32 3)$(hex_i32 2)$(hex_i32 0)$(hex_i32 1)$(hex_i32 4)$(hex_i32 1)$(hex_i32 2)$(hex_i32 5)
+EDGE=$(hex_i32 0)$(hex_i32 2)$(hex_i32 1)
+HUGE=$(hex_i32 2000000000)$(hex_i32 0)
+KRUSKAL=$(hex_str kruskal)
+
+open_binary 9312
+# Seven requests in one write
+send_binary "$(frame 10 1 "$(hex_str bin)")$(frame 11 2 "$(hex_str bin)")$(frame 1 3 "$BUILD")$(frame 3 4 "$EDGE")$(frame 6 5 "$KRUSKAL")$(frame 1 6 "$HUGE")$(frame 30 7 '')"
+check "create_graph" "10 0 1 " "$(read_frame)"
+check "select_graph" "11 0 2 " "$(read_frame)"
+check "build_graph" "1 0 3 " "$(read_frame)"
+check "add_edge" "3 0 4 " "$(read_frame)"
+check "compute_mst: 0-2:1 and 0-1:4" "6 0 5 $(hex_i32 2)$(hex_i32 0)$(hex_i32 2)$(hex_i32 1)$(hex_i32 0)$(hex_i32 1)$(hex_i32 4)" "$(read_frame)"
+check_contains "build above max_vertices is refused" "^1 1 6 .*$(printf max_vertices | od -An -tx1 | tr -d ' \n')" "$(read_frame)"
+check "connection still served" "30 0 7 " "$(read_frame)"
+
+# One request split in the middle of its header, then of its payload
+REQUEST=$(frame 6 8 "$KRUSKAL")
+send_binary "${REQUEST:0:10}"
+sleep 0.2
+send_binary "${REQUEST:10:20}"
+sleep 0.2
+send_binary "${REQUEST:30}"
+check_contains "split frame is decoded" "^6 0 8 $(hex_i32 2)" "$(read_frame)"
+
+# A dump larger than one 64 KiB piece
+send_binary "$(frame 17 9 "$(hex_str "kind=grid vertices=1000 seed=1")")$(frame 8 10 '')"
+check_contains "generate_graph" "^17 0 9 " "$(read_frame)"
+PIECES=0
+while PIECE=$(read_frame) && [[ "$PIECE" == "8 3 10 "* ]]; do
+    PIECES=$((PIECES + 1))
+done
+check_contains "print_graph ends with OK" "^8 0 10 [0-9a-f]{8}" "$PIECE"
+check "print_graph is streamed" "yes" "$([ "$PIECES" -ge 1 ] && echo yes)"
+close_binary
+
+finish
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Cluster MST: on a partitioned graph CLUSTER_MST returns exactly what
+# COMPUTE_MST "kruskal" (KruskalMST::findMST) returns, byte for byte, and a
+# partition stops matching once the graph changes or is dropped and created
+# again under its name. A shard that stops answering fails the command.
+
+source "$(dirname "$0")/common.sh"
+
+echo "Cluster MST"
+start_server 9341 --binary-port 9351
+start_server 9342 --binary-port 9352
+wait_for_port 9351
+wait_for_port 9352
+start_server 9343 --binary-port 9353 --cluster-shards 127.0.0.1:9351,127.0.0.1:9352
+wait_for_port 9353
+
+# same_mst NAME GENERATOR: generate, partition and compare both MSTs
+same_mst() {
+    local generated partitioned local_mst cluster_mst
+    send_binary "$(frame 17 1 "$(hex_str "$2")")$(frame 38 2 '')$(frame 6 3 "$(hex_str kruskal)")$(frame 39 4 '')"
+    generated=$(read_frame)
+    partitioned=$(read_frame)
+    local_mst=$(read_frame)
+    cluster_mst=$(read_frame)
+    check_contains "$1: generated" "^17 0 1 " "$generated"
+    check_contains "$1: partitioned" "^38 0 2 " "$partitioned"
+    check_contains "$1: has an MST" "^6 0 3 [0-9a-f]{32}" "$local_mst"
+    check "$1: cluster_mst equals kruskal" "${local_mst#6 0 3 }" "${cluster_mst#39 0 4 }"
+}
+
+open_binary 9353
+# Narrow weight ranges give many ties, which the merge must break the same way
+same_mst "random graph" "kind=erdos_renyi vertices=300 edges=1500 seed=7 weights=uniform min_weight=1 max_weight=5"
+same_mst "constant weights" "kind=grid vertices=400 seed=1 weights=constant"
+same_mst "disconnected graph" "kind=erdos_renyi vertices=200 edges=90 seed=3"
+close_binary
+
+STALE=$(printf '%s\n' 10 g 11 g 1 3 2 '0 1 5' '1 2 3' 27 11 default 12 g 10 g 11 g 1 3 2 '0 1 5' '1 2 3' 28 | text_session 9343)
+check_contains "partition of a dropped graph is not used" "changed since it was partitioned" "$STALE"
+
+# A stopped shard still accepts connections but never answers
+start_server 9344 --binary-port 9354
+wait_for_port 9354
+start_server 9345 --cluster-shards 127.0.0.1:9351,127.0.0.1:9354 --command-deadline-ms 500
+kill -STOP "${SERVER_PIDS[9344]}"
+HUNG=$(printf '%s\n' 1 4 1 '0 3 1' 27 | text_session 9345)
+kill -CONT "${SERVER_PIDS[9344]}"
+check_contains "hung shard fails the partition" "Shard 127.0.0.1:9354 did not answer within 500 ms" "$HUNG"
+
+finish
@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Replication: a replica applies its primary's log until both give the same
+# MST, keeps up with later writes and graphs, and refuses writes of its own.
+
+source "$(dirname "$0")/common.sh"
+
+# converge PORT EXPECTED COMMAND...: rerun the batch on the replica for up to
+# 5 s until its last command replies EXPECTED; print that last reply
+converge() {
+    local port=$1 expected=$2 reply
+    shift 2
+    for _ in $(seq 1 50); do
+        reply=$(batch "$port" "$@" | tail -2 | head -1)
+        if [ "$reply" == "$expected" ]; then
+            break
+        fi
+        sleep 0.1
+    done
+    echo "$reply"
+}
+
+echo "Replication"
+start_server 9331 --wal-dir "$TEST_DIR/primary" --replication-port 9333
+wait_for_port 9333
+start_server 9332 --replicate-from 127.0.0.1:9333
+
+batch 9331 'build_graph 4' 'add_edge 0 1 3' 'add_edge 1 2 1' 'add_edge 2 3 2' 'add_edge 0 3 9' > /dev/null
+PRIMARY=$(batch 9331 'compute_mst kruskal' | head -1)
+check "primary's MST" "ok total=6 edges=1-2:1,2-3:2,0-1:3" "$PRIMARY"
+check "replica converges" "$PRIMARY" "$(converge 9332 "$PRIMARY" 'compute_mst kruskal')"
+
+batch 9331 'change_weight 0 3 0' 'create_graph other' 'select_graph other' 'build_graph 2' 'add_edge 0 1 7' > /dev/null
+PRIMARY=$(batch 9331 'compute_mst kruskal' | head -1)
+check "primary's MST after the change" "ok total=3 edges=0-3:0,1-2:1,2-3:2" "$PRIMARY"
+check "replica follows later writes" "$PRIMARY" "$(converge 9332 "$PRIMARY" 'compute_mst kruskal')"
+check "replica has the new graph" "ok total=7 edges=0-1:7" \
+    "$(converge 9332 'ok total=7 edges=0-1:7' 'select_graph other' 'compute_mst kruskal')"
+
+check_contains "replica refuses writes" "^error read-only replica of 127.0.0.1:9333" "$(batch 9332 'add_edge 0 1 1')"
+check_contains "replica reports its role" "replica" "$(printf '26\n' | text_session 9332)"
+
+finish